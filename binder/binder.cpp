@@ -14,6 +14,7 @@
  */
 
 #include "binder.h"
+#include <chrono>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -27,7 +28,7 @@ void Binder::cmd_main(void) {
     if (argcnt < 2) cmd_usage(pc->curcmd, SYNOPSIS);
     struct binder_argument_t binder_arg;
     BZERO(&binder_arg, sizeof(binder_arg));
-    while ((c = getopt(argcnt, args, "tnrbflap:")) != EOF) {
+    while ((c = getopt(argcnt, args, "tnrbflawp:")) != EOF) {
         switch(c) {
             case 'a':
                 binder_arg.dump_all = 1;
@@ -45,6 +46,9 @@ void Binder::cmd_main(void) {
                 binder_arg.flags |= BINDER_ALLOC;
                 binder_proc_show(&binder_arg);
                 break;
+            case 'w':
+                print_wait_chains();
+                break;
             case 'f':
                 print_binder_transaction_log_entry(true);
                 break;
@@ -141,7 +145,8 @@ Binder::Binder(){
             "  binder -n\n"
             "  binder -b\n"
             "  binder -t\n"
-            "  binder -r\n"                    /* argument synopsis, or " " if none */
+            "  binder -r\n"
+            "  binder -w\n"                    /* argument synopsis, or " " if none */
         "  This command dumps the binder information.",
         "\n",
         "EXAMPLES",
@@ -185,6 +190,17 @@ Binder::Binder(){
         "         binder_ref:0xe8407e80 id:406535 desc:15 s:1 w:1 death:0x0 -> node_id:9291 binder_proc:0xebf3ba00 Binder:1239_3[1239]",
         "         binder_ref:0xdec2e640 id:406527 desc:7 s:1 w:1 death:0x0 -> node_id:9540 binder_proc:0xebf3ba00 Binder:1239_3[1239]",
         "\n",
+        "  Display blocking wait chains and cycles between binder threads:",
+        "    %s> binder -w",
+        "       Snapshot: 96 procs, 731 threads, 2964 nodes, 5322 refs, 6 transactions in 0.041s",
+        "",
+        "       Chain 1 depth:3",
+        "         ndroid.settings[4268:4268]       waits id:98800 code:7 ->",
+        "         Binder:1067_4[1067:2046]         waits id:98803 code:3 ->",
+        "         Binder:600_2[600:688]            handling id:98803 code:3",
+        "",
+        "       Blocked chains:1 cycles:0",
+        "\n",
         "  Display binder buffer info:",
         "    %s> binder -b",
         "       binder_proc:0xea194000 viders.calendar [7340] binder dead:0 frozen:0 sr:0 ar:0 max:15 total:6 requested:0 started:4 ready:5",
@@ -193,6 +209,7 @@ Binder::Binder(){
         "           Page :0xf7d338f8 PA:0x88bce000",
         "           Free binder_buffer :0xdb035300 id:409018 data:0x81a390e0 PA:0xa664b0e0 size:296 offset:24 extra:0 pid:666 delivered",
         "           Alloc binder_buffer:0xdd8f62c0 id:408034 data:0x81a390d8 PA:0xa664b0d8 size:8 offset:0 extra:0 pid:1239 delivered",
+        "           Summary: alloc:1(8B) free:1(1015.78KB) fragmented:0B largest_free:1015.78KB pages:2/254",
         "\n",
     };
     initialize();
@@ -237,6 +254,10 @@ void Binder::print_binder_transaction_log_entry(bool fail_log){
     }
 }
 
+/*
+ * print_binder_proc reads everything it shows, so only the pid of each
+ * binder_proc is read here, the snapshot is not built for it.
+ */
 void Binder::binder_proc_show(struct binder_argument_t* binder_arg) {
     if (!csymbol_exists("binder_procs")){
         fprintf(fp, "binder_procs doesn't exist in this kernel!\n");
@@ -258,9 +279,14 @@ void Binder::binder_proc_show(struct binder_argument_t* binder_arg) {
     }
 }
 
+/*
+ * The pages array of binder_alloc already maps every page of the buffer
+ * space, so it is read in one go and buffer addresses are translated by
+ * page index. uvtop() is only used for pages the array doesn't cover,
+ * and at most once per page.
+ */
 void Binder::print_binder_alloc(struct task_context *tc,ulong alloc_addr) {
-    physaddr_t paddr;
-    if(is_kvaddr(alloc_addr))return;
+    if(!is_kvaddr(alloc_addr))return;
     struct binder_alloc alloc;
     BZERO(&alloc, sizeof(struct binder_alloc));
     if(!read_struct(alloc_addr,&alloc,sizeof(alloc),"binder_alloc")){
@@ -268,56 +294,90 @@ void Binder::print_binder_alloc(struct task_context *tc,ulong alloc_addr) {
     }
     fprintf(fp, "  binder_alloc:%#lx mm_struct:%p vma:%p buffer:%p size:%d free:%d\n",alloc_addr,
             alloc.vma_vm_mm, alloc.vma, alloc.buffer, alloc.buffer_size, alloc.free_async_space);
+    ulong buffer_start = (ulong)alloc.buffer;
+    ulong buffer_end = buffer_start + alloc.buffer_size;
     // read all the pages
-    int nr_pages = alloc.buffer_size / PAGESIZE();
-    for (int i = 0; i < nr_pages; ++i) {
-        ulong lru_page_addr = (ulong)alloc.pages + i * struct_size(binder_lru_page);
-        struct binder_lru_page lru_page;
-        if(!read_struct(lru_page_addr,&lru_page,sizeof(lru_page),"binder_lru_page")){
-            continue;
-        }
-        ulong page_addr = (ulong)lru_page.page_ptr;
-        if(is_kvaddr(page_addr)){
-            paddr = page_to_phy(page_addr);
-            fprintf(fp, "    Page :%#lx PA:%#llx\n",page_addr,(ulonglong)paddr);
+    size_t nr_pages = alloc.buffer_size / PAGESIZE();
+    std::vector<physaddr_t> page_phys(nr_pages, 0);
+    size_t resident = 0;
+    if (nr_pages > 0 && is_kvaddr((ulong)alloc.pages)){
+        // older kernels have binder_lru_page, newer ones a plain struct page * array
+        size_t stride = struct_size(binder_lru_page) > 0 ? struct_size(binder_lru_page) : sizeof(ulong);
+        size_t page_offset = struct_size(binder_lru_page) > 0 ? offsetof(struct binder_lru_page, page_ptr) : 0;
+        std::vector<char> pages(nr_pages * stride);
+        if(read_struct((ulong)alloc.pages,pages.data(),pages.size(),"binder_lru_page")){
+            for (size_t i = 0; i < nr_pages; ++i) {
+                ulong page_addr = *reinterpret_cast<ulong*>(pages.data() + i * stride + page_offset);
+                if(!is_kvaddr(page_addr)) continue;
+                page_phys[i] = page_to_phy(page_addr);
+                resident++;
+                fprintf(fp, "    Page :%#lx PA:%#llx\n",page_addr,(ulonglong)page_phys[i]);
+            }
         }
     }
-    // list all free buffers
-    int offset = field_offset(binder_buffer,rb_node);
-    std::vector<ulong> free_list = for_each_rbtree((ulong)alloc.free_buffers.rb_node,offset);
-    struct binder_buffer buf;
-    for (const auto& buffer_addr : free_list) {
-        BZERO(&buf, sizeof(struct binder_buffer));
-        if(!read_struct(buffer_addr,&buf,sizeof(buf),"binder_buffer")){
-            continue;
+    std::unordered_map<ulong, physaddr_t> uvtop_cache;
+    auto user_to_phy = [&](ulong uaddr) -> physaddr_t {
+        ulong offset = uaddr & (PAGESIZE() - 1);
+        ulong page_base = uaddr - offset;
+        if (uaddr >= buffer_start && uaddr < buffer_end){
+            physaddr_t paddr = page_phys[(page_base - buffer_start) / PAGESIZE()];
+            if (paddr) return paddr + offset;
         }
-        paddr = 0;
-        if(tc != nullptr){
-            uvtop(tc, (ulong)buf.user_data, &paddr, 0);
+        if (tc == nullptr) return 0;
+        auto it = uvtop_cache.find(page_base);
+        if (it == uvtop_cache.end()){
+            physaddr_t paddr = 0;
+            if (!uvtop(tc, page_base, &paddr, 0)){
+                paddr = 0;
+            }
+            it = uvtop_cache.emplace(page_base, paddr).first;
         }
-        fprintf(fp, "    Free binder_buffer :%#lx id:%d data:%#lx PA:%#llx size:%zd offset:%zd extra:%zd pid:%d %s\n",
-           buffer_addr, buf.debug_id, (ulong)buf.user_data,(ulonglong)paddr,
-           buf.data_size, buf.offsets_size,
-           buf.extra_buffers_size,buf.pid,
-           buf.transaction ? "active" : "delivered");
-    }
-    // list all allocated_buffers buffers
-    std::vector<ulong> alloc_list = for_each_rbtree((ulong)alloc.allocated_buffers.rb_node,offset);
-    for (const auto& buffer_addr : alloc_list) {
-        BZERO(&buf, sizeof(struct binder_buffer));
-        if(!read_struct(buffer_addr,&buf,sizeof(buf),"binder_buffer")){
-            continue;
+        return it->second ? it->second + offset : 0;
+    };
+    // <user_data, free> of every buffer, to size them by address order
+    std::vector<std::pair<ulong, bool>> spans;
+    auto print_buffers = [&](ulong rb_root, bool is_free) {
+        int offset = field_offset(binder_buffer,rb_node);
+        std::vector<ulong> buffer_list = for_each_rbtree(rb_root,offset);
+        struct binder_buffer buf;
+        for (const auto& buffer_addr : buffer_list) {
+            BZERO(&buf, sizeof(struct binder_buffer));
+            if(!read_struct(buffer_addr,&buf,sizeof(buf),"binder_buffer")){
+                continue;
+            }
+            physaddr_t paddr = user_to_phy((ulong)buf.user_data);
+            spans.push_back(std::make_pair((ulong)buf.user_data, is_free));
+            fprintf(fp, "    %s:%#lx id:%d data:%#lx PA:%#llx size:%zd offset:%zd extra:%zd pid:%d %s\n",
+               is_free ? "Free binder_buffer " : "Alloc binder_buffer",
+               buffer_addr, buf.debug_id, (ulong)buf.user_data,(ulonglong)paddr,
+               buf.data_size, buf.offsets_size,
+               buf.extra_buffers_size,buf.pid,
+               buf.transaction ? "active" : "delivered");
         }
-        paddr = 0;
-        if(tc != nullptr){
-            uvtop(tc, (ulong)buf.user_data, &paddr, 0);
+    };
+    // list all free buffers
+    print_buffers((ulong)alloc.free_buffers.rb_node, true);
+    // list all allocated_buffers buffers
+    print_buffers((ulong)alloc.allocated_buffers.rb_node, false);
+    // a buffer spans up to the next buffer, like binder_alloc_buffer_size()
+    std::sort(spans.begin(), spans.end());
+    size_t alloc_cnt = 0, free_cnt = 0;
+    ulong alloc_bytes = 0, free_bytes = 0, largest_free = 0;
+    for (size_t i = 0; i < spans.size(); i++) {
+        ulong next = (i + 1 < spans.size()) ? spans[i + 1].first : buffer_end;
+        ulong size = next > spans[i].first ? next - spans[i].first : 0;
+        if (spans[i].second){
+            free_cnt++;
+            free_bytes += size;
+            largest_free = std::max(largest_free, size);
+        } else {
+            alloc_cnt++;
+            alloc_bytes += size;
         }
-        fprintf(fp, "    Alloc binder_buffer:%#lx id:%d data:%#lx PA:%#llx size:%zd offset:%zd extra:%zd pid:%d %s\n",
-           buffer_addr, buf.debug_id, (ulong)buf.user_data,(ulonglong)paddr,
-           buf.data_size, buf.offsets_size,
-           buf.extra_buffers_size,buf.pid,
-           buf.transaction ? "active" : "delivered");
     }
+    fprintf(fp, "    Summary: alloc:%zu(%s) free:%zu(%s) fragmented:%s largest_free:%s pages:%zu/%zu\n",
+        alloc_cnt, csize(alloc_bytes).c_str(), free_cnt, csize(free_bytes).c_str(),
+        csize(free_bytes - largest_free).c_str(), csize(largest_free).c_str(), resident, nr_pages);
 }
 
 void Binder::print_binder_proc(ulong proc_addr,int flags) {
@@ -380,9 +440,7 @@ void Binder::print_binder_proc(ulong proc_addr,int flags) {
     // read all binder alloc
     if (flags & BINDER_ALLOC){
         ulong alloc_addr = proc_addr + field_offset(binder_proc,alloc);
-        if (!is_kvaddr(alloc_addr)){
-            print_binder_alloc(tc,alloc_addr);
-        }
+        print_binder_alloc(tc,alloc_addr);
     }
     // read all todo binder work of binder proc
     ulong list_head_todo = ULONG(binder_proc_buf + field_offset(binder_proc,todo));
@@ -620,4 +678,305 @@ void Binder::print_binder_work_ilocked(ulong proc_addr, const char* prefix, cons
             break;
     }
 }
+int Binder::snap_index(const std::unordered_map<ulong, int>& index, ulong addr){
+    auto it = index.find(addr);
+    return it == index.end() ? -1 : it->second;
+}
+
+int Binder::snap_txn(binder_snapshot& s, ulong txn_addr){
+    auto it = s.txn_index.find(txn_addr);
+    if (it != s.txn_index.end()){
+        return it->second;
+    }
+    void *buf = read_struct(txn_addr,"binder_transaction");
+    if(buf == nullptr) return -1;
+    binder_txn_snap t;
+    t.addr = txn_addr;
+    t.debug_id = UINT(buf + field_offset(binder_transaction,debug_id));
+    t.from_addr = ULONG(buf + field_offset(binder_transaction,from));
+    t.to_thread_addr = ULONG(buf + field_offset(binder_transaction,to_thread));
+    t.to_proc_addr = ULONG(buf + field_offset(binder_transaction,to_proc));
+    t.from_parent = ULONG(buf + field_offset(binder_transaction,from_parent));
+    t.to_parent = ULONG(buf + field_offset(binder_transaction,to_parent));
+    t.code = UINT(buf + field_offset(binder_transaction,code));
+    t.flags = UINT(buf + field_offset(binder_transaction,flags));
+    t.need_reply = UINT(buf + field_offset(binder_transaction,need_reply)) & 0x1;
+    t.from_thread = t.to_thread = t.to_proc = -1;
+    FREEBUF(buf);
+    s.txns.push_back(t);
+    s.txn_index[txn_addr] = s.txns.size() - 1;
+    return s.txns.size() - 1;
+}
+
+/*
+ * Read one binder_proc with its threads, nodes and refs. The binder_proc
+ * and every thread, node and ref are read exactly once.
+ */
+void Binder::snap_proc(binder_snapshot& s, ulong proc_addr){
+    void *binder_proc_buf = read_struct(proc_addr,"binder_proc");
+    if(binder_proc_buf == nullptr) return;
+    struct binder_proc_part1 proc_part1;
+    struct binder_proc_part2 proc_part2;
+    memcpy(&proc_part1, binder_proc_buf + field_offset(binder_proc,proc_node), sizeof(proc_part1));
+    memcpy(&proc_part2, binder_proc_buf + field_offset(binder_proc,max_threads), sizeof(proc_part2));
+    ulong context_addr = ULONG(binder_proc_buf + field_offset(binder_proc,context));
+    FREEBUF(binder_proc_buf);
+
+    binder_proc_snap proc;
+    proc.addr = proc_addr;
+    proc.pid = proc_part1.pid;
+    proc.is_dead = proc_part1.is_dead;
+    proc.max_threads = proc_part2.max_threads;
+    proc.requested_threads_started = proc_part2.requested_threads_started;
+    if (is_kvaddr((ulong)proc_part1.tsk)){
+        proc.comm = read_cstring((ulong)proc_part1.tsk + field_offset(task_struct,comm),16, "task_struct_comm");
+    }
+    if (is_kvaddr(context_addr)){
+        ulong name_addr = read_structure_field(context_addr,"binder_context","name");
+        if (is_kvaddr(name_addr)){
+            proc.context = read_cstring(name_addr,16, "binder_context_name");
+        }
+    }
+    ulong list_head = proc_addr + field_offset(binder_proc,proc_node) + offsetof(struct binder_proc_part1, waiting_threads);
+    proc.ready_threads = for_each_list(list_head,field_offset(binder_thread,waiting_thread_node)).size();
+    int proc_idx = s.procs.size();
+    s.proc_index[proc_addr] = proc_idx;
+
+    proc.thread_start = s.threads.size();
+    for (const auto& thread_addr : for_each_rbtree((ulong)proc_part1.threads.rb_node,field_offset(binder_thread,rb_node))) {
+        struct binder_thread thread;
+        if(!read_struct(thread_addr,&thread,sizeof(thread),"binder_thread")){
+            continue;
+        }
+        binder_thread_snap t;
+        t.addr = thread_addr;
+        t.proc = proc_idx;
+        t.pid = thread.pid;
+        t.looper = thread.looper;
+        t.stack = (ulong)thread.transaction_stack;
+        t.wait_txn = -1;
+        s.thread_index[thread_addr] = s.threads.size();
+        s.threads.push_back(t);
+    }
+    proc.thread_cnt = s.threads.size() - proc.thread_start;
+
+    proc.node_start = s.nodes.size();
+    for (const auto& node_addr : for_each_rbtree((ulong)proc_part1.nodes.rb_node,field_offset(binder_node,rb_node))) {
+        void *node_buf = read_struct(node_addr,"binder_node");
+        if(node_buf == nullptr) continue;
+        struct binder_node node;
+        memcpy(&node, node_buf + field_offset(binder_node,work), sizeof(node));
+        binder_node_snap n;
+        n.addr = node_addr;
+        n.proc = proc_idx;
+        n.debug_id = UINT(node_buf + field_offset(binder_node,debug_id));
+        n.ptr = (ulong)node.ptr;
+        n.cookie = (ulong)node.cookie;
+        FREEBUF(node_buf);
+        s.node_index[node_addr] = s.nodes.size();
+        s.nodes.push_back(n);
+    }
+    proc.node_cnt = s.nodes.size() - proc.node_start;
+
+    proc.ref_start = s.refs.size();
+    for (const auto& ref_addr : for_each_rbtree((ulong)proc_part1.refs_by_desc.rb_node,field_offset(binder_ref,rb_node_desc))) {
+        struct binder_ref ref;
+        if(!read_struct(ref_addr,&ref,sizeof(ref),"binder_ref")){
+            continue;
+        }
+        binder_ref_snap r;
+        r.addr = ref_addr;
+        r.proc = proc_idx;
+        r.node_addr = (ulong)ref.node;
+        r.node = -1;
+        r.debug_id = ref.data.debug_id;
+        r.desc = ref.data.desc;
+        r.strong = ref.data.strong;
+        r.weak = ref.data.weak;
+        s.refs.push_back(r);
+    }
+    proc.ref_cnt = s.refs.size() - proc.ref_start;
+    s.procs.push_back(proc);
+
+    // transactions still queued on the proc, not picked up by any thread
+    ulong todo_head = proc_addr + field_offset(binder_proc,todo);
+    for (const auto& work_addr : for_each_list(todo_head,field_offset(binder_work,entry))) {
+        struct binder_work w;
+        if(read_struct(work_addr,&w,sizeof(w),"binder_work") && w.type == BINDER_WORK_TRANSACTION){
+            snap_txn(s, work_addr - field_offset(binder_transaction,work));
+        }
+    }
+}
+
+/*
+ * Build the snapshot once, all later queries only look at the arrays.
+ */
+std::shared_ptr<binder_snapshot> Binder::load_snapshot(){
+    if (snap != nullptr){
+        return snap;
+    }
+    if (!csymbol_exists("binder_procs")){
+        fprintf(fp, "binder_procs doesn't exist in this kernel!\n");
+        return nullptr;
+    }
+    ulong binder_procs = csymbol_value("binder_procs");
+    if (!is_kvaddr(binder_procs)) return nullptr;
+    auto start = std::chrono::steady_clock::now();
+    auto s = std::make_shared<binder_snapshot>();
+    for (const auto& proc_addr : for_each_hlist(binder_procs,field_offset(binder_proc,proc_node))) {
+        snap_proc(*s, proc_addr);
+    }
+    // walk the transaction stack of every thread
+    for (size_t i = 0; i < s->threads.size(); i++) {
+        ulong thread_addr = s->threads[i].addr;
+        ulong t = s->threads[i].stack;
+        while (is_kvaddr(t)) {
+            int idx = snap_txn(*s, t);
+            if (idx < 0) break;
+            const binder_txn_snap& txn = s->txns[idx];
+            if (txn.from_addr == thread_addr) {
+                t = txn.from_parent;
+            } else if (txn.to_thread_addr == thread_addr) {
+                t = txn.to_parent;
+            } else {
+                break;
+            }
+        }
+    }
+    for (auto& txn : s->txns) {
+        txn.from_thread = snap_index(s->thread_index, txn.from_addr);
+        txn.to_thread = snap_index(s->thread_index, txn.to_thread_addr);
+        txn.to_proc = snap_index(s->proc_index, txn.to_proc_addr);
+    }
+    for (auto& ref : s->refs) {
+        ref.node = snap_index(s->node_index, ref.node_addr);
+    }
+    // a thread is blocked when the top of its stack is its own sync call
+    for (size_t i = 0; i < s->threads.size(); i++) {
+        int idx = snap_index(s->txn_index, s->threads[i].stack);
+        if (idx >= 0 && s->txns[idx].from_thread == (int)i && !(s->txns[idx].flags & TF_ONE_WAY)) {
+            s->threads[i].wait_txn = idx;
+        }
+    }
+    s->load_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    snap = s;
+    return snap;
+}
+
+std::string Binder::snap_thread_name(const binder_snapshot& s, int thread){
+    const binder_thread_snap& t = s.threads[thread];
+    const binder_proc_snap& p = s.procs[t.proc];
+    std::ostringstream oss;
+    struct task_context *tc = pid_to_context(t.pid);
+    oss << (tc ? tc->comm : p.comm.c_str()) << "[" << p.pid << ":" << t.pid << "]";
+    return oss.str();
+}
+
+/*
+ * Every blocked thread waits on exactly one peer, the to_thread of the
+ * outgoing transaction at the top of its stack, so the wait graph has
+ * out-degree one. Cycles are found with one colouring pass, then each
+ * chain is followed from a thread nobody waits on.
+ */
+void Binder::print_wait_chains(){
+    std::shared_ptr<binder_snapshot> s = load_snapshot();
+    if (s == nullptr) return;
+    size_t n = s->threads.size();
+    std::vector<int> next(n, -1);
+    std::vector<bool> waited(n, false);
+    for (size_t i = 0; i < n; i++) {
+        int idx = s->threads[i].wait_txn;
+        if (idx >= 0 && s->txns[idx].to_thread >= 0) {
+            next[i] = s->txns[idx].to_thread;
+            waited[next[i]] = true;
+        }
+    }
+    // cycles
+    std::vector<int> cycle_id(n, -1);
+    std::vector<std::vector<int>> cycles;
+    std::vector<char> state(n, 0);
+    for (size_t i = 0; i < n; i++) {
+        std::vector<int> path;
+        int j = i;
+        while (j >= 0 && state[j] == 0) {
+            state[j] = 1;
+            path.push_back(j);
+            j = next[j];
+        }
+        if (j >= 0 && state[j] == 1) {
+            std::vector<int> cycle(std::find(path.begin(), path.end(), j), path.end());
+            for (const auto& k : cycle) {
+                cycle_id[k] = cycles.size();
+            }
+            cycles.push_back(cycle);
+        }
+        for (const auto& k : path) {
+            state[k] = 2;
+        }
+    }
+    // chains start at a blocked thread which nobody waits on
+    std::vector<std::vector<int>> chains;
+    for (size_t i = 0; i < n; i++) {
+        if (s->threads[i].wait_txn < 0 || waited[i]) continue;
+        std::vector<int> chain;
+        int j = i;
+        while (j >= 0) {
+            chain.push_back(j);
+            if (cycle_id[j] >= 0) break;
+            j = next[j];
+        }
+        chains.push_back(chain);
+    }
+    std::stable_sort(chains.begin(), chains.end(),[&](const std::vector<int>& a, const std::vector<int>& b){
+        return a.size() > b.size();
+    });
+
+    auto print_hop = [&](int thread) {
+        const binder_thread_snap& t = s->threads[thread];
+        fprintf(fp, "  %-32s ", snap_thread_name(*s, thread).c_str());
+        if (t.wait_txn >= 0) {
+            const binder_txn_snap& txn = s->txns[t.wait_txn];
+            fprintf(fp, "waits id:%d code:%d", txn.debug_id, txn.code);
+            if (txn.to_thread >= 0) {
+                fprintf(fp, " ->\n");
+            } else if (txn.to_proc >= 0) {
+                const binder_proc_snap& p = s->procs[txn.to_proc];
+                fprintf(fp, " queued on %s[%d] ready:%zu started:%d max:%d\n", p.comm.c_str(), p.pid,
+                    p.ready_threads, p.requested_threads_started, p.max_threads);
+            } else {
+                fprintf(fp, " target gone\n");
+            }
+            return;
+        }
+        int idx = snap_index(s->txn_index, t.stack);
+        if (idx >= 0 && s->txns[idx].to_thread == thread) {
+            fprintf(fp, "handling id:%d code:%d\n", s->txns[idx].debug_id, s->txns[idx].code);
+        } else {
+            fprintf(fp, "not in binder\n");
+        }
+    };
+
+    fprintf(fp, "Snapshot: %zu procs, %zu threads, %zu nodes, %zu refs, %zu transactions in %.3fs\n\n",
+        s->procs.size(), n, s->nodes.size(), s->refs.size(), s->txns.size(), s->load_time);
+    for (size_t i = 0; i < chains.size(); i++) {
+        fprintf(fp, "Chain %zu depth:%zu\n", i + 1, chains[i].size());
+        for (const auto& thread : chains[i]) {
+            print_hop(thread);
+        }
+        int id = cycle_id[chains[i].back()];
+        if (id >= 0) {
+            fprintf(fp, "  -> enters cycle %d\n", id + 1);
+        }
+        fprintf(fp, "\n");
+    }
+    for (size_t i = 0; i < cycles.size(); i++) {
+        fprintf(fp, "Cycle %zu depth:%zu\n", i + 1, cycles[i].size());
+        for (const auto& thread : cycles[i]) {
+            print_hop(thread);
+        }
+        fprintf(fp, "  -> %s\n\n", snap_thread_name(*s, cycles[i].front()).c_str());
+    }
+    fprintf(fp, "Blocked chains:%zu cycles:%zu\n", chains.size(), cycles.size());
+}
+
 #pragma GCC diagnostic pop
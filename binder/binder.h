@@ -18,6 +18,86 @@
 
 #include "plugin.h"
 
+#define TF_ONE_WAY 0x01
+
+/*
+ * Flat snapshot of all binder procs, entries refer to each other by index
+ * into the arrays of struct binder_snapshot, -1 when the peer is unknown.
+ */
+struct binder_proc_snap {
+    ulong addr;
+    int pid;
+    std::string comm;
+    std::string context;
+    bool is_dead;
+    int max_threads;
+    int requested_threads_started;
+    size_t ready_threads;
+    size_t thread_start;
+    size_t thread_cnt;
+    size_t node_start;
+    size_t node_cnt;
+    size_t ref_start;
+    size_t ref_cnt;
+};
+
+struct binder_thread_snap {
+    ulong addr;
+    int proc;
+    int pid;
+    int looper;
+    ulong stack;            /* top of transaction_stack */
+    int wait_txn;           /* outgoing sync transaction the thread is blocked on */
+};
+
+struct binder_node_snap {
+    ulong addr;
+    int proc;
+    int debug_id;
+    ulong ptr;
+    ulong cookie;
+};
+
+struct binder_ref_snap {
+    ulong addr;
+    int proc;
+    ulong node_addr;
+    int node;
+    int debug_id;
+    uint32_t desc;
+    int strong;
+    int weak;
+};
+
+struct binder_txn_snap {
+    ulong addr;
+    int debug_id;
+    ulong from_addr;
+    ulong to_thread_addr;
+    ulong to_proc_addr;
+    ulong from_parent;
+    ulong to_parent;
+    int from_thread;
+    int to_thread;
+    int to_proc;
+    unsigned int code;
+    unsigned int flags;
+    bool need_reply;
+};
+
+struct binder_snapshot {
+    std::vector<binder_proc_snap> procs;
+    std::vector<binder_thread_snap> threads;
+    std::vector<binder_node_snap> nodes;
+    std::vector<binder_ref_snap> refs;
+    std::vector<binder_txn_snap> txns;
+    std::unordered_map<ulong, int> proc_index;
+    std::unordered_map<ulong, int> thread_index;
+    std::unordered_map<ulong, int> node_index;
+    std::unordered_map<ulong, int> txn_index;
+    double load_time = 0;
+};
+
 class Binder : public ParserPlugin {
 public:
     static const int BINDER_THREAD = 0x0001;
@@ -47,6 +127,17 @@ public:
     void print_binder_transaction_ilocked(ulong proc_addr, const char* prefix, ulong transaction);
     void print_binder_work_ilocked(ulong proc_addr, const char* prefix, const char* transaction_prefix, ulong work);
     char*convert_sched(int i);
+    std::shared_ptr<binder_snapshot> load_snapshot();
+    void print_wait_chains();
+
+private:
+    std::shared_ptr<binder_snapshot> snap;
+    int snap_index(const std::unordered_map<ulong, int>& index, ulong addr);
+    void snap_proc(binder_snapshot& s, ulong proc_addr);
+    int snap_txn(binder_snapshot& s, ulong txn_addr);
+    std::string snap_thread_name(const binder_snapshot& s, int thread);
+
+public:
     DEFINE_PLUGIN_INSTANCE(Binder)
 };
 
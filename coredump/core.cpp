@@ -20,6 +20,7 @@
 
 int Core::cmd_flags = 0;
 std::string Core::symbols_path;
+int Core::write_jobs = 1;
 
 void Core::cmd_main(void) {}
 
@@ -64,15 +65,29 @@ Core::~Core(){
     swap_ptr.reset();
 }
 
-void Core::parser_core_dump(void) {
+bool Core::parser_core_dump(void) {
     tc = pid_to_context(core_pid);
+    if (!tc) {
+        return false;
+    }
     std::stringstream ss = get_curpath();
     ss << "/core." << std::dec << tc->pid << "." << tc->comm;
-    corefile = fopen(ss.str().c_str(), "wb");
+    if (Core::cmd_flags & CORE_COMPRESS){
+        ss << ".zst";
+        if (!zstd_init(ss.str())) {
+            fprintf(fp, "Can't open %s\n", ss.str().c_str());
+            return false;
+        }
+        corefile = tmpfile();
+    } else {
+        corefile = fopen(ss.str().c_str(), "wb");
+    }
     if (!corefile) {
         fprintf(fp, "Can't open %s\n", ss.str().c_str());
-        return;
+        zstd_release();
+        return false;
     }
+    core_path = ss.str();
     task_ptr = std::make_shared<UTask>(swap_ptr, tc->task);
     if (BITS64()){
         user_view_var_name = task_ptr->is_compat() ? "user_aarch32_view" : "user_aarch64_view";
@@ -88,8 +103,8 @@ void Core::parser_core_dump(void) {
     parser_thread_core_info();
     write_core_file();
     fprintf(fp, "\ncore_path:%s \n", ss.str().c_str());
-    Core::symbols_path.clear();
     task_ptr.reset();
+    return true;
 }
 
 void Core::parser_exec_name(ulong addr){
@@ -101,10 +116,34 @@ void Core::parser_exec_name(ulong addr){
 }
 
 bool Core::SearchFile(const std::string& directory, const std::string& name, std::string& result) {
-    if (!directory.empty() && !name.empty()) {
+    if (directory.empty() || name.empty()) {
+        return false;
+    }
+    struct stat path_stat;
+    if (stat(directory.c_str(), &path_stat) != 0 || !S_ISDIR(path_stat.st_mode)) {
         return InnerSearchFile(directory, name, result);
     }
-    return false;
+    const std::vector<std::string>* paths = SymbolIndex::instance().find_all(directory, name);
+    if (paths == nullptr || paths->empty()) {
+        return false;
+    }
+    // several builds of the same library, pick the one matching the mapped build-id
+    if (paths->size() > 1 && task_ptr != nullptr) {
+        std::shared_ptr<vma_struct> phdr_vma_ptr = task_ptr->get_phdr_vma(name);
+        if (phdr_vma_ptr != nullptr) {
+            std::string build_id = SymbolIndex::read_build_id([&](size_t off, void* buf, size_t len) -> bool {
+                if (off + len > phdr_vma_ptr->vm_size) {
+                    return false;
+                }
+                return swap_ptr->uread_buffer(tc->task, phdr_vma_ptr->vm_start + off, (char*)buf, len, "build-id");
+            });
+            if (SymbolIndex::instance().find_build_id(directory, build_id, result)) {
+                return true;
+            }
+        }
+    }
+    result = paths->front();
+    return true;
 }
 
 bool Core::InnerSearchFile(const std::string& path, std::string name, std::string& result) {
@@ -245,16 +284,23 @@ bool Core::write_pt_load(std::shared_ptr<vma_struct> vma_ptr, size_t phdr_pos, s
         return false;
     }
     write_phdr(PT_LOAD,data_pos,vma_ptr->vm_start,p_filesz,p_memsz,p_flags,page_size);
-
-    if (vma_dump_size(vma_ptr)) {
-        return true;
-    }
     if(debug){
         fprintf(fp, "phdr_start: %zu data_start: %zu\n",phdr_pos, data_pos);
     }
-    if (fseek(corefile, data_pos, SEEK_SET) != 0) {
-        fclose(corefile);
-        return false;
+    data_pos += p_filesz;
+    return true;
+}
+
+/*
+ * Write the data of one PT_LOAD. The program headers are all written by
+ * write_pt_load before any data, so data_pos only ever moves forward and
+ * the whole core can go through a sequential sink. The data of a vma is
+ * taken from at most one source and data_pos moves by vm_size like the
+ * p_offset of the header, whichever replacement wrote it.
+ */
+bool Core::write_pt_load_data(std::shared_ptr<vma_struct> vma_ptr, size_t& data_pos) {
+    if (vma_dump_size(vma_ptr)) {
+        return true;
     }
     bool replace = false;
     if (Core::cmd_flags & CORE_REPLACE_HEAD){
@@ -265,14 +311,10 @@ bool Core::write_pt_load(std::shared_ptr<vma_struct> vma_ptr, size_t phdr_pos, s
         */
         if ((vma_ptr->name.find(exe_name) != std::string::npos || vma_ptr->name == exe_name) &&
             (vma_ptr->vm_start <= task_ptr->get_auxv(AT_PHDR) && vma_ptr->vm_end > task_ptr->get_auxv(AT_PHDR))){
-                size_t replace_size = replace_phdr_load(vma_ptr);
-                if(replace_size > 0){
-                    data_pos += replace_size;
-                    replace = true;
-                }
+                replace = (replace_phdr_load(vma_ptr, data_pos) > 0);
         }
     }
-    if (Core::cmd_flags & CORE_FAKE_LINKMAP){
+    if (!replace && (Core::cmd_flags & CORE_FAKE_LINKMAP)){
         /*
         replace all symbol info to core base on l_addr
         */
@@ -285,14 +327,11 @@ bool Core::write_pt_load(std::shared_ptr<vma_struct> vma_ptr, size_t phdr_pos, s
             if(phdr_vma_ptr == nullptr || phdr_vma_ptr != vma_ptr){
                 continue;
             }
-            size_t map_size = 0;
-            void *map = map_elf_file(filepath, map_size);
-            if (map == nullptr){
-                continue;
-            }
             size_t memsz = vma_ptr->vm_end - vma_ptr->vm_start;
             size_t pgoff = vma_ptr->vm_pgoff << 12;
-            fwrite(reinterpret_cast<char*>(map) + pgoff, memsz, 1, corefile);
+            if (!write_file_data(filepath, pgoff, memsz, data_pos)){
+                continue;
+            }
             if(debug){
                 fprintf(fp, "overwrite %s:[size:0x%zx off:%#lx] to core:[%#lx - %#lx] \n",
                     vma_ptr->name.c_str(), memsz,vma_ptr->vm_pgoff << 12, vma_ptr->vm_start, vma_ptr->vm_end);
@@ -304,40 +343,29 @@ bool Core::write_pt_load(std::shared_ptr<vma_struct> vma_ptr, size_t phdr_pos, s
                     << " - " << std::hex << std::showbase << vma_ptr->vm_end
                     << "]\n";
             }
-            munmap(map, map_size);
-            data_pos += memsz;
             replace = true;
+            break;
         }
     }
     if(replace == false){
-        void* vma_data = task_ptr->read_vma_data(vma_ptr);
-        if (vma_data){
-            fwrite(vma_data, vma_ptr->vm_size, 1, corefile);
-            std::free(vma_data);
-        }
-        data_pos += vma_ptr->vm_size;
+        write_vma_data(vma_ptr, data_pos);
     }
+    data_pos += vma_ptr->vm_size;
     return true;
 }
 
-size_t Core::replace_phdr_load(std::shared_ptr<vma_struct> vma_ptr){
+size_t Core::replace_phdr_load(std::shared_ptr<vma_struct> vma_ptr, size_t data_pos){
     if (Core::symbols_path.empty()){
-        return -1;
+        return 0;
     }
     std::string filepath;
     if(!SearchFile(Core::symbols_path, vma_ptr->name, filepath)){
-        return -1;
-    }
-    size_t map_size = 0;
-    void *map = map_elf_file(filepath, map_size);
-    if (map == nullptr){
-        return -1;
+        return 0;
     }
     size_t memsz = vma_ptr->vm_end - vma_ptr->vm_start;
     size_t pgoff = vma_ptr->vm_pgoff << 12;
-    fwrite(reinterpret_cast<char*>(map) + pgoff, memsz, 1, corefile);
-    if (munmap(map, map_size) == -1) {
-        fprintf(fp, "munmap PHDR failed \n");
+    if (!write_file_data(filepath, pgoff, memsz, data_pos)){
+        return 0;
     }
     if(debug){
         fprintf(fp, "overwrite PHDR %s:[size:0x%zx off:%#lx] to core:[%#lx - %#lx] \n",
@@ -352,6 +380,314 @@ size_t Core::replace_phdr_load(std::shared_ptr<vma_struct> vma_ptr){
     }
     return memsz;
 }
+
+/*
+ * Write one batch of PT_LOAD data at data_pos. Runs of non-zero pages go
+ * out with pwritev, all-zero pages (including the unmapped ones, which are
+ * read back as zero) are skipped and stay as holes in the sparse core.
+ */
+bool Core::flush_batch(const char* buf, size_t data_pos, size_t len){
+    if (zstd_ctx){
+        written_size += len;
+        return zstd_write(buf, len, data_pos);
+    }
+    int fd = fileno(corefile);
+    size_t run_start = 0;
+    size_t run_len = 0;
+    auto write_run = [&]() -> bool {
+        if (run_len == 0){
+            return true;
+        }
+        struct iovec iov;
+        iov.iov_base = const_cast<char*>(buf + run_start);
+        iov.iov_len = run_len;
+        size_t done = 0;
+        while (done < run_len){
+            ssize_t ret = pwritev(fd, &iov, 1, data_pos + run_start + done);
+            if (ret <= 0){
+                return false;
+            }
+            done += ret;
+            iov.iov_base = const_cast<char*>(buf + run_start + done);
+            iov.iov_len = run_len - done;
+        }
+        written_size += run_len;
+        run_len = 0;
+        return true;
+    };
+    for (size_t off = 0; off < len; off += page_size){
+        size_t chunk = std::min(page_size, len - off);
+        const char* page = buf + off;
+        bool zero = true;
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= chunk; i += sizeof(uint64_t)){
+            if (*reinterpret_cast<const uint64_t*>(page + i) != 0){
+                zero = false;
+                break;
+            }
+        }
+        for (; zero && i < chunk; i++){
+            zero = (page[i] == 0);
+        }
+        if (zero){
+            hole_size += chunk;
+            if (!write_run()){
+                return false;
+            }
+            continue;
+        }
+        if (run_len == 0){
+            run_start = off;
+        }
+        run_len += chunk;
+    }
+    return write_run();
+}
+
+bool Core::finish_stream(){
+    bool ret = true;
+    while (!pending_writes.empty()){
+        ret &= pending_writes.front().get();
+        pending_writes.pop_front();
+    }
+    return ret;
+}
+
+/*
+ * Move len bytes to the core at data_pos in batches of CORE_BATCH_PAGES
+ * through a ring of reusable batch buffers. With CORE_DOUBLE_BUFFER the
+ * writes run in the background while the next batch is being read, up to
+ * write_jobs of them at once. Compressed output must stay in order, so it
+ * keeps a single write in flight.
+ */
+bool Core::stream_to_core(size_t data_pos, size_t len, std::function<bool (char* buf, size_t offset, size_t len)> fill_batch){
+    size_t batch_size = CORE_BATCH_PAGES * page_size;
+    size_t slots = 1;
+    if (Core::cmd_flags & CORE_DOUBLE_BUFFER){
+        slots = zstd_ctx ? 2 : std::max(Core::write_jobs, 1) + 1;
+    }
+    if (batch_buf.size() < slots){
+        batch_buf.resize(slots);
+    }
+    bool ret = true;
+    for (size_t off = 0; off < len && ret; off += batch_size) {
+        size_t chunk = std::min(batch_size, len - off);
+        // the ring slot is free again once the oldest write is done
+        while (slots > 1 && pending_writes.size() >= slots - 1){
+            ret &= pending_writes.front().get();
+            pending_writes.pop_front();
+        }
+        cur_batch %= slots;
+        std::vector<char>& batch = batch_buf[cur_batch];
+        if (batch.size() < batch_size){
+            batch.resize(batch_size);
+        }
+        BZERO(batch.data(), chunk);
+        if (!fill_batch(batch.data(), off, chunk) && debug){
+            fprintf(fp, "read batch [%#zx-%#zx] failed \n", off, off + chunk);
+        }
+        if (slots > 1){
+            pending_writes.push_back(std::async(std::launch::async, &Core::flush_batch, this, batch.data(), data_pos + off, chunk));
+            cur_batch++;
+        } else {
+            ret = flush_batch(batch.data(), data_pos + off, chunk);
+        }
+    }
+    return ret;
+}
+
+bool Core::write_vma_data(std::shared_ptr<vma_struct> vma_ptr, size_t data_pos){
+    return stream_to_core(data_pos, vma_ptr->vm_size, [&](char* buf, size_t offset, size_t len) -> bool {
+        return swap_ptr->uread_buffer(tc->task, vma_ptr->vm_start + offset, buf, len, "read vma data");
+    });
+}
+
+bool Core::write_file_data(const std::string& filepath, size_t file_off, size_t len, size_t data_pos){
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ret = stream_to_core(data_pos, len, [&](char* buf, size_t offset, size_t len) -> bool {
+        size_t done = 0;
+        while (done < len){
+            ssize_t cnt = pread(fd, buf + done, len - done, file_off + offset + done);
+            if (cnt <= 0){ // past the end of file, keep the rest as zero
+                return cnt == 0;
+            }
+            done += cnt;
+        }
+        return true;
+    });
+    // the batch may still be in flight, keep fd open until it is written
+    ret &= finish_stream();
+    close(fd);
+    return ret;
+}
+
+bool Core::zstd_init(const std::string& path){
+    zstd_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (zstd_fd < 0){
+        return false;
+    }
+    zstd_ctx = ZSTD_createCCtx();
+    if (!zstd_ctx){
+        close(zstd_fd);
+        zstd_fd = -1;
+        return false;
+    }
+    ZSTD_CCtx_setParameter(zstd_ctx, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+    if (Core::write_jobs > 1){
+        // only takes effect when libzstd is built with multithread support
+        ZSTD_CCtx_setParameter(zstd_ctx, ZSTD_c_nbWorkers, Core::write_jobs);
+    }
+    zstd_out.resize(ZSTD_CStreamOutSize());
+    seek_table.clear();
+    zstd_in_size = 0;
+    zstd_out_size = 0;
+    frame_in_size = 0;
+    frame_out_size = 0;
+    return true;
+}
+
+void Core::zstd_release(){
+    if (zstd_ctx){
+        ZSTD_freeCCtx(zstd_ctx);
+        zstd_ctx = nullptr;
+    }
+    if (zstd_fd >= 0){
+        close(zstd_fd);
+        zstd_fd = -1;
+    }
+    zstd_out = std::vector<char>();
+}
+
+bool Core::zstd_flush_out(size_t len){
+    size_t done = 0;
+    while (done < len){
+        ssize_t ret = write(zstd_fd, zstd_out.data() + done, len - done);
+        if (ret <= 0){
+            return false;
+        }
+        done += ret;
+    }
+    frame_out_size += len;
+    zstd_out_size += len;
+    return true;
+}
+
+bool Core::zstd_compress(const char* buf, size_t len, ZSTD_EndDirective mode){
+    ZSTD_inBuffer input = { buf, len, 0 };
+    while (true){
+        ZSTD_outBuffer output = { zstd_out.data(), zstd_out.size(), 0 };
+        size_t remaining = ZSTD_compressStream2(zstd_ctx, &output, &input, mode);
+        if (ZSTD_isError(remaining)){
+            fprintf(fp, "zstd compress failed: %s\n", ZSTD_getErrorName(remaining));
+            return false;
+        }
+        if (!zstd_flush_out(output.pos)){
+            return false;
+        }
+        bool finished = (mode == ZSTD_e_end) ? (remaining == 0) : (input.pos == input.size);
+        if (finished){
+            break;
+        }
+    }
+    return true;
+}
+
+bool Core::zstd_end_frame(){
+    if (frame_in_size == 0){
+        return true;
+    }
+    if (!zstd_compress(nullptr, 0, ZSTD_e_end)){
+        return false;
+    }
+    seek_table.push_back(std::make_pair(frame_out_size, frame_in_size));
+    frame_in_size = 0;
+    frame_out_size = 0;
+    return true;
+}
+
+/*
+ * Feed len bytes located at core offset pos to the compressor. The gap
+ * from the end of the previous write is filled with zeros, and a frame
+ * is closed every CORE_ZSTD_FRAME_SIZE uncompressed bytes so the result
+ * can be random-accessed with the zstd seekable format.
+ */
+bool Core::zstd_write(const char* buf, size_t len, size_t pos){
+    static const std::vector<char> zeros(64 * 1024, 0);
+    auto feed = [&](const char* data, size_t size) -> bool {
+        while (size > 0){
+            size_t chunk = std::min(size, (size_t)CORE_ZSTD_FRAME_SIZE - frame_in_size);
+            if (!zstd_compress(data, chunk, ZSTD_e_continue)){
+                return false;
+            }
+            frame_in_size += chunk;
+            zstd_in_size += chunk;
+            size -= chunk;
+            data += chunk;
+            if (frame_in_size == CORE_ZSTD_FRAME_SIZE && !zstd_end_frame()){
+                return false;
+            }
+        }
+        return true;
+    };
+    if (pos < zstd_in_size){
+        fprintf(fp, "zstd sink can not go back from %zu to %zu\n", zstd_in_size, pos);
+        return false;
+    }
+    while (zstd_in_size < pos){
+        if (!feed(zeros.data(), std::min(zeros.size(), pos - zstd_in_size))){
+            return false;
+        }
+    }
+    return feed(buf, len);
+}
+
+/*
+ * In compressed mode the ELF header, program headers, notes and fake
+ * linkmap are built in a temporary file first, then pushed to the sink
+ * ahead of the PT_LOAD data.
+ */
+bool Core::zstd_write_head(size_t head_size){
+    std::vector<char> head(head_size);
+    ssize_t cnt = pread(fileno(corefile), head.data(), head_size, 0);
+    if (cnt < 0){
+        return false;
+    }
+    // a short read means the tail of the head is padding
+    return zstd_write(head.data(), head_size, 0);
+}
+
+bool Core::zstd_finish(){
+    if (!zstd_end_frame()){
+        return false;
+    }
+    /* Seek table: skippable frame + entries + footer, see zstd seekable_format.md */
+    std::vector<uint32_t> table;
+    table.push_back(0x184D2A5E);
+    table.push_back(seek_table.size() * 2 * sizeof(uint32_t) + 9);
+    for (const auto& entry : seek_table){
+        table.push_back(entry.first);
+        table.push_back(entry.second);
+    }
+    table.push_back(seek_table.size());
+    std::vector<char> buf(reinterpret_cast<char*>(table.data()), reinterpret_cast<char*>(table.data() + table.size()));
+    buf.push_back(0); /* descriptor, no checksums */
+    uint32_t magic = 0x8F92EAB1;
+    buf.insert(buf.end(), reinterpret_cast<char*>(&magic), reinterpret_cast<char*>(&magic) + sizeof(magic));
+    size_t done = 0;
+    while (done < buf.size()){
+        ssize_t ret = write(zstd_fd, buf.data() + done, buf.size() - done);
+        if (ret <= 0){
+            return false;
+        }
+        done += ret;
+    }
+    zstd_out_size += buf.size();
+    return true;
+}
+
 void Core::write_core_file(void) {
     size_t pt_note_size = 0;
     pt_note_size += notesize(auxv);
@@ -419,11 +755,29 @@ void Core::write_core_file(void) {
     //  ===========================================
     //  Writing PT LOAD
     //  ===========================================
-    // auto start = std::chrono::high_resolution_clock::now();
-    size_t vma_count = task_ptr->for_each_vma_list().size();
+    auto start = std::chrono::high_resolution_clock::now();
+    written_size = 0;
+    hole_size = 0;
+    size_t data_pos = load_data_pos;
     for (const auto& vma_ptr : task_ptr->for_each_vma_list()) {
         phdr_pos += get_phdr_size();
         if (!write_pt_load(vma_ptr,phdr_pos,load_data_pos)){
+            zstd_release();
+            std::free(hdr_ptr);
+            return;
+        }
+    }
+    fflush(corefile);
+    if (zstd_ctx && !zstd_write_head(data_pos)){
+        fprintf(fp, "Error compressing core header\n");
+        zstd_release();
+        fclose(corefile);
+        std::free(hdr_ptr);
+        return;
+    }
+    size_t vma_count = task_ptr->for_each_vma_list().size();
+    for (const auto& vma_ptr : task_ptr->for_each_vma_list()) {
+        if (!write_pt_load_data(vma_ptr,data_pos)){
             continue;
         }
         if(debug){
@@ -432,11 +786,32 @@ void Core::write_core_file(void) {
             std::cout << "Written page to core file. Remaining VMA count: " << std::dec << --vma_count << std::endl;
         }
     }
-    // auto end = std::chrono::high_resolution_clock::now();
-    // std::chrono::duration<double> elapsed = end - start;
-    // fprintf(fp, "time: %.6f s\n",elapsed.count());
+    if (!finish_stream()){
+        fprintf(fp, "Error writing PT_LOAD data to core file\n");
+    }
+    if (zstd_ctx){
+        if (!zstd_write(nullptr, 0, load_data_pos) || !zstd_finish()){
+            fprintf(fp, "Error compressing core file\n");
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        fprintf(fp, "uncompressed:%s compressed:%s frames:%zu time: %.6f s throughput: %.2f MB/s\n",
+            csize(zstd_in_size).c_str(), csize(zstd_out_size).c_str(), seek_table.size(),
+            elapsed.count(), elapsed.count() > 0 ? zstd_in_size / MB / elapsed.count() : 0);
+        zstd_release();
+    } else {
+        // extend the file over the trailing holes
+        fflush(corefile);
+        if (ftruncate(fileno(corefile), load_data_pos) != 0){
+            fprintf(fp, "Error truncating core file to %zu\n", load_data_pos);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        fprintf(fp, "PT_LOAD written:%s sparse:%s time: %.6f s\n", csize(written_size.load()).c_str(), csize(hole_size.load()).c_str(), elapsed.count());
+    }
     fclose(corefile);
     std::free(hdr_ptr);
+    batch_buf.clear();
     return;
 }
 
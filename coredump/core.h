@@ -21,8 +21,14 @@
 #include <linux/types.h>
 #include "memory/swapinfo.h"
 #include "../utils/utask.h"
+#include "../utils/symbol_index.h"
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <exception>
+#include <future>
+#include <deque>
+#include <atomic>
+#include <zstd.h>
 
 #define MMF_DUMP_ANON_PRIVATE       2
 #define MMF_DUMP_ANON_SHARED        3
@@ -54,6 +60,9 @@
 
 #define FAKE_AUXV_PHDR 0x100000
 
+#define CORE_BATCH_PAGES 256        /* pages moved per read/write batch */
+#define CORE_ZSTD_FRAME_SIZE (4 << 20) /* uncompressed bytes per seekable zstd frame */
+
 typedef unsigned long long __ull[2];
 
 
@@ -224,6 +233,9 @@ public:
     static std::string symbols_path;
     static const int CORE_REPLACE_HEAD = 0x0001;
     static const int CORE_FAKE_LINKMAP = 0x0002;
+    static const int CORE_DOUBLE_BUFFER = 0x0004;
+    static const int CORE_COMPRESS = 0x0008;
+    static int write_jobs;      /* max batches being written at the same time */
     std::shared_ptr<UTask> task_ptr;
 
 protected:
@@ -244,6 +256,22 @@ protected:
     std::shared_ptr<memelfnote> auxv;
     std::shared_ptr<memelfnote> files;
     std::shared_ptr<Swapinfo> swap_ptr;
+    /* streaming PT_LOAD writer */
+    std::vector<std::vector<char>> batch_buf;
+    size_t cur_batch = 0;
+    std::deque<std::future<bool>> pending_writes;
+    std::atomic<size_t> written_size{0};
+    std::atomic<size_t> hole_size{0};
+    std::string core_path;
+    /* zstd seekable output */
+    ZSTD_CCtx* zstd_ctx = nullptr;
+    int zstd_fd = -1;
+    std::vector<char> zstd_out;
+    std::vector<std::pair<uint32_t, uint32_t>> seek_table; // <compressed, uncompressed> size of each frame
+    size_t zstd_in_size = 0;
+    size_t zstd_out_size = 0;
+    size_t frame_in_size = 0;
+    size_t frame_out_size = 0;
 
 public:
     Core(std::shared_ptr<Swapinfo> swap);
@@ -260,7 +288,10 @@ public:
         std::copy_n(src, len, dest);
         dest[len] = '\0';
     }
-    void parser_core_dump(void);
+    bool parser_core_dump(void);
+    const std::string& get_core_path(){
+        return core_path;
+    }
     void parser_exec_name(ulong addr);
     bool SearchFile(const std::string &directory, const std::string &name, std::string &result);
     bool InnerSearchFile(const std::string &path, std::string name, std::string &result);
@@ -268,6 +299,7 @@ public:
     void print_linkmap();
     bool write_pt_note(void);
     bool write_pt_load(std::shared_ptr<vma_struct> vma_ptr, size_t phdr_pos, size_t& data_pos);
+    bool write_pt_load_data(std::shared_ptr<vma_struct> vma_ptr, size_t& data_pos);
     void write_core_file(void);
     bool parser_user_regset_view(void);
     std::string vma_flags_to_str(unsigned long flags);
@@ -292,7 +324,20 @@ public:
     bool check_elf_file(void * map);
     std::shared_ptr<symbol_info> read_elf_file(std::string file_path);
     void free_lib_map();
-    size_t replace_phdr_load(std::shared_ptr<vma_struct> vma_ptr);
+    size_t replace_phdr_load(std::shared_ptr<vma_struct> vma_ptr, size_t data_pos);
+    bool flush_batch(const char* buf, size_t data_pos, size_t len);
+    bool finish_stream();
+    bool stream_to_core(size_t data_pos, size_t len, std::function<bool (char* buf, size_t offset, size_t len)> fill_batch);
+    bool write_vma_data(std::shared_ptr<vma_struct> vma_ptr, size_t data_pos);
+    bool write_file_data(const std::string& filepath, size_t file_off, size_t len, size_t data_pos);
+    bool zstd_init(const std::string& path);
+    void zstd_release();
+    bool zstd_flush_out(size_t len);
+    bool zstd_compress(const char* buf, size_t len, ZSTD_EndDirective mode);
+    bool zstd_end_frame();
+    bool zstd_write(const char* buf, size_t len, size_t pos);
+    bool zstd_write_head(size_t head_size);
+    bool zstd_finish();
     void write_fake_data(size_t &data_pos, size_t phdr_pos);
     int get_pt_note_data_start();
 
@@ -23,6 +23,8 @@
 #include "arm/compat.h"
 #include "arm/arm.h"
 
+#define CORE_PAGE_CACHE_PAGES 16384     /* zram pages kept across processes in batch mode */
+
 class Coredump : public ParserPlugin {
 private:
     std::shared_ptr<Core> core_parser;
@@ -34,12 +36,14 @@ public:
     static const int PRINT_LINKMAP = 0x0001;
     static const int PRINT_PROCMAP = 0x0002;
     static const int PRINT_COREDUMP = 0x0004;
+    static const int PRINT_BATCH = 0x0008;
     Coredump();
     Coredump(std::shared_ptr<Swapinfo> swap);
     void init_command();
     void cmd_main(void) override;
     void print_linkmap(int pid);
     void generate_coredump(int pid);
+    void generate_coredump(std::vector<int>& pid_list);
     bool get_core_parser(int pid);
     void print_proc_mapping(int pid);
     DEFINE_PLUGIN_INSTANCE(Coredump)
@@ -14,6 +14,8 @@
  */
 
 #include "debugimage.h"
+#include <chrono>
+#include <thread>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -31,7 +33,7 @@ void DebugImage::cmd_main(void) {
     if (image_list.size() == 0){
         parser_memdump();
     }
-    while ((c = getopt(argcnt, args, "acsp:C:")) != EOF) {
+    while ((c = getopt(argcnt, args, "acsTp:C:x:")) != EOF) {
         switch(c) {
             case 'a':
                 print_memdump();
@@ -42,6 +44,13 @@ void DebugImage::cmd_main(void) {
             case 's':
                 print_cpu_stack();
                 break;
+            case 'T':
+                print_missed_stacks();
+                break;
+            case 'x':
+                cppString.assign(optarg);
+                export_dump_data(cppString);
+                break;
             case 'p':
                 cppString.assign(optarg);
                 try {
@@ -81,6 +90,8 @@ DebugImage::DebugImage(){
             "  dbi -s\n"
             "  dbi -p <pid>\n"
             "  dbi -C <cpu> \n"
+            "  dbi -T\n"
+            "  dbi -x <id|all>\n"
             "  This command dump debug image info.",
         "\n",
         "EXAMPLES",
@@ -203,6 +214,87 @@ DebugImage::DebugImage(){
     initialize();
 }
 
+/*
+ * Stream the data_addr/data_len range of an entry to a file through the
+ * shared buffer, pages which can't be read are written as zero.
+ */
+bool DebugImage::export_dump_entry(std::shared_ptr<Dump_entry> entry_ptr, std::vector<char>& buf){
+    if (entry_ptr->data_len == 0){
+        return false;
+    }
+    std::stringstream ss = get_curpath();
+    ss << "/" << (entry_ptr->data_name.empty() ? "dump_" + std::to_string(entry_ptr->id) : entry_ptr->data_name)
+       << "@" << std::hex << entry_ptr->data_addr << ".bin";
+    FILE* file = fopen(ss.str().c_str(), "wb");
+    if (!file) {
+        fprintf(fp, "Can't open %s\n", ss.str().c_str());
+        return false;
+    }
+    uint64_t failed = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint64_t off = 0; off < entry_ptr->data_len; off += buf.size()) {
+        size_t len = std::min<uint64_t>(entry_ptr->data_len - off, buf.size());
+        if (!readmem(entry_ptr->data_addr + off, PHYSADDR, buf.data(), len, TO_CONST_STRING("dump data"), RETURN_ON_ERROR|QUIET)){
+            // retry page by page, so one hole doesn't drop the whole chunk,
+            // the unreadable bytes are reported once in the summary
+            for (size_t pos = 0; pos < len; pos += PAGESIZE()) {
+                size_t page_len = std::min<size_t>(len - pos, PAGESIZE());
+                if (!readmem(entry_ptr->data_addr + off + pos, PHYSADDR, buf.data() + pos, page_len, TO_CONST_STRING("dump data"), RETURN_ON_ERROR|QUIET)){
+                    memset(buf.data() + pos, 0, page_len);
+                    failed += page_len;
+                }
+            }
+        }
+        if (fwrite(buf.data(), len, 1, file) != 1){
+            fprintf(fp, "Write %s failed\n", ss.str().c_str());
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    double speed = elapsed.count() > 0 ? entry_ptr->data_len / elapsed.count() : 0;
+    fprintf(fp, "Write %s of %s to %s, %.3fs %s/s", csize(entry_ptr->data_len).c_str(), entry_ptr->data_name.c_str(),
+        ss.str().c_str(), elapsed.count(), csize((uint64_t)speed).c_str());
+    if (failed){
+        fprintf(fp, ", %s unreadable filled with zero", csize(failed).c_str());
+    }
+    fprintf(fp, "\n");
+    return true;
+}
+
+void DebugImage::export_dump_data(const std::string& arg){
+    bool all = (arg == "all");
+    uint32_t id = 0;
+    if (!all){
+        try {
+            id = std::stoul(arg, nullptr, 0);
+        } catch (...) {
+            fprintf(fp, "invaild id arg %s\n",arg.c_str());
+            return;
+        }
+    }
+    std::vector<char> buf(DUMP_EXPORT_CHUNK);
+    uint64_t total = 0;
+    size_t cnt = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const auto& entry_ptr : image_list) {
+        if ((all || entry_ptr->id == id) && export_dump_entry(entry_ptr, buf)){
+            total += entry_ptr->data_len;
+            cnt++;
+        }
+    }
+    if (cnt == 0){
+        fprintf(fp, "No dump data for %s\n", arg.c_str());
+        return;
+    }
+    if (cnt > 1){
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        double speed = elapsed.count() > 0 ? total / elapsed.count() : 0;
+        fprintf(fp, "Write %zu entries %s, %.3fs %s/s\n", cnt, csize(total).c_str(), elapsed.count(), csize((uint64_t)speed).c_str());
+    }
+}
+
 void DebugImage::print_memdump(){
     std::ostringstream oss_hd;
     oss_hd  << std::left << std::setw(4)            << "Id" << " "
@@ -395,20 +487,16 @@ void DebugImage::print_task_stack(int pid){
     fprintf(fp, "   sp:  %#lx\n", cc.sp);
     fprintf(fp, "   pc:  %#lx\n\n", cc.pc);
 
-    std::map<ulong, ulong> mem_maps;
     ulong stackbase = GET_STACKBASE(tc->task);
     ulong stacktop = GET_STACKTOP(tc->task);
     fprintf(fp, "Stack:%#lx~%#lx \n",stackbase, stacktop);
-    for(ulong addr = stackbase; addr < stacktop; addr += 0x10){
-        ulong fp = read_pointer(addr, "frame pointer x29");
-        mem_maps[addr] = fp;
+    std::vector<ulong> stack((stacktop - stackbase) / sizeof(ulong));
+    if (stack.empty() || !read_struct(stackbase, stack.data(), stack.size() * sizeof(ulong), "task stack")){
+        return;
     }
     int cnt = 0;
-    for(ulong x29: find_x29(mem_maps)){
+    for(ulong x29: find_x29(stackbase, stack)){
         ulong x30 = x29 + 8;
-        if(x30 < stackbase && x30 > stacktop){ // out of range
-            continue;
-        }
         fprintf(fp, "[%d]Potential backtrace -> FP:%#lx, LR:%#lx\n",cnt, x29, x30);
         uwind_task_back_trace(pid, x30);
         cnt++;
@@ -418,117 +506,169 @@ void DebugImage::print_task_stack(int pid){
 
 void DebugImage::print_irq_stack(int cpu){
 #if defined(ARM64)
-    if (cpu > kt->cpus){
+    if (cpu < 0 || cpu >= kt->cpus){
         fprintf(fp, "invaild cpu ! \n");
         return;
     }
-    // for (int i = 0; i < kt->cpus; i++){
-        std::map<ulong, ulong> mem_maps;
-        ulong irq_stack = machdep->machspec->irq_stacks[cpu];
-        fprintf(fp, "CPU[%d] irq stack:%#lx~%#lx \n",cpu, irq_stack, irq_stack + machdep->machspec->irq_stack_size);
-        for(ulong addr = irq_stack; addr < irq_stack + machdep->machspec->irq_stack_size; addr += 0x10){
-            ulong fp = read_pointer(addr, "frame pointer x29");
-            mem_maps[addr] = fp;
-        }
-        int cnt = 0;
-        for(ulong x29: find_x29(mem_maps)){
-            ulong x30 = x29 + 8;
-            if(x30 < irq_stack && x30 > irq_stack+ machdep->machspec->irq_stack_size){ // out of range
-                continue;
-            }
-            fprintf(fp, "[%d]Potential backtrace -> FP:%#lx, LR:%#lx\n",cnt, x29, x30);
-            uwind_irq_back_trace(cpu,x30);
-            cnt++;
-        }
-        fprintf(fp, "\n");
-    // }
+    ulong irq_stack = machdep->machspec->irq_stacks[cpu];
+    ulong irq_stack_size = machdep->machspec->irq_stack_size;
+    fprintf(fp, "CPU[%d] irq stack:%#lx~%#lx \n",cpu, irq_stack, irq_stack + irq_stack_size);
+    std::vector<ulong> stack(irq_stack_size / sizeof(ulong));
+    if (stack.empty() || !read_struct(irq_stack, stack.data(), stack.size() * sizeof(ulong), "irq stack")){
+        return;
+    }
+    int cnt = 0;
+    for(ulong x29: find_x29(irq_stack, stack)){
+        ulong x30 = x29 + 8;
+        fprintf(fp, "[%d]Potential backtrace -> FP:%#lx, LR:%#lx\n",cnt, x29, x30);
+        uwind_irq_back_trace(cpu,x30);
+        cnt++;
+    }
+    fprintf(fp, "\n");
 #endif
 }
 
-std::set<ulong> DebugImage::find_x29(const std::map<ulong /* addr */, ulong /* x29 */>& addr_x29) {
-    // Step 1: Build a set of x29 for fast lookup
-    std::set<ulong> x29_sets;
-    for (const auto& kv : addr_x29) {
-        x29_sets.insert(kv.second);
-    }
-    // Step 2: Find the first key (starting from the largest) that exists in the value set
-    ulong start_addr = 0;
-    bool found_start = false;
-    // Reverse iterate through the map (from largest key to smallest)
-    for (auto it = addr_x29.rbegin(); it != addr_x29.rend(); ++it) {
-        bool exists_in_x29 = (x29_sets.find(it->first) != x29_sets.end());
-        if(debug){
-            fprintf(fp, "Checking: %#lx - exists in x29? %s\n", it->first, (exists_in_x29 ? "YES" : "NO"));
-        }
-        if (exists_in_x29) {
-            start_addr = it->first;
-            found_start = true;
-            if(debug){
-                fprintf(fp, "!!! FOUND START ADDRESS: %#lx\n", start_addr);
-            }
-            break;
+/*
+ * A frame record is the 16 byte aligned {x29, x30} pair, and x29 points
+ * to the record of the caller at a higher address. The chain is rooted at
+ * the highest record which anyone points to, walking the slots downwards
+ * a record joins the chain when its x29 points to a record already in it,
+ * and the records nobody points to are the innermost frames. Two linear
+ * passes over the stack buffer, no lookup structure or sort is needed.
+ *
+ * stack holds the whole stack starting at base, the result is in
+ * ascending address order. It only looks at the buffer, so it is safe
+ * to call from worker threads.
+ */
+std::vector<ulong> DebugImage::find_x29(ulong base, const std::vector<ulong>& stack, std::vector<size_t>* depth) {
+    long nr_slots = stack.size() / 2;
+    ulong top = base + nr_slots * 0x10;
+    auto slot_of = [&](ulong x29) -> long {
+        if (x29 < base || x29 >= top || (x29 & 0xf)) return -1;
+        return (x29 - base) / 0x10;
+    };
+    long start = -1;
+    for (long i = 0; i < nr_slots; i++) {
+        long parent = slot_of(stack[i * 2]);
+        if (parent > i) { // a caller record is never at or below its callee
+            start = std::max(start, parent);
         }
     }
-    if (!found_start) {
-        if(debug){
-            fprintf(fp, "No valid addr in x29\n");
-        }
+    if (start < 0) {
         return {};
     }
-    // Step 3: save all addrs that x29 == start_addr
-    std::set<ulong> current_addrs;
-    for (const auto& kv : addr_x29) {
-        if (kv.second == start_addr) {
-            current_addrs.insert(kv.first);
-            if(debug){
-                fprintf(fp, "  Found mapping addr -> x29: %#lx -> %#lx\n", kv.first, kv.second);
-            }
+    std::vector<size_t> chain_depth(nr_slots, 0);  // 0: not in the chain
+    std::vector<bool> has_child(nr_slots, false);
+    chain_depth[start] = 1;
+    for (long i = start - 1; i >= 0; i--) {
+        long parent = slot_of(stack[i * 2]);
+        if (parent <= i || chain_depth[parent] == 0) {
+            continue;
         }
+        chain_depth[i] = chain_depth[parent] + 1;
+        has_child[parent] = true;
     }
-    if(debug){
-        fprintf(fp, "  Total mappings found: %zu\n\n", current_addrs.size());
+    std::vector<ulong> res;
+    for (long i = 0; i < start; i++) {
+        if (chain_depth[i] && !has_child[i]) {
+            res.push_back(base + i * 0x10);
+            if (depth) depth->push_back(chain_depth[i]);
+        }
+    }
+    return res;
+}
+
+/*
+ * bt starts from the x29 saved in cpu_context, a recovered chain is missed
+ * when its innermost record lies in the live part of the stack (above the
+ * saved sp) but is not on the frame chain bt follows.
+ */
+void DebugImage::check_stack(stack_scan& scan) {
+    scan.leafs = find_x29(scan.base, scan.stack, &scan.depth);
+    ulong top = scan.base + scan.stack.size() * sizeof(ulong);
+    std::vector<bool> on_bt(scan.stack.size() / 2, false);
+    ulong x29 = scan.fp;
+    while (x29 >= scan.base && x29 < top && !(x29 & 0xf) && !on_bt[(x29 - scan.base) / 0x10]) {
+        size_t slot = (x29 - scan.base) / 0x10;
+        on_bt[slot] = true;
+        scan.bt_frames++;
+        ulong next = scan.stack[slot * 2];
+        if (next <= x29) break;
+        x29 = next;
     }
-    // Step 4: Iteratively find final addrs, strictly following decreasing order
-    std::set<ulong> result_addrs;
-    int iteration = 0;
-    while (!current_addrs.empty()) {
-        iteration++;
-        if(debug){
-            fprintf(fp, "     loop: %d, processing %zu addrs\n", iteration, current_addrs.size());
+    for (size_t i = 0; i < scan.leafs.size(); i++) {
+        if (scan.leafs[i] >= scan.sp && !on_bt[(scan.leafs[i] - scan.base) / 0x10]) {
+            scan.missed.push_back(i);
         }
-        std::set<ulong> next_addrs;
-        for (ulong addr : current_addrs) {
-            if(debug){
-                fprintf(fp, "  Processing address: %#lx\n", addr);
+    }
+}
+
+/*
+ * Stacks are read on the main thread since readmem is not thread safe,
+ * the frame chain recovery of each batch runs on all cpus.
+ */
+void DebugImage::print_missed_stacks(){
+#if defined(ARM64)
+    field_init(task_struct, thread);
+    field_init(thread_struct, cpu_context);
+    size_t nr_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<ulong> task_list = for_each_threads();
+    double read_time = 0, scan_time = 0;
+    size_t nr_tasks = 0, nr_missed = 0, stack_bytes = 0;
+    fprintf(fp, "%-8s %-16s %-3s %-35s %s\n", "PID", "TASK", "BT", "MISSED CHAIN(depth)", "COMMAND");
+    for (size_t pos = 0; pos < task_list.size(); pos += STACK_SCAN_BATCH) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<stack_scan> batch;
+        for (size_t i = pos; i < task_list.size() && i < pos + STACK_SCAN_BATCH; i++) {
+            struct task_context *tc = task_to_context(task_list[i]);
+            // the cpu_context of a running task is stale
+            if (!tc || is_task_active(tc->task)) continue;
+            struct cpu_context cc;
+            if(!read_struct(tc->task + field_offset(task_struct, thread) + field_offset(thread_struct, cpu_context), &cc , sizeof(struct cpu_context) ,"cpu_context in dbi")){
+                continue;
             }
-            bool found = false;
-            // Look for addrs whose value equals the current addr and are smaller than the current addr
-            for (const auto& kv : addr_x29) {
-                if (kv.second == addr && kv.first < addr) {
-                    if(debug){
-                        fprintf(fp, "    Found valid child addr -> x29: %#lx -> %#lx\n", kv.first, kv.second);
-                    }
-                    next_addrs.insert(kv.first);
-                    found = true;
-                }
+            stack_scan scan;
+            scan.tc = tc;
+            scan.base = GET_STACKBASE(tc->task);
+            scan.fp = cc.fp;
+            scan.sp = cc.sp;
+            scan.stack.resize((GET_STACKTOP(tc->task) - scan.base) / sizeof(ulong));
+            if (scan.stack.empty() || !read_struct(scan.base, scan.stack.data(), scan.stack.size() * sizeof(ulong), "task stack")){
+                continue;
             }
-            // If not found, current addr is a final addr
-            if (!found) {
-                if(debug){
-                    fprintf(fp, "    No valid child found - marking as final address\n");
+            stack_bytes += scan.stack.size() * sizeof(ulong);
+            batch.push_back(std::move(scan));
+        }
+        auto read_end = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < nr_threads; t++) {
+            workers.emplace_back([&batch, t, nr_threads]() {
+                for (size_t i = t; i < batch.size(); i += nr_threads) {
+                    check_stack(batch[i]);
                 }
-                result_addrs.insert(addr);
-            }
+            });
         }
-        if(debug){
-            fprintf(fp, "  Found %zu addresses for next loop\n\n", next_addrs.size());
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        read_time += std::chrono::duration<double>(read_end - start).count();
+        scan_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - read_end).count();
+        nr_tasks += batch.size();
+        for (const auto& scan : batch) {
+            if (scan.missed.empty()) continue;
+            nr_missed++;
+            std::ostringstream oss;
+            for (const auto& i : scan.missed) {
+                oss << std::hex << "0x" << scan.leafs[i] << std::dec << "(" << scan.depth[i] << ") ";
+            }
+            fprintf(fp, "%-8d %-16lx %-3zu %-35s %s\n", (int)scan.tc->pid, scan.tc->task,
+                scan.bt_frames, oss.str().c_str(), scan.tc->comm);
         }
-        current_addrs = next_addrs;
-    }
-    if(debug){
-        fprintf(fp, "Final addresses found: %zu\n\n", result_addrs.size());
     }
-    return result_addrs;
+    fprintf(fp, "\nScanned %zu tasks, %s of stack, read:%.3fs recover:%.3fs threads:%zu\n",
+        nr_tasks, csize(stack_bytes).c_str(), read_time, scan_time, nr_threads);
+    fprintf(fp, "%zu tasks have chains bt misses, use dbi -p <pid> to print them\n", nr_missed);
+#endif
 }
 
 #pragma GCC diagnostic pop
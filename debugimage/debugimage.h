@@ -88,6 +88,22 @@ struct cpu_context {
     unsigned long pc;
 };
 
+#define DUMP_EXPORT_CHUNK (4 * 1024 * 1024)  /* physical read size of dbi -x */
+#define STACK_SCAN_BATCH 1024        /* task stacks kept in memory per batch of dbi -T */
+
+/* frame records recovered from one task stack */
+struct stack_scan {
+    struct task_context *tc;
+    ulong base;
+    ulong fp;                       /* saved x29 of cpu_context, where bt starts */
+    ulong sp;
+    std::vector<ulong> stack;
+    std::vector<ulong> leafs;       /* innermost frame record of each chain */
+    std::vector<size_t> depth;
+    size_t bt_frames = 0;
+    std::vector<size_t> missed;     /* index into leafs */
+};
+
 class ImageParser;
 
 class DebugImage : public ParserPlugin {
@@ -112,9 +128,13 @@ public:
     void parse_cpu_ctx(std::shared_ptr<Dump_entry> entry_ptr);
     void parser_dump_data(std::shared_ptr<Dump_entry> entry_ptr);
     void parser_dump_table(uint64_t paddr);
-    std::set<ulong> find_x29(const std::map<ulong, ulong>& addr_x29);
+    static std::vector<ulong> find_x29(ulong base, const std::vector<ulong>& stack, std::vector<size_t>* depth = nullptr);
+    static void check_stack(stack_scan& scan);
     void print_task_stack(int pid);
     void print_irq_stack(int cpu);
+    void print_missed_stacks();
+    void export_dump_data(const std::string& arg);
+    bool export_dump_entry(std::shared_ptr<Dump_entry> entry_ptr, std::vector<char>& buf);
 };
 
 #endif // DEBUG_IMAGE_DEFS_H_
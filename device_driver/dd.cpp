@@ -26,19 +26,7 @@ void DDriver::cmd_main(void) {
     int c;
     std::string cppString;
     if (argcnt < 2) cmd_usage(pc->curcmd, SYNOPSIS);
-    if (bus_list.size() == 0){
-        parser_bus_info();
-        for (auto& bus_ptr : bus_list) {
-            bus_ptr->device_list = parser_bus_device_list(bus_ptr->name);
-            bus_ptr->driver_list = parser_driver_list(bus_ptr->name);
-        }
-    }
-    if (class_list.size() == 0){
-        parser_class_info();
-        for (auto& class_ptr : class_list) {
-            class_ptr->device_list = parser_class_device_list(class_ptr->name);
-        }
-    }
+    load_device_model();
     while ((c = getopt(argcnt, args, "bB:cC:lLs:amDdp:")) != EOF) {
         switch(c) {
             case 'b': //list all bus
@@ -261,6 +249,38 @@ DDriver::DDriver(){
     initialize();
 }
 
+void DDriver::load_device_model(){
+    if (!bus_list.empty() || !class_list.empty()){
+        return;
+    }
+    parser_bus_info();
+    for (auto& bus_ptr : bus_list) {
+        bus_ptr->device_list = parser_bus_device_list(bus_ptr->name);
+        // a bound device sits on the bus of its driver, so the driver
+        // device lists come from here instead of walking klist_devices
+        for (auto& dev_ptr : bus_ptr->device_list) {
+            if (dev_ptr->driv != nullptr){
+                dev_ptr->driv->device_list.push_back(dev_ptr);
+            }
+        }
+        bus_ptr->driver_list = parser_driver_list(bus_ptr->name);
+        for (auto& driv_ptr : bus_ptr->driver_list) {
+            driver_name_maps[driv_ptr->name].push_back(driv_ptr);
+        }
+        bus_maps[bus_ptr->name] = bus_ptr;
+        bus_dev_name_max = name_width(bus_ptr->device_list, bus_dev_name_max);
+        drv_name_max = name_width(bus_ptr->driver_list, drv_name_max);
+        for (const auto& driv_ptr : bus_ptr->driver_list) {
+            compat_max = std::max(compat_max, driv_ptr->compatible.size());
+        }
+    }
+    parser_class_info();
+    for (auto& class_ptr : class_list) {
+        class_ptr->device_list = parser_class_device_list(class_ptr->name);
+        class_maps[class_ptr->name] = class_ptr;
+    }
+}
+
 void DDriver::print_class_info(){
     size_t name_max_len = 20;
     for (auto& class_ptr : class_list) {
@@ -302,12 +322,7 @@ void DDriver::print_bus_info(){
 }
 
 void DDriver::print_device_list(){
-    size_t name_max_len = 10;
-    for (auto& bus_ptr : bus_list) {
-        for (auto& dev_ptr : bus_ptr->device_list) {
-            name_max_len = std::max(name_max_len,dev_ptr->name.size());
-        }
-    }
+    size_t name_max_len = bus_dev_name_max;
     std::ostringstream oss_hd;
     oss_hd  << std::left << std::setw(VADDR_PRLEN + 2)  << "device" << " "
             << std::left << std::setw(name_max_len)     << "name" << " "
@@ -331,23 +346,18 @@ void DDriver::print_device_list(){
 }
 
 void DDriver::print_device_driver_for_bus(std::string bus_name){
-    std::vector<std::shared_ptr<device>> device_list;
-    std::vector<std::shared_ptr<driver>> driver_list;
-    for (auto& bus_ptr : bus_list) {
-        if (bus_ptr->name == bus_name){
-            device_list = bus_ptr->device_list;
-            driver_list = bus_ptr->driver_list;
-            break;
-        }
+    auto it = bus_maps.find(bus_name);
+    if (it == bus_maps.end()){
+        fprintf(fp, "No such bus: %s\n", bus_name.c_str());
+        return;
     }
+    const std::vector<std::shared_ptr<device>>& device_list = it->second->device_list;
+    const std::vector<std::shared_ptr<driver>>& driver_list = it->second->driver_list;
     fprintf(fp, "============================================================================\n");
     fprintf(fp, "                                All devices                                 \n");
     fprintf(fp, "============================================================================\n");
     if (device_list.size() > 0){
-        size_t name_max_len = 10;
-        for (auto& dev_ptr : device_list) {
-            name_max_len = std::max(name_max_len,dev_ptr->name.size());
-        }
+        size_t name_max_len = name_width(device_list, 10);
         std::ostringstream oss_hd;
         oss_hd  << std::left << std::setw(VADDR_PRLEN + 2)  << "device" << " "
                 << std::left << std::setw(name_max_len)     << "name"   << " "
@@ -370,10 +380,9 @@ void DDriver::print_device_driver_for_bus(std::string bus_name){
     fprintf(fp, "                                All drivers                                 \n");
     fprintf(fp, "============================================================================\n");
     if (driver_list.size() > 0){
-        size_t name_max_len = 10;
+        size_t name_max_len = name_width(driver_list, 10);
         size_t compat_max_len = 10;
         for (auto& driv_ptr : driver_list) {
-            name_max_len = std::max(name_max_len,driv_ptr->name.size());
             compat_max_len = std::max(compat_max_len,driv_ptr->compatible.size());
         }
         std::ostringstream oss_hd;
@@ -394,21 +403,17 @@ void DDriver::print_device_driver_for_bus(std::string bus_name){
 }
 
 void DDriver::print_device_driver_for_class(std::string class_name){
-    std::vector<std::shared_ptr<device>> device_list;
-    for (auto& class_ptr : class_list) {
-        if (class_ptr->name == class_name){
-            device_list = class_ptr->device_list;
-            break;
-        }
+    auto it = class_maps.find(class_name);
+    if (it == class_maps.end()){
+        fprintf(fp, "No such class: %s\n", class_name.c_str());
+        return;
     }
+    const std::vector<std::shared_ptr<device>>& device_list = it->second->device_list;
     fprintf(fp, "============================================================================\n");
     fprintf(fp, "                                All devices                                 \n");
     fprintf(fp, "============================================================================\n");
     if (device_list.size() > 0){
-        size_t name_max_len = 10;
-        for (auto& dev_ptr : device_list) {
-            name_max_len = std::max(name_max_len,dev_ptr->name.size());
-        }
+        size_t name_max_len = name_width(device_list, 10);
         std::ostringstream oss_hd;
         oss_hd  << std::left << std::setw(VADDR_PRLEN + 2)   << "device" << " "
                 << std::left << std::setw(name_max_len)      << "name"   << " "
@@ -863,27 +868,19 @@ void DDriver::print_misc_device(){
 }
 
 void DDriver::print_device_list_for_driver(std::string driver_name){
+    auto it = driver_name_maps.find(driver_name);
+    if (it == driver_name_maps.end()){
+        return;
+    }
     std::vector<std::shared_ptr<device>> device_list;
-    bool found = false;
-    for (auto& bus_ptr : bus_list) {
-        for (auto& drv_ptr : bus_ptr->driver_list) {
-            if (drv_ptr->name == driver_name){
-                device_list = drv_ptr->device_list;
-                found = true;
-                break;
-            }
-        }
-        if (found){
-            break;
-        }
+    // drivers of the same name on different buses
+    for (const auto& drv_ptr : it->second) {
+        device_list.insert(device_list.end(), drv_ptr->device_list.begin(), drv_ptr->device_list.end());
     }
     if (device_list.empty()){
         return;
     }
-    size_t name_max_len = 10;
-    for (auto& dev_ptr : device_list) {
-        name_max_len = std::max(name_max_len,dev_ptr->name.size());
-    }
+    size_t name_max_len = name_width(device_list, 10);
     std::ostringstream oss_hd;
     oss_hd << std::left << "   " << std::setw(VADDR_PRLEN + 2) << "device" << " "
         << std::left << std::setw(name_max_len) << "name";
@@ -897,14 +894,8 @@ void DDriver::print_device_list_for_driver(std::string driver_name){
 }
 
 void DDriver::print_driver_list(){
-    size_t name_max_len = 10;
-    size_t compat_max_len = 10;
-    for (auto& bus_ptr : bus_list) {
-        for (auto& driv_ptr : bus_ptr->driver_list) {
-            name_max_len = std::max(name_max_len,driv_ptr->name.size());
-            compat_max_len = std::max(compat_max_len,driv_ptr->compatible.size());
-        }
-    }
+    size_t name_max_len = drv_name_max;
+    size_t compat_max_len = compat_max;
     std::ostringstream oss_hd;
     oss_hd  << std::left << std::setw(16)               << "device_driver" << " "
             << std::left << std::setw(name_max_len)     << "name" << " "
@@ -1004,12 +995,6 @@ std::vector<std::shared_ptr<driver>> DDriver::parser_driver_list(std::string bus
         // fprintf(fp, "driver_addr:%#zx \n",driver_addr);
         std::shared_ptr<driver> driv_ptr = parser_driver(driver_addr);
         if (driv_ptr == nullptr) continue;
-        for (const auto& device_addr : for_each_device_for_driver(driver_addr)) {
-            // fprintf(fp, "device_addr:%#zx \n",device_addr);
-            std::shared_ptr<device> dev_ptr = parser_device(device_addr);
-            if (dev_ptr == nullptr) continue;
-            driv_ptr->device_list.push_back(dev_ptr);
-        }
         driver_list.push_back(driv_ptr);
     }
     return driver_list;
@@ -1017,6 +1002,10 @@ std::vector<std::shared_ptr<driver>> DDriver::parser_driver_list(std::string bus
 
 std::shared_ptr<device> DDriver::parser_device(size_t addr){
     if (!is_kvaddr(addr)) return nullptr;
+    auto it = device_maps.find(addr);
+    if (it != device_maps.end()){
+        return it->second;
+    }
     std::shared_ptr<device> dev_ptr = std::make_shared<device>();
     dev_ptr->addr = addr;
     size_t name_addr = read_pointer(addr + field_offset(device,kobj) + field_offset(kobject,name),"device name addr");
@@ -1029,11 +1018,16 @@ std::shared_ptr<device> DDriver::parser_device(size_t addr){
     if (is_kvaddr(driver_addr)){
         dev_ptr->driv = parser_driver(driver_addr);
     }
+    device_maps[addr] = dev_ptr;
     return dev_ptr;
 }
 
 std::shared_ptr<driver> DDriver::parser_driver(size_t addr){
     if (!is_kvaddr(addr)) return nullptr;
+    auto it = driver_maps.find(addr);
+    if (it != driver_maps.end()){
+        return it->second;
+    }
     std::shared_ptr<driver> driv_ptr = std::make_shared<driver>();
     driv_ptr->addr = addr;
     size_t name_addr = read_pointer(addr + field_offset(device_driver,name),"driver name addr");
@@ -1063,6 +1057,7 @@ std::shared_ptr<driver> DDriver::parser_driver(size_t addr){
     }else{
         driv_ptr->compatible = "";
     }
+    driver_maps[addr] = driv_ptr;
     return driv_ptr;
 }
 
@@ -63,7 +63,32 @@ struct partition {
     std::string fs_type = "";
 };
 
+/*
+ * The device model is read once per session, a device or driver seen from
+ * a bus, a class or another device is the same object, so each kobject is
+ * parsed only once. Name and address lookups go through the maps below.
+ */
 class DDriver : public ParserPlugin {
+private:
+    std::unordered_map<size_t, std::shared_ptr<device>> device_maps;        /* addr -> device */
+    std::unordered_map<size_t, std::shared_ptr<driver>> driver_maps;        /* addr -> driver */
+    std::unordered_map<std::string, std::shared_ptr<bus_type>> bus_maps;
+    std::unordered_map<std::string, std::shared_ptr<class_type>> class_maps;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<driver>>> driver_name_maps;
+    /* column widths */
+    size_t bus_dev_name_max = 10;
+    size_t drv_name_max = 10;
+    size_t compat_max = 10;
+
+    void load_device_model();
+    template <typename T>
+    static size_t name_width(const std::vector<std::shared_ptr<T>>& list, size_t min_len){
+        for (const auto& ptr : list) {
+            min_len = std::max(min_len, ptr->name.size());
+        }
+        return min_len;
+    }
+
 public:
     std::vector<std::shared_ptr<bus_type>> bus_list;
     std::vector<std::shared_ptr<class_type>> class_list;
@@ -51,80 +51,161 @@ void Devicetree::cmd_main(void) {
     // TODO
 }
 
-std::shared_ptr<Property> Devicetree::getprop(ulong node_addr,const std::string& name){
-    if (root_node == nullptr){
-        root_node = read_node("", root_addr);
+std::shared_ptr<device_tree> Devicetree::tree;
+
+void Devicetree::load_tree(){
+    if (root_node != nullptr){
+        return;
     }
+    if (tree == nullptr){
+        tree = std::make_shared<device_tree>();
+        read_tree();
+    }
+    root_node = tree->root;
+}
+
+std::shared_ptr<Property> Devicetree::getprop(ulong node_addr,const std::string& name){
     std::shared_ptr<device_node> node_ptr = find_node_by_addr(node_addr);
     if(node_ptr == nullptr) return nullptr;
-    for (auto it = node_ptr->props.begin(); it != node_ptr->props.end(); ++it) {
-        std::shared_ptr<Property> prop = *it;
-        if(prop->name == name){
-            return prop;
+    auto it = node_ptr->prop_maps.find(name);
+    if (it == node_ptr->prop_maps.end()){
+        return nullptr;
+    }
+    return it->second;
+}
+
+/* node and property names point into the dtb, so most of them are shared */
+const std::string& Devicetree::read_name(ulong addr){
+    auto it = tree->str_cache.find(addr);
+    if (it != tree->str_cache.end()){
+        return it->second;
+    }
+    return tree->str_cache.emplace(addr, read_cstring(addr,64, "device_node name")).first->second;
+}
+
+void Devicetree::add_node(std::shared_ptr<device_node> node_ptr){
+    tree->node_list.push_back(node_ptr);
+    tree->addr_maps[node_ptr->addr] = node_ptr;
+    tree->path_maps[node_ptr->node_path] = node_ptr;
+    std::vector<std::string> keys = {node_ptr->full_name, node_ptr->name, node_ptr->node_path};
+    for (size_t i = 0; i < keys.size(); i++){
+        if (std::find(keys.begin(), keys.begin() + i, keys[i]) == keys.begin() + i){
+            tree->name_maps[keys[i]].push_back(node_ptr);
+        }
+    }
+    auto prop_it = node_ptr->prop_maps.find("phandle");
+    if (prop_it != node_ptr->prop_maps.end() && prop_it->second->length == 4){
+        tree->phandle_maps[ntohl(UINT(prop_it->second->value))] = node_ptr;
+    }
+    prop_it = node_ptr->prop_maps.find("compatible");
+    if (prop_it != node_ptr->prop_maps.end() && prop_it->second->length > 0){
+        // compatible is a list of NUL terminated strings
+        const char* val = (const char*)prop_it->second->value;
+        int pos = 0;
+        while (pos < prop_it->second->length){
+            std::string compat(val + pos, strnlen(val + pos, prop_it->second->length - pos));
+            if (!compat.empty()){
+                tree->compatible_maps[compat].push_back(node_ptr);
+            }
+            pos += compat.size() + 1;
         }
     }
-    return nullptr;
 }
 
-std::shared_ptr<device_node> Devicetree::read_node(const std::string& path, ulong node_addr){
+/*
+ * child_addr and sibling_addr come from the same read of the device_node,
+ * for the tree walk.
+ */
+std::shared_ptr<device_node> Devicetree::read_node(const std::string& path, ulong node_addr, ulong& child_addr, ulong& sibling_addr){
     if (!is_kvaddr(node_addr)) return nullptr;
     void *node_buf = read_struct(node_addr,"device_node");
     if(node_buf == nullptr) return nullptr;
+    child_addr = ULONG(node_buf + field_offset(device_node,child));
+    sibling_addr = ULONG(node_buf + field_offset(device_node,sibling));
     std::shared_ptr<device_node> node_ptr = std::make_shared<device_node>();
     node_ptr->addr = node_addr;
-
     ulong full_name_addr = ULONG(node_buf + field_offset(device_node,full_name));
-    std::string full_name = read_cstring(full_name_addr,64, "device_node_full_name");
-    std::string node_path;
     if(node_addr == root_addr){
-        full_name = "/";
-        node_path = full_name;
+        node_ptr->full_name = "/";
+        node_ptr->node_path = "/";
     }else{
-        node_path = path + "/" + full_name;
-    }
-    node_ptr->full_name = full_name;
-    std::string temstr = node_path;
-    if (temstr.size() >= 2 && temstr[0] == '/' && temstr[1] == '/') {
-        node_ptr->node_path = temstr.substr(1);
+        node_ptr->full_name = read_cstring(full_name_addr,64, "device_node_full_name");
+        node_ptr->node_path = (path == "/" ? "" : path) + "/" + node_ptr->full_name;
     }
     ulong name_addr = ULONG(node_buf + field_offset(device_node,name));
-    node_ptr->name = read_cstring(name_addr,64, "device_node name");
+    if (is_kvaddr(name_addr)){
+        node_ptr->name = read_name(name_addr);
+    }
     ulong prop_addr = ULONG(node_buf + field_offset(device_node,properties));
     if (is_kvaddr(prop_addr)){
-        std::vector<std::shared_ptr<Property>> props = read_propertys(prop_addr);
-        node_ptr->props = props;
-    }
-    ulong child = ULONG(node_buf + field_offset(device_node,child));
-    if (is_kvaddr(child)){
-        node_ptr->child = read_node(node_path,child);
-    }
-    ulong sibling = ULONG(node_buf + field_offset(device_node,sibling));
-    if (is_kvaddr(sibling)){
-        node_ptr->sibling = read_node(path,sibling);
+        node_ptr->props = read_propertys(prop_addr);
+        for (const auto& prop : node_ptr->props){
+            node_ptr->prop_maps.emplace(prop->name, prop);
+        }
     }
-    node_addr_maps[node_addr] = node_ptr;
-    node_path_maps[node_path] = node_ptr;
     FREEBUF(node_buf);
     return node_ptr;
 }
 
+/*
+ * Walk the tree with an explicit stack instead of recursing on child and
+ * sibling, a long sibling chain no longer means a deep call stack.
+ */
+void Devicetree::read_tree(){
+    struct walk_item {
+        ulong addr;
+        std::shared_ptr<device_node> parent;
+        std::shared_ptr<device_node> prev;  /* previous sibling */
+    };
+    std::vector<walk_item> stack;
+    stack.push_back({root_addr, nullptr, nullptr});
+    while (!stack.empty()){
+        walk_item item = stack.back();
+        stack.pop_back();
+        if (tree->addr_maps.find(item.addr) != tree->addr_maps.end()){
+            continue;
+        }
+        ulong child = 0;
+        ulong sibling = 0;
+        std::shared_ptr<device_node> node_ptr = read_node(item.parent ? item.parent->node_path : "", item.addr, child, sibling);
+        if (node_ptr == nullptr){
+            continue;
+        }
+        if (item.prev){
+            item.prev->sibling = node_ptr;
+        }else if (item.parent){
+            item.parent->child = node_ptr;
+        }else{
+            tree->root = node_ptr;
+        }
+        add_node(node_ptr);
+        if (is_kvaddr(sibling) && item.parent){
+            stack.push_back({sibling, item.parent, node_ptr});
+        }
+        if (is_kvaddr(child)){
+            stack.push_back({child, node_ptr, nullptr});
+        }
+    }
+}
+
 std::vector<std::shared_ptr<Property>> Devicetree::read_propertys(ulong addr){
     std::vector<std::shared_ptr<Property>> res;
     while (is_kvaddr(addr)){
         std::shared_ptr<Property> prop = std::make_shared<Property>();
         prop->addr = addr;
+        prop->value = nullptr;
         void *prop_buf = read_struct(addr,"property");
         if(prop_buf == nullptr) return res;
         ulong name_addr = ULONG(prop_buf + field_offset(property,name));
-        prop->name = read_cstring(name_addr,64,"property_name");
+        prop->name = read_name(name_addr);
         int length = UINT(prop_buf + field_offset(property,length));
         prop->length = length;
         ulong value_addr = ULONG(prop_buf + field_offset(property,value));
         if(length > 0){
             prop->value = malloc(length);
-            void *prop_val = read_memory(value_addr,length,"property_value");
-            memcpy(prop->value, prop_val, length);
-            FREEBUF(prop_val);
+            if (!read_struct(value_addr, prop->value, length, "property_value")){
+                memset(prop->value, 0, length);
+            }
         }
         res.push_back(prop);
         addr = ULONG(prop_buf + field_offset(property,next));
@@ -134,9 +215,7 @@ std::vector<std::shared_ptr<Property>> Devicetree::read_propertys(ulong addr){
 }
 
 std::vector<DdrRange> Devicetree::get_ddr_size(){
-    if (root_node == nullptr){
-        root_node = read_node("", root_addr);
-    }
+    load_tree();
     std::vector<DdrRange> res;
     std::vector<std::shared_ptr<device_node>> nodes = find_node_by_name("memory");
     if (nodes.size() == 0)
@@ -178,34 +257,48 @@ std::vector<DdrRange> Devicetree::parse_memory_regs(std::shared_ptr<Property> pr
 }
 
 std::vector<std::shared_ptr<device_node>> Devicetree::find_node_by_name(const std::string& name){
-    std::string node_path;
-    std::shared_ptr<device_node> node_ptr;
-    std::vector<std::shared_ptr<device_node>> res;
-    if (root_node == nullptr){
-        root_node = read_node("", root_addr);
-    }
-    for (const auto& node_item : node_path_maps) {
-        node_path = node_item.first;
-        node_ptr = node_item.second;
-        size_t pos = node_path.find_last_of(name);
-        if (pos == std::string::npos) continue;
-        if(node_ptr->full_name == name || node_ptr->name == name || node_ptr->node_path == name){
-            res.push_back(node_ptr);
-        }
+    load_tree();
+    auto it = tree->name_maps.find(name);
+    if (it == tree->name_maps.end()){
+        return {};
     }
-    return res;
+    return it->second;
 }
 
 std::shared_ptr<device_node> Devicetree::find_node_by_addr(ulong addr){
-    if (root_node == nullptr){
-        root_node = read_node("", root_addr);
+    load_tree();
+    auto it = tree->addr_maps.find(addr);
+    if (it == tree->addr_maps.end()){
+        return nullptr;
     }
-    for (const auto& node_item : node_addr_maps) {
-        if(node_item.first == addr){
-            return node_item.second;
-        }
+    return it->second;
+}
+
+std::shared_ptr<device_node> Devicetree::find_node_by_path(const std::string& path){
+    load_tree();
+    auto it = tree->path_maps.find(path);
+    if (it == tree->path_maps.end()){
+        return nullptr;
+    }
+    return it->second;
+}
+
+std::shared_ptr<device_node> Devicetree::find_node_by_phandle(uint phandle){
+    load_tree();
+    auto it = tree->phandle_maps.find(phandle);
+    if (it == tree->phandle_maps.end()){
+        return nullptr;
+    }
+    return it->second;
+}
+
+std::vector<std::shared_ptr<device_node>> Devicetree::find_node_by_compatible(const std::string& compatible){
+    load_tree();
+    auto it = tree->compatible_maps.find(compatible);
+    if (it == tree->compatible_maps.end()){
+        return {};
     }
-    return nullptr;
+    return it->second;
 }
 
 bool Devicetree::is_str_prop(const std::string& name) {
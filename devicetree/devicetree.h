@@ -36,10 +36,27 @@ struct device_node {
     std::string full_name;
     std::string node_path;
     std::vector<std::shared_ptr<Property>> props;
+    std::unordered_map<std::string, std::shared_ptr<Property>> prop_maps;
     std::shared_ptr<device_node> child;
     std::shared_ptr<device_node> sibling;
 };
 
+/*
+ * The tree read out of of_root, shared by every Devicetree user so it is
+ * loaded once per session. Nodes are kept in depth-first order in one
+ * array, the maps index it by address, path, name, phandle and compatible.
+ */
+struct device_tree {
+    std::shared_ptr<device_node> root;
+    std::vector<std::shared_ptr<device_node>> node_list;
+    std::unordered_map<ulong, std::shared_ptr<device_node>> addr_maps;
+    std::unordered_map<std::string, std::shared_ptr<device_node>> path_maps;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<device_node>>> name_maps;
+    std::unordered_map<uint, std::shared_ptr<device_node>> phandle_maps;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<device_node>>> compatible_maps;
+    std::unordered_map<ulong, std::string> str_cache; /* name strings by address, they live in the dtb */
+};
+
 class Devicetree : public ParserPlugin {
 private:
     std::vector<std::string> str_props={
@@ -72,23 +89,31 @@ private:
         "strength",
     };
 
+    static std::shared_ptr<device_tree> tree;
+
+    const std::string& read_name(ulong addr);
+    void add_node(std::shared_ptr<device_node> node_ptr);
+
 public:
     Devicetree();
-    ulong root_addr;
+    ulong root_addr = 0;
     std::shared_ptr<device_node> root_node;
-    std::unordered_map<ulong, std::shared_ptr<device_node>> node_addr_maps;
-    std::unordered_map<std::string, std::shared_ptr<device_node>> node_path_maps;
 
     void cmd_main(void) override;
+    void load_tree();
     std::shared_ptr<Property> getprop(ulong node_addr,const std::string& name);
     std::vector<DdrRange> get_ddr_size();
     std::vector<std::shared_ptr<device_node>> find_node_by_name(const std::string& name);
     std::shared_ptr<device_node> find_node_by_addr(ulong addr);
+    std::shared_ptr<device_node> find_node_by_path(const std::string& path);
+    std::shared_ptr<device_node> find_node_by_phandle(uint phandle);
+    std::vector<std::shared_ptr<device_node>> find_node_by_compatible(const std::string& compatible);
     bool is_str_prop(const std::string& name);
     bool is_int_prop(const std::string& name);
     std::vector<DdrRange> parse_memory_regs(std::shared_ptr<Property> prop);
     std::vector<std::shared_ptr<Property>> read_propertys(ulong addr);
-    std::shared_ptr<device_node> read_node(const std::string& path, ulong node_addr);
+    std::shared_ptr<device_node> read_node(const std::string& path, ulong node_addr, ulong& child_addr, ulong& sibling_addr);
+    void read_tree();
 };
 
 #endif // DEVICE_TREE_DEFS_H_
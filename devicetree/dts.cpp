@@ -27,10 +27,12 @@ void Dts::cmd_main(void) {
     int flags;
     std::string cppString;
     if (argcnt < 2) cmd_usage(pc->curcmd, SYNOPSIS);
+    load_tree();
     if (root_node == nullptr){
-        root_node = read_node("", root_addr);
+        fprintf(fp, "device tree is not available!\n");
+        return;
     }
-    while ((c = getopt(argcnt, args, "afb:n:m")) != EOF) {
+    while ((c = getopt(argcnt, args, "afb:n:c:m")) != EOF) {
         switch(c) {
             case 'a': //print dts info
             {
@@ -56,7 +58,9 @@ void Dts::cmd_main(void) {
                     unsigned long addr = std::stoul(cppString, nullptr, 16);
                     if(is_kvaddr(addr)){
                         std::shared_ptr<device_node> node_ptr = find_node_by_addr(addr);
-                        print_node(node_ptr,flags);
+                        if (node_ptr != nullptr){
+                            print_node(node_ptr,flags);
+                        }
                     }else{
                         fprintf(fp, "invalid address %lx\n",addr);
                     }
@@ -68,6 +72,15 @@ void Dts::cmd_main(void) {
                 }
                 break;
             }
+            case 'c': //print the nodes by compatible string
+            {
+                flags = DTS_SHOW | DTS_ADDR;
+                cppString.assign(optarg);
+                for (const auto& node_ptr : find_node_by_compatible(cppString)) {
+                    print_node(node_ptr,flags);
+                }
+                break;
+            }
             case 'm': //print memory size
                 print_ddr_info();
                 break;
@@ -89,6 +102,7 @@ Dts::Dts(){
             "  dts -f\n"
             "  dts -b\n"
             "  dts -n <name>\n"
+            "  dts -c <compatible>\n"
             "  dts -m\n"
             "  This command dumps the dts info.",
         "\n",
@@ -119,6 +133,14 @@ Dts::Dts(){
         "           reg=< 0x0 0x40000000 0x0 0x3ee00000 0x0 0x80000000 0x0 0x40000000 >;",
         "       };",
         "\n",
+        "  Display the nodes by compatible string",
+        "    %s> dts -c qcom,rpm-msg-ram",
+        "       /soc/memory@045f0000",
+        "       0xffffff806f279248:memory@045f0000{",
+        "           0xffffff806f279300:compatible=<qcom,rpm-msg-ram>;",
+        "           0xffffff806f27932c:reg=< 0x45f0000 0x4000 >;",
+        "       };",
+        "\n",
         "  Display physic memory total size:",
         "    %s> dts -m",
         "       =========================================",
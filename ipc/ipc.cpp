@@ -14,6 +14,9 @@
  */
 
 #include "ipc.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -106,177 +109,203 @@ IPCLog::IPCLog(){
         "  Save all ipc log",
         "    %s> ipc -s",
         "    Save mmc0 to /xxx/ipc_log/mmc0",
+        "    Save 213 contexts 41.37MB, 0.284s",
         "\n",
     };
     initialize();
 }
 
 void IPCLog::print_ipc_log(std::string name){
+    std::vector<std::shared_ptr<ipc_log>> log_list;
     for (const auto& log_ptr : ipc_list) {
-        if (log_ptr->name.empty() || name != log_ptr->name){
-            continue;
-        }
-        uint32_t magic = read_ulong(log_ptr->nd_read_page + field_offset(ipc_log_page,hdr) + field_offset(ipc_log_page_header,magic),"magic");
-        if (magic != IPC_LOGGING_MAGIC_NUM){
-            continue;
-        }
-        // int list_off = field_offset(ipc_log_page_header, list);
-        // for (const auto& header_addr : for_each_list(page_list,list_off)) {
-        //     ulong log_page_addr = header_addr - field_offset(ipc_log_page,hdr);
-        //     fprintf(fp, "ipc_log_page:%#lx \n",log_page_addr);
-        // }
-        if (log_ptr->logs.size() == 0){
-            parser_ipc_log_page(log_ptr);
-        }
-        for (const auto& log : log_ptr->logs){
-            fprintf(fp, "%s",log.c_str());
+        if (!log_ptr->name.empty() && name == log_ptr->name){
+            log_list.push_back(log_ptr);
         }
     }
+    load_ipc_logs(log_list);
+    for (const auto& log_ptr : log_list) {
+        fwrite(log_ptr->logs.data(), 1, log_ptr->logs.size(), fp);
+    }
 }
 
-void IPCLog::parser_ipc_log_page(std::shared_ptr<ipc_log> log_ptr){
-    ulong curr_read_page = log_ptr->nd_read_page;
+/*
+ * Read the page ring of one context, starting at nd_read_page. Every page
+ * is read whole in one go, header and data, and the data is appended to
+ * log_ptr->raw. Runs on the main thread since readmem is not thread safe.
+ */
+bool IPCLog::read_ipc_log_pages(std::shared_ptr<ipc_log> log_ptr){
+    size_t page_size = struct_size(ipc_log_page);
+    size_t data_size = field_size(ipc_log_page,data);
+    size_t data_off = field_offset(ipc_log_page,data);
+    size_t hdr_off = field_offset(ipc_log_page,hdr);
     ulong page_list = log_ptr->addr + field_offset(ipc_log_context,page_list);
-    uint16_t write_offset = read_ushort(curr_read_page + field_offset(ipc_log_page,hdr)
-            + field_offset(ipc_log_page_header,write_offset),"write_offset");
-    uint16_t nd_read_offset = read_ushort(curr_read_page + field_offset(ipc_log_page,hdr)
-            + field_offset(ipc_log_page_header,nd_read_offset),"nd_read_offset");
-    bool wrapped_around = false;
-    if (nd_read_offset <= write_offset){
-        wrapped_around = false;
-    }else{
-        wrapped_around = true;
+    std::vector<char> first_page(page_size);
+    std::vector<char> page_buf(page_size);
+    if (!is_kvaddr(log_ptr->nd_read_page)
+        || !read_struct(log_ptr->nd_read_page, first_page.data(), page_size, "ipc_log_page")){
+        return false;
     }
-    std::vector<char> ipcLogBuf;
-    size_t bytes_to_copy = 0;
-    ulong start_addr = 0;
-    void* data_buf = nullptr;
-    while (is_kvaddr(curr_read_page)){
-        // fprintf(fp, "ipc_log_page:%#lx \n",curr_read_page);
-        void *log_page_buf = read_struct(curr_read_page,"ipc_log_page");
-        if (!log_page_buf) {
-            return;
-        }
-        write_offset = USHORT(log_page_buf + field_offset(ipc_log_page,hdr) + field_offset(ipc_log_page_header,write_offset));
-        nd_read_offset = USHORT(log_page_buf + field_offset(ipc_log_page,hdr) + field_offset(ipc_log_page_header,nd_read_offset));
-        FREEBUF(log_page_buf);
-
-        if (nd_read_offset <= write_offset){
-            bytes_to_copy = write_offset - nd_read_offset;
-        }else{
-            bytes_to_copy = field_size(ipc_log_page,data) - nd_read_offset;
+    if (UINT(first_page.data() + hdr_off + field_offset(ipc_log_page_header,magic)) != IPC_LOGGING_MAGIC_NUM){
+        return false;
+    }
+    auto write_offset_of = [&](const std::vector<char>& buf) -> size_t {
+        return std::min<size_t>(USHORT(buf.data() + hdr_off + field_offset(ipc_log_page_header,write_offset)), data_size);
+    };
+    auto nd_read_offset_of = [&](const std::vector<char>& buf) -> size_t {
+        return std::min<size_t>(USHORT(buf.data() + hdr_off + field_offset(ipc_log_page_header,nd_read_offset)), data_size);
+    };
+    bool wrapped_around = nd_read_offset_of(first_page) > write_offset_of(first_page);
+    ulong curr_read_page = log_ptr->nd_read_page;
+    page_buf = first_page;
+    for (size_t cnt = 0; cnt < IPC_LOG_MAX_PAGES && is_kvaddr(curr_read_page); cnt++){
+        if (cnt > 0 && !read_struct(curr_read_page, page_buf.data(), page_size, "ipc_log_page")){
+            break;
         }
-        if (bytes_to_copy <= 0){
+        size_t write_offset = write_offset_of(page_buf);
+        size_t nd_read_offset = nd_read_offset_of(page_buf);
+        size_t bytes_to_copy = (nd_read_offset <= write_offset) ? write_offset - nd_read_offset : data_size - nd_read_offset;
+        if (bytes_to_copy == 0){
             break;
         }
-        start_addr = curr_read_page + field_offset(ipc_log_page,data) + nd_read_offset;
-        data_buf = read_memory(start_addr,bytes_to_copy,"data");
-        appendBuffer(ipcLogBuf, data_buf, bytes_to_copy);
-        FREEBUF(data_buf);
-        // fprintf(fp, "bytes_to_copy:%d \n",bytes_to_copy);
-        if (wrapped_around == false && write_offset < field_size(ipc_log_page,data)){
+        const char* data = page_buf.data() + data_off + nd_read_offset;
+        log_ptr->raw.insert(log_ptr->raw.end(), data, data + bytes_to_copy);
+        if (wrapped_around == false && write_offset < data_size){
             break;
         }
-        ulong list_addr = curr_read_page + field_offset(ipc_log_page,hdr) + field_offset(ipc_log_page_header,list);
-        ulong list = read_pointer(list_addr,"list");
+        ulong list = ULONG(page_buf.data() + hdr_off + field_offset(ipc_log_page_header,list));
         if (list == page_list){
             list = read_pointer(list,"list");
         }
-        curr_read_page = list - field_offset(ipc_log_page_header,list) - field_offset(ipc_log_page,hdr);
+        curr_read_page = list - field_offset(ipc_log_page_header,list) - hdr_off;
         if (curr_read_page == log_ptr->nd_read_page){
             break;
         }
     }
     if (wrapped_around){
-        write_offset = read_ushort(log_ptr->nd_read_page + field_offset(ipc_log_page,hdr) + field_offset(ipc_log_page_header,write_offset),"write_offset");
-        bytes_to_copy = write_offset;
-        start_addr = log_ptr->nd_read_page + field_offset(ipc_log_page,data);
-        data_buf = read_memory(start_addr,bytes_to_copy,"data");
-        appendBuffer(ipcLogBuf, data_buf, bytes_to_copy);
-        FREEBUF(data_buf);
+        const char* data = first_page.data() + data_off;
+        log_ptr->raw.insert(log_ptr->raw.end(), data, data + write_offset_of(first_page));
     }
+    return true;
+}
 
-    size_t len = 0;
-    char* dataPtr = ipcLogBuf.data();
+/*
+ * Decode the tsv records of log.raw into log.logs, straight from the
+ * buffer. It only touches the log itself, so contexts can be decoded on
+ * worker threads.
+ */
+void IPCLog::decode_ipc_log(ipc_log& log){
+    const char* dataPtr = log.raw.data();
+    const char* end = dataPtr + log.raw.size();
     uint64_t TimeStamp = 0;
     uint64_t TimeQtimer = 0;
-    while (len < ipcLogBuf.size()) {
-        len += sizeof(tsv_header);
-        dataPtr += sizeof(tsv_header);
-
-        tsv_header msg = *reinterpret_cast<tsv_header*>(dataPtr);
-        len += sizeof(tsv_header);
+    char prefix[64];
+    auto read_value = [](const char* ptr, size_t size) -> uint64_t {
+        if (size == 4){
+            uint32_t val;
+            memcpy(&val, ptr, sizeof(val));
+            return val;
+        }
+        uint64_t val = 0;
+        memcpy(&val, ptr, std::min<size_t>(size, sizeof(val)));
+        return val;
+    };
+    log.logs.reserve(log.raw.size() * 2);
+    while (dataPtr + 2 * sizeof(tsv_header) <= end) {
+        dataPtr += sizeof(tsv_header);  // header of the whole message
+        tsv_header msg;
+        memcpy(&msg, dataPtr, sizeof(msg));
         dataPtr += sizeof(tsv_header);
         if (msg.type == TSV_TYPE_TIMESTAMP){
-            if (msg.size == 4){
-                TimeStamp = *reinterpret_cast<uint32_t*>(dataPtr);
-            }else if (msg.size == 8){
-                TimeStamp = *reinterpret_cast<uint64_t*>(dataPtr);
+            if (dataPtr + msg.size > end) break;
+            if (msg.size == 4 || msg.size == 8){
+                TimeStamp = read_value(dataPtr, msg.size);
             }
-            len += msg.size;
             dataPtr += msg.size;
         }
-        msg = *reinterpret_cast<tsv_header*>(dataPtr);
-        len += sizeof(tsv_header);
+        if (dataPtr + sizeof(tsv_header) > end) break;
+        memcpy(&msg, dataPtr, sizeof(msg));
         dataPtr += sizeof(tsv_header);
         if (msg.type == TSV_TYPE_QTIMER){
-            if (msg.size == 4){
-                TimeQtimer = *reinterpret_cast<uint32_t*>(dataPtr);
-            }else if (msg.size == 8){
-                TimeQtimer = *reinterpret_cast<uint64_t*>(dataPtr);
+            if (dataPtr + msg.size > end) break;
+            if (msg.size == 4 || msg.size == 8){
+                TimeQtimer = read_value(dataPtr, msg.size);
             }
-            len += msg.size;
             dataPtr += msg.size;
         }
-        msg = *reinterpret_cast<tsv_header*>(dataPtr);
-        len += sizeof(tsv_header);
+        if (dataPtr + sizeof(tsv_header) > end) break;
+        memcpy(&msg, dataPtr, sizeof(msg));
         dataPtr += sizeof(tsv_header);
         if (msg.type == TSV_TYPE_BYTE_ARRAY){
-            std::string str_data(dataPtr, msg.size);
-            std::ostringstream oss;
-            if (str_data.find('\n') != std::string::npos) {
-                oss << "[ " << std::fixed << std::setprecision(9) << TimeStamp / 1000000000.0 << " 0x" << std::hex << TimeQtimer << "]   " << str_data;
-            } else {
-                oss << "[ " << std::fixed << std::setprecision(9) << TimeStamp / 1000000000.0 << " 0x" << std::hex << TimeQtimer << "]   " << str_data << "\n";
+            if (dataPtr + msg.size > end) break;
+            int len = snprintf(prefix, sizeof(prefix), "[ %.9f 0x%" PRIx64 "]   ", TimeStamp / 1000000000.0, TimeQtimer);
+            log.logs.append(prefix, len);
+            log.logs.append(dataPtr, msg.size);
+            if (memchr(dataPtr, '\n', msg.size) == nullptr) {
+                log.logs.push_back('\n');
             }
-            log_ptr->logs.push_back(oss.str());
-            len += msg.size;
             dataPtr += msg.size;
         }
     }
+    std::vector<char>().swap(log.raw);
 }
 
-void IPCLog::appendBuffer(std::vector<char>& destBuf, void* sourceBuf, size_t length) {
-    size_t currentSize = destBuf.size();
-    destBuf.resize(currentSize + length);
-    memcpy(destBuf.data() + currentSize, sourceBuf, length);
+/*
+ * The pages of all contexts are read first, then the contexts are decoded
+ * on all cpus.
+ */
+void IPCLog::load_ipc_logs(const std::vector<std::shared_ptr<ipc_log>>& log_list){
+    std::vector<ipc_log*> todo;
+    for (const auto& log_ptr : log_list) {
+        if (log_ptr->parsed){
+            continue;
+        }
+        log_ptr->parsed = true;
+        if (read_ipc_log_pages(log_ptr)){
+            todo.push_back(log_ptr.get());
+        }
+    }
+    size_t nr_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), todo.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < nr_threads; t++) {
+        workers.emplace_back([&todo, &next]() {
+            for (size_t i = next++; i < todo.size(); i = next++) {
+                decode_ipc_log(*todo[i]);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
 }
 
-
 void IPCLog::save_ipc_log(){
+    load_ipc_logs(ipc_list);
+    std::stringstream ipc_dir_path = get_curpath();
+    ipc_dir_path << "/ipc_log/";
+    mkdir(ipc_dir_path.str().c_str(), 0777);
+    size_t total = 0;
+    size_t cnt = 0;
+    auto start = std::chrono::steady_clock::now();
     for (const auto& log_ptr : ipc_list) {
-        uint32_t magic = read_ulong(log_ptr->nd_read_page + field_offset(ipc_log_page,hdr) + field_offset(ipc_log_page_header,magic),"magic");
-        if (magic != IPC_LOGGING_MAGIC_NUM){
+        if (log_ptr->logs.empty()){
             continue;
         }
-        if (log_ptr->logs.size() == 0){
-            parser_ipc_log_page(log_ptr);
-        }
-        std::stringstream ipc_file_path = get_curpath();
-        ipc_file_path << "/ipc_log/";
-        mkdir(ipc_file_path.str().c_str(), 0777);
-        ipc_file_path << log_ptr->name;
-        FILE* ipc_file = fopen(ipc_file_path.str().c_str(), "wb");
+        std::string ipc_file_path = ipc_dir_path.str() + log_ptr->name;
+        FILE* ipc_file = fopen(ipc_file_path.c_str(), "wb");
         if (!ipc_file) {
-            fprintf(fp, "Can't open %s\n", ipc_file_path.str().c_str());
+            fprintf(fp, "Can't open %s\n", ipc_file_path.c_str());
             return;
         }
-        for (const auto& log : log_ptr->logs){
-            fwrite(log.c_str(),log.size(), 1, ipc_file);
-        }
+        // the whole context in one write
+        fwrite(log_ptr->logs.data(), log_ptr->logs.size(), 1, ipc_file);
         fclose(ipc_file);
-        fprintf(fp, "Save %s to %s\n", log_ptr->name.c_str(),ipc_file_path.str().c_str());
+        total += log_ptr->logs.size();
+        cnt++;
+        fprintf(fp, "Save %s to %s\n", log_ptr->name.c_str(),ipc_file_path.c_str());
     }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    fprintf(fp, "Save %zu contexts %s, %.3fs\n", cnt, csize(total).c_str(), elapsed.count());
 }
 
 void IPCLog::parser_ipc_log(){
@@ -32,7 +32,9 @@ struct ipc_log {
     ulong write_page;
     ulong read_page;
     ulong nd_read_page;
-    std::vector<std::string> logs;
+    bool parsed = false;
+    std::vector<char> raw;      /* tsv records of the page ring, oldest first */
+    std::string logs;           /* decoded text */
 };
 
 #define TSV_TYPE_INVALID        0
@@ -43,6 +45,7 @@ struct ipc_log {
 #define TSV_TYPE_QTIMER         5
 #define IPC_LOG_CONTEXT_MAGIC_NUM   0x25874452
 #define IPC_LOGGING_MAGIC_NUM       0x52784425
+#define IPC_LOG_MAX_PAGES           65536   /* bound of the page ring walk */
 
 class IPCLog : public ParserPlugin {
 public:
@@ -53,8 +56,9 @@ public:
     void print_ipc_info();
     void save_ipc_log();
     void print_ipc_log(std::string name);
-    void parser_ipc_log_page(std::shared_ptr<ipc_log> log_ptr);
-    void appendBuffer(std::vector<char> &destBuf, void *sourceBuf, size_t length);
+    void load_ipc_logs(const std::vector<std::shared_ptr<ipc_log>>& log_list);
+    bool read_ipc_log_pages(std::shared_ptr<ipc_log> log_ptr);
+    static void decode_ipc_log(ipc_log& log);
     DEFINE_PLUGIN_INSTANCE(IPCLog)
 };
 
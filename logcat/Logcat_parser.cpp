@@ -14,6 +14,7 @@
  */
 
 #include "Logcat_parser.h"
+#include "utils/symbol_index.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -118,6 +119,7 @@ void Logcat_Parser::cmd_main(void) {
                             }
                         }
                     }
+                    SymbolIndex::instance().recheck();
                 } catch (...) {
                     fprintf(fp, "invaild arg %s\n",optarg);
                 }
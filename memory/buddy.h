@@ -17,6 +17,7 @@
 #define BUDDY_DEFS_H_
 
 #include "plugin.h"
+#include "page_account.h"
 
 enum zone_watermarks {
     WMARK_MIN,
@@ -74,6 +75,7 @@ public:
     std::vector<std::vector<ulong>> parser_free_list(ulong addr);
     void get_migratetype_names();
     void print_buddy_info();
+    void print_zone_page_owner();
     void print_memory_node();
     void print_memory_zone(std::string addr);
     void print_node_info(std::shared_ptr<pglist_data> node_ptr);
@@ -29,11 +29,14 @@ void Cma::cmd_main(void) {
     if (mem_list.size() == 0){
         parser_cma_areas();
     }
-    while ((c = getopt(argcnt, args, "au:f:")) != EOF) {
+    while ((c = getopt(argcnt, args, "aou:f:")) != EOF) {
         switch(c) {
             case 'a':
                 print_cma_areas();
                 break;
+            case 'o':
+                print_cma_page_owner();
+                break;
             case 'u':
                 cppString.assign(optarg);
                 print_cma_page_status(cppString,true);
@@ -65,6 +68,7 @@ Cma::Cma(){
         "-a \n"
             "  cma -u <cma name>\n"
             "  cma -f <cma name>\n"
+            "  cma -o\n"
             "  This command dumps the cma info.",
         "\n",
         "EXAMPLES",
@@ -88,10 +92,9 @@ Cma::Cma(){
         "    size           : 0x2000",
         "    bitmap         : 0xffffff8006986900 ~ 0xffffff8006986a00",
         "    ========================================================================",
-        "    [1]PFN:0xbe000 paddr:0xbe000000 page:0xfffffffe01f80000 allocted",
-        "    [2]PFN:0xbe001 paddr:0xbe001000 page:0xfffffffe01f80040 allocted",
-        "    [3]PFN:0xbe002 paddr:0xbe002000 page:0xfffffffe01f80080 allocted",
-        "    [4]PFN:0xbe003 paddr:0xbe003000 page:0xfffffffe01f800c0 allocted",
+        "    [00001]Pfn:be000~be032 Page:fffffffe01f80000 paddr:be000000 size:200KB allocted",
+        "    [00002]Pfn:be040~be1c0 Page:fffffffe01f81000 paddr:be040000 size:1.50MB allocted",
+        "    [00003]Pfn:be200~be220 Page:fffffffe01f88000 paddr:be200000 size:128KB allocted",
         "\n",
         "  Display the free pages of specified cma region by cma name:",
         "    %s> cma -f adsp_region",
@@ -103,9 +106,15 @@ Cma::Cma(){
         "    size           : 0x2000",
         "    bitmap         : 0xffffff8006986900 ~ 0xffffff8006986a00",
         "    ========================================================================",
-        "    [1]PFN:0xbe032 paddr:0xbe032000 page:0xfffffffe01f80c80 free",
-        "    [2]PFN:0xbe033 paddr:0xbe033000 page:0xfffffffe01f80cc0 free",
-        "    [3]PFN:0xbe034 paddr:0xbe034000 page:0xfffffffe01f80d00 free",
+        "    [00001]Pfn:be032~be040 Page:fffffffe01f80c80 paddr:be032000 size:56KB free",
+        "    [00002]Pfn:be1c0~be200 Page:fffffffe01f87000 paddr:be1c0000 size:256KB free",
+        "    [00003]Pfn:be220~be800 Page:fffffffe01f88800 paddr:be220000 size:5.88MB free",
+        "\n",
+        "  Display the owner of the pages in every cma region:",
+        "    %s> cma -o",
+        "    Name                 Size       Used       Owner",
+        "    adsp_region          8.00MB     2.20MB     Buddy:5.80MB Dmabuf:2.20MB",
+        "    linux,cma            32.00MB    12.38MB    Buddy:9.12MB Anon:10.50MB File:10.00MB Dmabuf:2.38MB",
         "\n",
     };
     initialize();
@@ -195,19 +204,67 @@ void Cma::print_cma_areas(){
     fprintf(fp, "allocated:%s\n",csize(total_use).c_str());
 }
 
-int Cma::get_cma_used_size(std::shared_ptr<cma_mem> cma){
-    // calc how many byte of bitmap
-    size_t nr_byte = (cma->count >> cma->order_per_bit) / 8;
+/*
+ * Used only says which part of a region is held by cma_alloc, movable
+ * anon and file pages borrow the rest, the owner of each page comes from
+ * the PageAccount tags.
+ */
+void Cma::print_cma_page_owner(){
+    std::shared_ptr<PageAccount> account = PageAccount::get_instance();
+    size_t max_len = 4;
+    for (const auto& cma : mem_list) {
+        max_len = std::max(max_len,cma->name.size());
+    }
+    std::ostringstream oss;
+    oss << std::left << std::setw(max_len) << "Name" << " "
+        << std::left << std::setw(10) << "Size" << " "
+        << std::left << std::setw(10) << "Used" << " "
+        << "Owner" << "\n";
+    for (const auto& cma : mem_list) {
+        size_t counts[PAGE_TAG_MAX] = {};
+        account->count_range(cma->base_pfn, cma->base_pfn + cma->count, counts);
+        oss << std::left << std::setw(max_len) << cma->name << " "
+            << std::left << std::setw(10) << csize(cma->count * page_size) << " "
+            << std::left << std::setw(10) << csize(cma->allocated_size) << " "
+            << account->format_counts(counts) << "\n";
+    }
+    fprintf(fp, "%s",oss.str().c_str());
+}
+
+ulong Cma::cma_bitmap_maxno(std::shared_ptr<cma_mem> cma){
+    return cma->count >> cma->order_per_bit;
+}
+
+/*
+ * Read the whole bitmap in one go, the kernel allocates it as an array of
+ * longs, so bits past cma_bitmap_maxno() in the last word are cleared here.
+ */
+bool Cma::read_cma_bitmap(std::shared_ptr<cma_mem> cma, std::vector<ulong>& bitmap){
+    ulong nr_bits = cma_bitmap_maxno(cma);
+    size_t nr_words = (nr_bits + BITS_PER_LONG - 1) / BITS_PER_LONG;
+    bitmap.assign(nr_words, 0);
+    if (nr_words == 0 || !is_kvaddr(cma->bitmap)){
+        return false;
+    }
+    if (!read_struct(cma->bitmap, bitmap.data(), nr_words * sizeof(ulong), "cma bitmap")){
+        bitmap.clear();
+        return false;
+    }
+    if (nr_bits % BITS_PER_LONG){
+        bitmap.back() &= (1UL << (nr_bits % BITS_PER_LONG)) - 1;
+    }
+    return true;
+}
+
+ulong Cma::get_cma_used_size(std::shared_ptr<cma_mem> cma){
+    std::vector<ulong> bitmap;
+    if (!read_cma_bitmap(cma, bitmap)){
+        return 0;
+    }
     size_t per_bit_size = (1U << cma->order_per_bit) * page_size;
     size_t used_count = 0;
-    ulong bitmap_addr = cma->bitmap;
-    for (size_t i = 0; i < nr_byte; ++i) {
-        unsigned char bitmap_data = read_byte(bitmap_addr,"cma bitmap");
-        std::bitset<8> bits(bitmap_data);
-        size_t nr_bit = bits.count();
-        // fprintf(fp, "bitmap_addr:%#lx bitmap:%x, nr_bit:%d\n",bitmap_addr, bitmap_data, nr_bit);
-        used_count += nr_bit;
-        bitmap_addr += 1;
+    for (const auto& word : bitmap) {
+        used_count += __builtin_popcountl(word);
     }
     return (used_count * per_bit_size);
 }
@@ -224,42 +281,57 @@ void Cma::print_cma_page_status(std::string name,bool alloc){
                 << std::left << std::setw(10) << "Size"     << ": " << csize(cma->count * page_size);
             fprintf(fp, "%s \n",oss.str().c_str());
             oss.str("");
-            // calc how many byte of bitmap
-            size_t nr_byte = (cma->count >> cma->order_per_bit) / 8;
+            ulong nr_bits = cma_bitmap_maxno(cma);
+            size_t nr_byte = (nr_bits + BITS_PER_LONG - 1) / BITS_PER_LONG * sizeof(ulong);
             oss << std::left << std::setw(10) << "Bitmap" << ": "
                 << std::hex << cma->bitmap
                 << " ~ "
                 << std::hex << (cma->bitmap + nr_byte);
             fprintf(fp, "%s \n",oss.str().c_str());
-            oss.str("");
-            // calc how many page of one bit
-            size_t nr_pages = (1U << cma->order_per_bit);
             fprintf(fp, "========================================================================\n");
-            ulong bitmap_addr = cma->bitmap;
+            std::vector<ulong> bitmap;
+            if (!read_cma_bitmap(cma, bitmap)){
+                fprintf(fp, "Failed to read cma bitmap at address %lx\n", cma->bitmap);
+                continue;
+            }
+            // walk the runs of equal bits, a whole word is skipped when it can not end the run
             int index = 1;
-            for (size_t i = 0; i < nr_byte; i++){
-                unsigned char bitmap_data = read_byte(bitmap_addr,"cma bitmap");
-                for (size_t j = 0; j < 8; j++){ //bit of one byte
-                    int bit_offset = i * 8 + j;
-                    ulong base_pfn = cma->base_pfn + bit_offset * nr_pages;
-                    bool bit_value = (((bitmap_data >> j) & 0x1) ? true:false);
-                    for (size_t k = 0; k < nr_pages; k++){
-                        ulong pfn = base_pfn + k;
-                        physaddr_t paddr = pfn << 12;
-                        ulong page = 0;
-                        if (phys_to_page(paddr, &page) && bit_value == alloc) {
-                            std::ostringstream oss_p;
-                            oss_p << "[" << std::setw(5) << std::setfill('0') << index << "]"
-                                << "Pfn:"   << std::setfill(' ') << std::hex << pfn << " "
-                                << "Page:"  << std::hex << (ulonglong)page << " "
-                                << "paddr:" << std::hex << (ulonglong)paddr << " "
-                                << (bit_value ? "allocted":"free");
-                            fprintf(fp, "%s \n",oss_p.str().c_str());
-                            index += 1;
-                        }
+            ulong bit = 0;
+            while (bit < nr_bits){
+                bool bit_value = (bitmap[bit / BITS_PER_LONG] >> (bit % BITS_PER_LONG)) & 0x1;
+                ulong end = bit + 1;
+                while (end < nr_bits){
+                    ulong word = bitmap[end / BITS_PER_LONG];
+                    if (!bit_value){
+                        word = ~word;
+                    }
+                    word >>= (end % BITS_PER_LONG);
+                    ulong remain = BITS_PER_LONG - (end % BITS_PER_LONG);
+                    if (word == (remain == BITS_PER_LONG ? ~0UL : (1UL << remain) - 1)){
+                        end += remain;
+                        continue;
                     }
+                    end += __builtin_ctzl(~word);
+                    break;
+                }
+                end = std::min(end, nr_bits);
+                if (bit_value == alloc){
+                    ulong start_pfn = cma->base_pfn + (bit << cma->order_per_bit);
+                    ulong end_pfn = cma->base_pfn + (end << cma->order_per_bit);
+                    physaddr_t paddr = (physaddr_t)start_pfn * page_size;
+                    ulong page = 0;
+                    phys_to_page(paddr, &page);
+                    std::ostringstream oss_p;
+                    oss_p << "[" << std::setw(5) << std::setfill('0') << std::dec << index << "]"
+                        << "Pfn:"   << std::setfill(' ') << std::hex << start_pfn << "~" << end_pfn << " "
+                        << "Page:"  << std::hex << (ulonglong)page << " "
+                        << "paddr:" << std::hex << (ulonglong)paddr << " "
+                        << "size:"  << csize((end_pfn - start_pfn) * page_size) << " "
+                        << (bit_value ? "allocted":"free");
+                    fprintf(fp, "%s \n",oss_p.str().c_str());
+                    index += 1;
                 }
-                bitmap_addr += 1;
+                bit = end;
             }
         }
     }
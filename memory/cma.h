@@ -17,6 +17,7 @@
 #define CMA_DEFS_H_
 
 #include "plugin.h"
+#include "page_account.h"
 
 struct cma_mem {
     ulong addr;
@@ -35,9 +36,11 @@ public:
 
     void cmd_main(void) override;
     void parser_cma_areas();
-    int get_cma_used_size(std::shared_ptr<cma_mem> cma);
+    bool read_cma_bitmap(std::shared_ptr<cma_mem> cma, std::vector<ulong>& bitmap);
+    ulong get_cma_used_size(std::shared_ptr<cma_mem> cma);
     void print_cma_areas();
     void print_cma_page_status(std::string name,bool alloc);
+    void print_cma_page_owner();
     ulong cma_bitmap_maxno(std::shared_ptr<cma_mem> cma);
     DEFINE_PLUGIN_INSTANCE(Cma)
 };
@@ -15,6 +15,7 @@
 
 #include "dmabuf.h"
 #include "cmd_buf.h"
+#include <chrono>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -69,6 +70,7 @@ Dmabuf::Dmabuf(){
     // print_table();
     get_dmabuf_from_proc();
     parser_dma_bufs();
+    calc_proc_size();
 }
 
 void Dmabuf::parser_dma_bufs(){
@@ -91,6 +93,7 @@ void Dmabuf::parser_dma_bufs(){
         buf_ptr->attachments = parser_attachments(attachments_head);
         get_proc_info(buf_ptr);
         buf_list.push_back(buf_ptr);
+        buf_map[buf_addr] = buf_ptr;
     }
 }
 
@@ -173,40 +176,96 @@ ulong Dmabuf::sg_next(ulong sgl_addr, ulong page_link){
     }
 }
 
+void Dmabuf::add_sg_range(std::shared_ptr<dma_buf> buf_ptr, physaddr_t paddr, size_t len){
+    if (len == 0){
+        return;
+    }
+    if (!buf_ptr->ranges.empty()){
+        sg_range& last = buf_ptr->ranges.back();
+        if (last.paddr + last.len == paddr){
+            last.len += len;
+            return;
+        }
+    }
+    buf_ptr->ranges.push_back({paddr, len});
+}
+
+/*
+ * The entries between two chain links are an array, so they are read up to
+ * SG_READ_BATCH at a time. A chain entry is only a link to the next array
+ * and is not counted in nents.
+ */
 void Dmabuf::parser_sg_table(std::shared_ptr<dma_buf> buf_ptr){
     if (!is_kvaddr(buf_ptr->sg_table)){
         return;
     }
     ulong sgl_addr = read_pointer(buf_ptr->sg_table + field_offset(sg_table,sgl),"sgl");
-    int cnt = read_uint(buf_ptr->sg_table + field_offset(sg_table,nents),"nents");
-    // fprintf(fp, "sg_table:%lx \n",buf_ptr->sg_table);
+    uint cnt = read_uint(buf_ptr->sg_table + field_offset(sg_table,nents),"nents");
+    size_t sg_size = struct_size(scatterlist);
+    std::vector<char> sg_buf(SG_READ_BATCH * sg_size);
     while (is_kvaddr(sgl_addr) && cnt){
-        cnt -= 1;
-        std::shared_ptr<scatterlist> sgl_ptr = std::make_shared<scatterlist>();
-        void *sgl_buf = read_struct(sgl_addr,"scatterlist");
-        if(sgl_buf == nullptr) continue;
-        sgl_ptr->addr = sgl_addr;
-        sgl_ptr->offset = UINT(sgl_buf + field_offset(scatterlist,offset));
-        sgl_ptr->length = UINT(sgl_buf + field_offset(scatterlist,length));
-        sgl_ptr->dma_address = ULONG(sgl_buf + field_offset(scatterlist,dma_address));
-        sgl_ptr->dma_length = UINT(sgl_buf + field_offset(scatterlist,dma_length));
-        sgl_ptr->page_link = ULONG(sgl_buf + field_offset(scatterlist,page_link));
-        FREEBUF(sgl_buf);
-        // fprintf(fp, "   sgl_addr:%lx dma_address:%lx dma_length:%d\n",sgl_addr,sgl_ptr->dma_address,sgl_ptr->length);
-        if (sgl_ptr->page_link == 0){
-            break;
+        // one extra entry, the array may end with a chain link
+        size_t batch = std::min((size_t)cnt + 1, (size_t)SG_READ_BATCH);
+        // the extra entry may be past the end of the array, so retry the
+        // single entry before reporting it
+        if (!readmem(sgl_addr, KVADDR, sg_buf.data(), batch * sg_size, TO_CONST_STRING("scatterlist"), RETURN_ON_ERROR|QUIET)){
+            batch = 1;
+            if (!read_struct(sgl_addr, sg_buf.data(), sg_size, "scatterlist")){
+                break;
+            }
+        }
+        size_t i = 0;
+        ulong next = 0;
+        for (; i < batch && cnt; i++){
+            char* sgl_buf = sg_buf.data() + i * sg_size;
+            ulong addr = sgl_addr + i * sg_size;
+            ulong page_link = ULONG(sgl_buf + field_offset(scatterlist,page_link));
+            if (page_link == 0){
+                cnt = 0;
+                break;
+            }
+            if (sg_is_chain(page_link)){
+                next = sg_chain_ptr(page_link);
+                break;
+            }
+            std::shared_ptr<scatterlist> sgl_ptr = std::make_shared<scatterlist>();
+            sgl_ptr->addr = addr;
+            sgl_ptr->page_link = page_link;
+            sgl_ptr->offset = UINT(sgl_buf + field_offset(scatterlist,offset));
+            sgl_ptr->length = UINT(sgl_buf + field_offset(scatterlist,length));
+            sgl_ptr->dma_address = ULONG(sgl_buf + field_offset(scatterlist,dma_address));
+            sgl_ptr->dma_length = UINT(sgl_buf + field_offset(scatterlist,dma_length));
+            buf_ptr->sgl_list.push_back(sgl_ptr);
+            physaddr_t paddr = page_to_phy(sg_chain_ptr(page_link));
+            if (paddr){
+                add_sg_range(buf_ptr, paddr + sgl_ptr->offset, sgl_ptr->length);
+            }
+            cnt -= 1;
+            if (sg_is_last(page_link)){
+                cnt = 0;
+                break;
+            }
         }
-        sgl_addr = sg_next(sgl_addr,sgl_ptr->page_link);
-        buf_ptr->sgl_list.push_back(sgl_ptr);
+        sgl_addr = next ? next : sgl_addr + i * sg_size;
     }
 }
 
+/*
+ * One pass over the fd table of every process, f_op and private_data are
+ * taken from a single read of the struct file, and every dma_buf gets the
+ * list of processes holding it.
+ */
 void Dmabuf::get_dmabuf_from_proc(){
     if (!csymbol_exists("dma_buf_fops")){
         fprintf(fp, "dma_buf_fops doesn't exist in this kernel!\n");
         return;
     }
     ulong dma_buf_fops = csymbol_value("dma_buf_fops");
+    int offset_f_op = field_offset(file,f_op);
+    int offset_priv = field_offset(file,private_data);
+    int start = std::min(offset_f_op, offset_priv);
+    int len = std::max(offset_f_op, offset_priv) + sizeof(ulong) - start;
+    std::vector<char> file_buf(len);
     for(ulong task_addr: for_each_process()){
         struct task_context *tc = task_to_context(task_addr);
         if (!tc){
@@ -218,11 +277,14 @@ void Dmabuf::get_dmabuf_from_proc(){
             if (!is_kvaddr(files[i])){
                 continue;
             }
-            ulong f_op = read_pointer(files[i] + field_offset(file,f_op),"f_op");
+            if (!read_struct(files[i] + start, file_buf.data(), len, "file")){
+                continue;
+            }
+            ulong f_op = ULONG(file_buf.data() + offset_f_op - start);
             if (f_op != dma_buf_fops){
                 continue;
             }
-            ulong priv = read_pointer(files[i] + field_offset(file,private_data),"private_data");
+            ulong priv = ULONG(file_buf.data() + offset_priv - start);
             if (!is_kvaddr(priv)){
                 continue;
             }
@@ -232,22 +294,40 @@ void Dmabuf::get_dmabuf_from_proc(){
             std::shared_ptr<proc_info> proc_ptr = std::make_shared<proc_info>();
             proc_ptr->tc = tc;
             proc_ptr->fd_map = map;
+            proc_ptr->rss = 0;
+            proc_ptr->pss = 0;
             proc_list.push_back(proc_ptr);
+            for (const auto& pair : proc_ptr->fd_map){
+                buf_procs[pair.first].push_back(proc_ptr);
+            }
         }
     }
 }
 
 void Dmabuf::get_proc_info(std::shared_ptr<dma_buf> buf_ptr){
-    for (const auto& proc_ptr : proc_list){
-        for (const auto& pair : proc_ptr->fd_map){
-            if (buf_ptr->addr == pair.first){
-                buf_ptr->procs.push_back(proc_ptr);
-            }
-        }
+    auto it = buf_procs.find(buf_ptr->addr);
+    if (it != buf_procs.end()){
+        buf_ptr->procs = it->second;
     }
 }
 
-
+/*
+ * rss counts every dma_buf a process holds, pss splits a shared dma_buf
+ * evenly between its holders, so the pss of all processes sums up to the
+ * size of the dma_buf held by any process.
+ */
+void Dmabuf::calc_proc_size(){
+    for (const auto& buf_ptr : buf_list) {
+        if (buf_ptr->procs.empty()){
+            continue;
+        }
+        size_t share = buf_ptr->size / buf_ptr->procs.size();
+        for (const auto& proc_ptr : buf_ptr->procs) {
+            proc_ptr->rss += buf_ptr->size;
+            proc_ptr->pss += share;
+        }
+    }
+}
 
 std::vector<std::shared_ptr<attachment>> Dmabuf::parser_attachments(ulong list_head){
     std::vector<std::shared_ptr<attachment>> res;
@@ -371,11 +451,9 @@ void Dmabuf::print_dma_buf(std::string addr){
     if (number <= 0){
         return;
     }
-    for (const auto& dma_buf : buf_list) {
-        if (dma_buf->addr == number) {
-            print_dma_buf(dma_buf);
-            return;
-        }
+    auto it = buf_map.find(number);
+    if (it != buf_map.end()) {
+        print_dma_buf(it->second);
     }
 }
 
@@ -393,14 +471,36 @@ void Dmabuf::save_dma_buf(std::string addr){
                 fprintf(fp, "Can't open %s\n", ss.str().c_str());
                 return;
             }
-            for (const auto& sgl_ptr : buf_ptr->sgl_list) {
-                ulong page = sgl_ptr->page_link  & ~ 0x3;
-                physaddr_t paddr = page_to_phy(page) + sgl_ptr->offset;
-                size_t len = sgl_ptr->length;
-                void* buf = read_memory(paddr, len, "dmabuf",false);
-                fwrite(buf, len, 1, dma_file);
-                FREEBUF(buf);
+            // stream the contiguous ranges through one reused buffer
+            std::vector<char> data(DMABUF_SAVE_CHUNK);
+            size_t total = 0;
+            size_t failed = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (const auto& range : buf_ptr->ranges) {
+                for (size_t off = 0; off < range.len; off += DMABUF_SAVE_CHUNK) {
+                    size_t len = std::min(range.len - off, (size_t)DMABUF_SAVE_CHUNK);
+                    physaddr_t paddr = range.paddr + off;
+                    if (!readmem(paddr, PHYSADDR, data.data(), len, TO_CONST_STRING("dmabuf"), RETURN_ON_ERROR|QUIET)){
+                        // retry page by page, only the pages which fail alone are zero
+                        for (size_t pos = 0; pos < len;) {
+                            size_t page_len = std::min(len - pos, page_size - ((paddr + pos) & (page_size - 1)));
+                            if (!readmem(paddr + pos, PHYSADDR, data.data() + pos, page_len, TO_CONST_STRING("dmabuf"), RETURN_ON_ERROR|QUIET)){
+                                memset(data.data() + pos, 0, page_len);
+                                failed += page_len;
+                            }
+                            pos += page_len;
+                        }
+                    }
+                    fwrite(data.data(), len, 1, dma_file);
+                    total += len;
+                }
             }
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            fprintf(fp, "Write %s in %zu ranges, %.3fs", csize(total).c_str(), buf_ptr->ranges.size(), elapsed.count());
+            if (failed){
+                fprintf(fp, ", %s unreadable filled with zero", csize(failed).c_str());
+            }
+            fprintf(fp, "\n");
             fprintf(fp, "Save dmabuf to file %s !\n", ss.str().c_str());
             fclose(dma_file);
             return;
@@ -413,24 +513,25 @@ void Dmabuf::print_procs(){
     oss_hd << std::left << std::setw(5) << "PID" << " "
         << std::left << std::setw(20) << "Comm" << " "
         << std::left << std::setw(8) << "buf_cnt" << " "
-        << std::left << "total_size";
+        << std::left << std::setw(10) << "rss" << " "
+        << std::left << "pss";
     fprintf(fp, "%s \n",oss_hd.str().c_str());
-    for (const auto& proc_ptr : proc_list) {
-        size_t total_size = 0;
-        for (const auto& pair : proc_ptr->fd_map) {
-            for (const auto& buf_ptr : buf_list) {
-                if (pair.first == buf_ptr->addr){
-                    total_size += buf_ptr->size;
-                }
-            }
-        }
+    std::vector<std::shared_ptr<proc_info>> procs = proc_list;
+    std::sort(procs.begin(), procs.end(),[&](const std::shared_ptr<proc_info>& a, const std::shared_ptr<proc_info>& b){
+        return a->pss > b->pss;
+    });
+    size_t total_pss = 0;
+    for (const auto& proc_ptr : procs) {
+        total_pss += proc_ptr->pss;
         std::ostringstream oss;
         oss << std::left << std::setw(5) << proc_ptr->tc->pid << " "
             << std::left << std::setw(20) << proc_ptr->tc->comm << " "
             << std::left << std::setw(8) << proc_ptr->fd_map.size() << " "
-            << std::left << csize(total_size);
+            << std::left << std::setw(10) << csize(proc_ptr->rss) << " "
+            << std::left << csize(proc_ptr->pss);
         fprintf(fp, "%s \n",oss.str().c_str());
     }
+    fprintf(fp, "Total pss:%s\n",csize(total_pss).c_str());
 }
 
 void Dmabuf::print_proc(ulong pid){
@@ -439,12 +540,42 @@ void Dmabuf::print_proc(ulong pid){
             continue;
         }
         for (const auto& pair : proc_ptr->fd_map) {
-            for (const auto& buf_ptr : buf_list) {
-                if (pair.first == buf_ptr->addr){
-                    print_dma_buf(buf_ptr);
-                }
+            auto it = buf_map.find(pair.first);
+            if (it != buf_map.end()){
+                print_dma_buf(it->second);
             }
         }
     }
 }
+/*
+ * The owner of the pages in every sg_table from the PageAccount tags, a
+ * dma_buf which still points to pages in the buddy is listed.
+ */
+void Dmabuf::print_page_owner(){
+    std::shared_ptr<PageAccount> account = PageAccount::get_instance();
+    size_t total[PAGE_TAG_MAX] = {};
+    std::ostringstream oss;
+    for (const auto& buf_ptr : buf_list) {
+        size_t counts[PAGE_TAG_MAX] = {};
+        for (const auto& range : buf_ptr->ranges) {
+            ulong start_pfn = range.paddr >> PAGESHIFT();
+            ulong end_pfn = (range.paddr + range.len + page_size - 1) >> PAGESHIFT();
+            account->count_range(start_pfn, end_pfn, counts);
+        }
+        for (int i = 0; i < PAGE_TAG_MAX; i++){
+            total[i] += counts[i];
+        }
+        if (counts[PAGE_TAG_BUDDY] == 0){
+            continue;
+        }
+        oss << "dma_buf:" << std::hex << buf_ptr->addr << " "
+            << "[" << buf_ptr->exp_name << "] "
+            << "size:" << csize(buf_ptr->size) << " "
+            << "freed:" << csize(counts[PAGE_TAG_BUDDY] * page_size) << "\n";
+    }
+    fprintf(fp, "Owner: %s\n",account->format_counts(total).c_str());
+    fprintf(fp, "=======================================================================================\n");
+    fprintf(fp, "%s",oss.str().c_str());
+}
+
 #pragma GCC diagnostic pop
@@ -17,6 +17,10 @@
 #define DMABUF_DEFS_H_
 
 #include "plugin.h"
+#include "memory/page_account.h"
+
+#define SG_READ_BATCH   128                 /* scatterlist entries per read */
+#define DMABUF_SAVE_CHUNK (4 * 1024 * 1024) /* bytes per physical read in save_dma_buf */
 
 enum dma_data_direction {
   DMA_BIDIRECTIONAL = 0,
@@ -38,7 +42,9 @@ struct attachment {
 
 struct proc_info {
     struct task_context *tc;
-    std::unordered_map<ulong, int> fd_map;
+    std::unordered_map<ulong, int> fd_map;  /* dma_buf -> fd */
+    size_t rss;                             /* size of all the dma_buf it holds */
+    size_t pss;                             /* shared dma_buf split between the holders */
 };
 
 struct scatterlist {
@@ -50,11 +56,17 @@ struct scatterlist {
     unsigned int dma_length;
 };
 
+struct sg_range {
+    physaddr_t paddr;
+    size_t len;
+};
+
 struct dma_buf {
     ulong addr;
     ulong heap;
     ulong sg_table;
     std::vector<std::shared_ptr<scatterlist>> sgl_list;
+    std::vector<sg_range> ranges;       /* physically contiguous runs of sgl_list */
     size_t size;
     std::string file;
     ulong f_count;
@@ -73,6 +85,8 @@ private:
 public:
     std::vector<std::shared_ptr<proc_info>> proc_list;
     std::vector<std::shared_ptr<dma_buf>> buf_list;
+    std::unordered_map<ulong, std::shared_ptr<dma_buf>> buf_map;                  /* dma_buf addr -> dma_buf */
+    std::unordered_map<ulong, std::vector<std::shared_ptr<proc_info>>> buf_procs;  /* dma_buf addr -> holders */
     Dmabuf();
     void cmd_main(void) override;
     void parser_dma_bufs();
@@ -83,8 +97,10 @@ public:
     ulong sg_chain_ptr(ulong page_link);
     ulong sg_next(ulong sgl_addr, ulong page_link);
     void parser_sg_table(std::shared_ptr<dma_buf> buf_ptr);
+    void add_sg_range(std::shared_ptr<dma_buf> buf_ptr, physaddr_t paddr, size_t len);
     void get_dmabuf_from_proc();
     void get_proc_info(std::shared_ptr<dma_buf> buf_ptr);
+    void calc_proc_size();
     std::vector<std::shared_ptr<attachment>> parser_attachments(ulong list_head);
     void print_dma_buf_list();
     void print_attachment(std::shared_ptr<dma_buf> buf_ptr);
@@ -95,6 +111,7 @@ public:
     void save_dma_buf(std::string addr);
     void print_procs();
     void print_proc(ulong pid);
+    void print_page_owner();
 };
 
 #endif // DMABUF_DEFS_H_
@@ -78,17 +78,6 @@ Meminfo::Meminfo(){
     field_init(cma, count);
     field_init(reserved_mem,size);
     field_init(reserved_mem,name);
-    field_init(dma_buf,list_node);
-    field_init(dma_buf,size);
-    field_init(vmap_area,list);
-    field_init(vmap_area,vm);
-    field_init(vm_struct,nr_pages);
-    field_init(vm_struct,next);
-    field_init(vm_struct,size);
-    field_init(vmap_node,pool);
-    field_init(vmap_pool,len);
-    struct_init(vmap_node);
-    struct_init(vmap_pool);
     if (get_config_val("CONFIG_HUGETLB_PAGE") == "y") {
         struct_init(hstate);
         field_init(hstate, order);
@@ -140,6 +129,18 @@ Meminfo::Meminfo(){
         "       Inode  Cache    :        64KB",
         "",
         "       NON_HLOS        :    308.34MB",
+        "",
+        "    PFN Account        :      7.93GB",
+        "       Buddy           :      7.01GB",
+        "       Slab            :    126.52MB",
+        "       ... ...",
+        "       Unaccounted     :     41.20MB",
+        "",
+        "       Dmabuf no sgt   :          0B",
+        "       Coverage        :     99.49%",
+        "       Holes           :          0B",
+        "       PFN range       :  [0x40000-0x23f800)",
+        "       Scan time       :      1.843s",
         "\n",
         "  Breakdown vmstat info:",
         "    %s> meminfo -v",
@@ -434,73 +435,6 @@ size_t Meminfo::get_nomap_size(){
     return total_size;
 }
 
-size_t Meminfo::get_dmabuf_size(){
-    ulong db_list_addr = 0;
-    if (csymbol_exists("db_list")){
-        db_list_addr = csymbol_value("db_list");
-    }else if (csymbol_exists("debugfs_list")){
-        db_list_addr = csymbol_value("debugfs_list");
-    }
-    if (!is_kvaddr(db_list_addr)){
-        return 0;
-    }
-    size_t total_size = 0;
-    int offset = field_offset(dma_buf,list_node);
-    for (const auto& buf_addr : for_each_list(db_list_addr,offset)) {
-        total_size += read_ulong(buf_addr + field_offset(dma_buf,size), "size");
-    }
-    return total_size;
-}
-
-size_t Meminfo::get_vmalloc_size(){
-    size_t total_pages = 0;
-    int offset = field_offset(vmap_area,list);
-    if (csymbol_exists("vmap_area_list")){
-        ulong area_list_addr = csymbol_value("vmap_area_list");
-        if (!is_kvaddr(area_list_addr)) {
-            return total_pages;
-        }
-        for (const auto& area_addr : for_each_list(area_list_addr,offset)) {
-            total_pages += parser_vmap_area(area_addr);
-        }
-    }else if(csymbol_exists("vmap_nodes")){
-        ulong nodes_addr = read_pointer(csymbol_value("vmap_nodes"),"vmap_nodes pages");
-        if (!is_kvaddr(nodes_addr)) return total_pages;
-        int nr_node = read_int(csymbol_value("nr_vmap_nodes"),"nr_vmap_nodes");
-        int pool_cnt = field_size(vmap_node,pool)/struct_size(vmap_pool);
-        for (int i = 0; i < nr_node; i++){
-            ulong pools_addr = nodes_addr + i * struct_size(vmap_node) + field_offset(vmap_node,pool);
-            for (int p = 0; p < pool_cnt; p++){
-                ulong pool_addr = pools_addr + p * struct_size(vmap_pool);
-                if (!is_kvaddr(pool_addr)) continue;
-                ulong len = read_ulong(pool_addr + field_offset(vmap_pool,len),"vmap_pool len");
-                if (len == 0){
-                    continue;
-                }
-                for (const auto& area_addr : for_each_list(pool_addr,offset)) {
-                    total_pages += parser_vmap_area(area_addr);
-                }
-            }
-        }
-    }
-    return total_pages * page_size;
-}
-
-size_t Meminfo::parser_vmap_area(ulong addr){
-    size_t total_pages = 0;
-    ulong vm_addr = read_pointer(addr + field_offset(vmap_area,vm),"vm addr");
-    while (is_kvaddr(vm_addr)){
-        int nr_pages = read_uint(vm_addr + field_offset(vm_struct,nr_pages),"nr_pages");
-        ulong vm_size = read_ulong(vm_addr + field_offset(vm_struct,size),"size");
-        if (vm_size % page_size != 0 || (vm_size / page_size) != (ulong)(nr_pages + 1)) {
-            break;
-        }
-        total_pages += nr_pages;
-        vm_addr = read_pointer(vm_addr + field_offset(vm_struct,next),"next");
-    }
-    return total_pages;
-}
-
 size_t Meminfo::get_dentry_cache_size(){
     if (!csymbol_exists("d_hash_shift")) {
         return 0;
@@ -647,8 +581,12 @@ void Meminfo::print_mem_breakdown(void){
     ulong struct_page = get_struct_page_size();
     ulong dentry_cache = get_dentry_cache_size();
     ulong inode_cache = get_inode_cache_size();
-    ulong vmalloc = get_vmalloc_size();
-    ulong dmabuf = get_dmabuf_size();
+    // Vmalloc and Dmabuf keep their meaning, nr_pages of every vm_struct
+    // and size of every dma_buf, but come from the one PageAccount pass
+    std::shared_ptr<PageAccount> account = PageAccount::get_instance();
+    account->scan();
+    ulong vmalloc = account->get_vmalloc_pages() * page_size;
+    ulong dmabuf = account->get_dmabuf_size();
     ulong other_size = totalram_pg * page_size - (freeram_pg + blockdev_pg + cached_pg) * page_size
         - (slab_pg * page_size + vmalloc + sharedram_pg * page_size + pagetables_pg * page_size + kernelstack_bytes)
         - aon_pg * page_size;
@@ -676,6 +614,36 @@ void Meminfo::print_mem_breakdown(void){
         << std::left << "   Inode  Cache    :" << std::setw(12) << std::right << csize((uint64_t)inode_cache)                 << "\n\n"
         << std::left << "   NON_HLOS        :" << std::setw(12) << std::right << csize((uint64_t)no_hlos)                     << "\n";
     fprintf(fp, "%s \n",oss.str().c_str());
+    print_page_account(account);
+}
+
+/*
+ * Owner of every page from the PageAccount pass, the Dmabuf line only has
+ * the pages found through the sg_table, the size of the dma_buf without one
+ * is shown apart.
+ */
+void Meminfo::print_page_account(std::shared_ptr<PageAccount> account){
+    size_t total_pg = account->get_max_pfn() - account->get_min_pfn();
+    size_t valid_pg = total_pg - account->get_count(PAGE_TAG_HOLE);
+    size_t unknown_pg = account->get_count(PAGE_TAG_UNKNOWN);
+    if (valid_pg == 0){
+        return;
+    }
+    std::ostringstream oss;
+    oss << std::left << "PFN Account        :" << std::setw(12) << std::right << csize((uint64_t)valid_pg * page_size) << "\n";
+    for (uint8_t tag = PAGE_TAG_BUDDY; tag < PAGE_TAG_HOLE; tag++){
+        oss << std::left << "   " << std::setw(16) << PageAccount::tag_name(tag) << ":"
+            << std::setw(12) << std::right << csize((uint64_t)account->get_count(tag) * page_size) << "\n";
+    }
+    oss << std::left << "   " << std::setw(16) << PageAccount::tag_name(PAGE_TAG_UNKNOWN) << ":"
+        << std::setw(12) << std::right << csize((uint64_t)unknown_pg * page_size) << "\n\n";
+    oss << std::left << "   Dmabuf no sgt   :" << std::setw(12) << std::right << csize((uint64_t)account->get_dmabuf_untracked()) << "\n";
+    oss << std::left << "   Coverage        :" << std::setw(11) << std::right << std::fixed << std::setprecision(2)
+        << (double)(valid_pg - unknown_pg) * 100 / valid_pg << "%\n"
+        << std::left << "   Holes           :" << std::setw(12) << std::right << csize((uint64_t)account->get_count(PAGE_TAG_HOLE) * page_size) << "\n"
+        << std::left << "   PFN range       :" << "  [0x" << std::hex << account->get_min_pfn() << "-0x" << account->get_max_pfn() << ")" << std::dec << "\n"
+        << std::left << "   Scan time       :" << std::setw(11) << std::right << std::setprecision(3) << account->get_scan_time() << "s\n";
+    fprintf(fp, "%s \n",oss.str().c_str());
 }
 
 void Meminfo::print_meminfo(void){
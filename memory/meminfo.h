@@ -20,6 +20,7 @@
 #include <cmath>
 #include "plugin.h"
 #include "devicetree/devicetree.h"
+#include "page_account.h"
 
 class Meminfo : public ParserPlugin {
 private:
@@ -42,9 +43,6 @@ private:
     size_t get_struct_page_size();
     size_t get_memory_size();
     size_t get_nomap_size();
-    size_t get_dmabuf_size();
-    size_t get_vmalloc_size();
-    size_t parser_vmap_area(ulong addr);
     size_t get_dentry_cache_size();
     size_t get_inode_cache_size();
     ulong get_vmalloc_total(void);
@@ -54,6 +52,7 @@ public:
     void cmd_main(void) override;
     void print_vmstat(void);
     void print_mem_breakdown(void);
+    void print_page_account(std::shared_ptr<PageAccount> account);
     void print_meminfo(void);
     DEFINE_PLUGIN_INSTANCE(Meminfo)
 };
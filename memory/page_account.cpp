@@ -0,0 +1,415 @@
+/**
+ * Copyright (c) 2024-2025 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "page_account.h"
+#include <chrono>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpointer-arith"
+
+void PageAccount::cmd_main(void) {}
+
+PageAccount::PageAccount(){
+    field_init(page, flags);
+    field_init(page, mapping);
+    field_init(page, page_type);
+    field_init(page, _mapcount);
+    field_init(page, private);
+    field_init(page, compound_head);
+    struct_init(page);
+    field_init(vmap_area,vm);
+    field_init(vm_struct,nr_pages);
+    field_init(vm_struct,pages);
+    field_init(vm_struct,next);
+    field_init(vm_struct,size);
+    field_init(dma_buf,list_node);
+    field_init(dma_buf,size);
+    field_init(dma_buf,priv);
+    field_init(ion_buffer,sg_table);
+    field_init(qcom_sg_buffer,sg_table);
+    field_init(system_heap_buffer,sg_table);
+    struct_init(ion_buffer);
+    struct_init(qcom_sg_buffer);
+    struct_init(system_heap_buffer);
+    field_init(sg_table,sgl);
+    field_init(sg_table,nents);
+    field_init(scatterlist,page_link);
+    field_init(scatterlist,offset);
+    field_init(scatterlist,length);
+    struct_init(scatterlist);
+}
+
+std::shared_ptr<PageAccount> PageAccount::get_instance(){
+    static std::shared_ptr<PageAccount> instance = std::make_shared<PageAccount>();
+    return instance;
+}
+
+const char* PageAccount::tag_name(uint8_t tag){
+    static const char* names[PAGE_TAG_MAX] = {
+        "Unaccounted", "Buddy", "Slab", "Anon", "File", "Vmalloc",
+        "Dmabuf", "Zsmalloc", "PageTables", "Reserved", "Hole",
+    };
+    return tag < PAGE_TAG_MAX ? names[tag] : "";
+}
+
+void PageAccount::set_tag(ulong pfn, uint8_t tag){
+    if (pfn < min_pfn || pfn >= max_pfn){
+        return;
+    }
+    size_t idx = pfn - min_pfn;
+    uint8_t& val = tags[idx >> 1];
+    if (idx & 1){
+        val = (val & 0x0f) | (tag << 4);
+    } else {
+        val = (val & 0xf0) | (tag & 0x0f);
+    }
+}
+
+uint8_t PageAccount::tag_of(ulong pfn){
+    if (pfn < min_pfn || pfn >= max_pfn){
+        return PAGE_TAG_HOLE;
+    }
+    size_t idx = pfn - min_pfn;
+    return (idx & 1) ? (tags[idx >> 1] >> 4) : (tags[idx >> 1] & 0x0f);
+}
+
+uint8_t PageAccount::get_tag(ulong pfn){
+    scan();
+    return ready ? tag_of(pfn) : PAGE_TAG_HOLE;
+}
+
+size_t PageAccount::get_count(uint8_t tag){
+    scan();
+    return tag < PAGE_TAG_MAX ? tag_count[tag] : 0;
+}
+
+/*
+ * Add the pages of [start_pfn, end_pfn) to counts by tag.
+ */
+void PageAccount::count_range(ulong start_pfn, ulong end_pfn, size_t counts[PAGE_TAG_MAX]){
+    scan();
+    for (ulong pfn = start_pfn; pfn < end_pfn; pfn++){
+        counts[ready ? tag_of(pfn) : PAGE_TAG_HOLE]++;
+    }
+}
+
+/*
+ * "Buddy:1.50MB Anon:12.00MB ...", only the tags which have pages.
+ */
+std::string PageAccount::format_counts(const size_t counts[PAGE_TAG_MAX]){
+    std::ostringstream oss;
+    for (uint8_t tag = 0; tag < PAGE_TAG_MAX; tag++){
+        if (counts[tag] == 0){
+            continue;
+        }
+        if (oss.tellp() > 0){
+            oss << " ";
+        }
+        oss << tag_name(tag) << ":" << csize((uint64_t)counts[tag] * page_size);
+    }
+    return oss.str();
+}
+
+/*
+ * Since 6.12 the top byte of page_type is enum pagetype (PGTY_*), before
+ * that page_type holds inverted PG_* bits under PAGE_TYPE_BASE, and kernels
+ * older than 4.18 encode buddy in _mapcount.
+ */
+void PageAccount::init_page_type(){
+    has_page_type = (field_offset(page, page_type) != -1);
+    offset_type = has_page_type ? field_offset(page, page_type) : field_offset(page, _mapcount);
+    offset_flags = field_offset(page, flags);
+    offset_mapping = field_offset(page, mapping);
+    offset_private = field_offset(page, private);
+    offset_compound_head = field_offset(page, compound_head);
+    long val = 0;
+    if (enumerator_value(TO_CONST_STRING("PG_reserved"), &val)){
+        pg_reserved = val;
+    }
+    if (!(vt->flags & SLAB_PAGEFLAGS) && enumerator_value(TO_CONST_STRING("PG_slab"), &val)){
+        pg_slab = val;
+    }
+    if (enumerator_value(TO_CONST_STRING("PGTY_buddy"), &val)){
+        pgty = true;
+        pgty_buddy = val;
+        if (enumerator_value(TO_CONST_STRING("PGTY_table"), &val)) pgty_table = val;
+        if (enumerator_value(TO_CONST_STRING("PGTY_slab"), &val)) pgty_slab = val;
+        if (enumerator_value(TO_CONST_STRING("PGTY_zsmalloc"), &val)) pgty_zsmalloc = val;
+    } else if (has_page_type){
+        pgty_buddy = 0x80;
+        pgty_table = (THIS_KERNEL_VERSION < LINUX(5, 9, 0)) ? 0x400 : 0x200;
+        if (vt->flags & SLAB_PAGEFLAGS){
+            pgty_slab = 0x1000;
+        }
+    }
+}
+
+/*
+ * Tag of one struct page, run is set to the number of pfns it covers
+ * (the whole block for a free buddy head).
+ */
+uint8_t PageAccount::classify(const char* page, ulong& run){
+    run = 1;
+    ulong flags = ULONG(page + offset_flags);
+    ulong mapping = ULONG(page + offset_mapping);
+    uint type = UINT(page + offset_type);
+    if (pg_reserved >= 0 && (flags & (1UL << pg_reserved))){
+        return PAGE_TAG_RESERVED;
+    }
+    if (pgty){
+        uint ty = type >> 24;
+        if ((long)ty == pgty_buddy){
+            ulong order = ULONG(page + offset_private);
+            run = order < 16 ? (1UL << order) : 1;
+            return PAGE_TAG_BUDDY;
+        }
+        if ((long)ty == pgty_slab) return PAGE_TAG_SLAB;
+        if ((long)ty == pgty_table) return PAGE_TAG_PGTABLE;
+        if ((long)ty == pgty_zsmalloc) return PAGE_TAG_ZSMALLOC;
+    } else if (has_page_type){
+        auto page_type_is = [&](long flag) -> bool {
+            return flag > 0 && (type & (0xf0000000 | flag)) == 0xf0000000;
+        };
+        if (page_type_is(pgty_buddy)){
+            ulong order = ULONG(page + offset_private);
+            run = order < 16 ? (1UL << order) : 1;
+            return PAGE_TAG_BUDDY;
+        }
+        if (page_type_is(pgty_slab)) return PAGE_TAG_SLAB;
+        if (page_type_is(pgty_table)) return PAGE_TAG_PGTABLE;
+    } else if (type == 0xffffff80){
+        ulong order = ULONG(page + offset_private);
+        run = order < 16 ? (1UL << order) : 1;
+        return PAGE_TAG_BUDDY;
+    }
+    if (pg_slab >= 0 && (flags & (1UL << pg_slab))){
+        return PAGE_TAG_SLAB;
+    }
+    if (offset_compound_head != -1){
+        ulong head = ULONG(page + offset_compound_head);
+        if (head & 1){
+            // the head pfn is lower, so it has been classified already
+            uint8_t tag = tag_of(page_to_pfn(head - 1));
+            if (tag != PAGE_TAG_HOLE){
+                return tag;
+            }
+        }
+    }
+    // non-LRU movable pages, on Android these are the zsmalloc pages
+    if ((mapping & 0x3) == 0x2){
+        return PAGE_TAG_ZSMALLOC;
+    }
+    if (mapping & 0x1){
+        return PAGE_TAG_ANON;
+    }
+    if (is_kvaddr(mapping)){
+        return PAGE_TAG_FILE;
+    }
+    return PAGE_TAG_UNKNOWN;
+}
+
+/*
+ * Classify cnt pfns from one bulk read of their struct pages, return the
+ * next pfn to scan, which is past the batch when a free block crosses it.
+ * The reads are quiet, a page which can't be read is left as a hole.
+ */
+ulong PageAccount::scan_page_batch(ulong pfn, ulong cnt){
+    size_t page_sz = struct_size(page);
+    ulong first = pfn_to_page(pfn);
+    ulong last = pfn_to_page(pfn + cnt - 1);
+    if (page_buf.size() < cnt * page_sz){
+        page_buf.resize(cnt * page_sz);
+    }
+    bool batch = is_kvaddr(first) && last == first + (cnt - 1) * page_sz
+        && readmem(first, KVADDR, page_buf.data(), cnt * page_sz, TO_CONST_STRING("page batch"), RETURN_ON_ERROR|QUIET);
+    ulong i = 0;
+    while (i < cnt){
+        ulong run = 1;
+        uint8_t tag = PAGE_TAG_HOLE;
+        char* page = page_buf.data() + i * page_sz;
+        if (batch){
+            tag = classify(page, run);
+        } else {
+            ulong page_addr = pfn_to_page(pfn + i);
+            if (is_kvaddr(page_addr) && readmem(page_addr, KVADDR, page, page_sz, TO_CONST_STRING("page"), RETURN_ON_ERROR|QUIET)){
+                tag = classify(page, run);
+            }
+        }
+        for (ulong j = 0; j < run; j++){
+            set_tag(pfn + i + j, tag);
+        }
+        i += run;
+    }
+    return pfn + i;
+}
+
+/*
+ * With SPARSEMEM the pfns are scanned section by section, a section
+ * without a valid mem_map is a hole and is not probed at all.
+ */
+void PageAccount::scan_pfns(){
+    ulong pfn = min_pfn;
+    while (pfn < max_pfn){
+        ulong end = max_pfn;
+        if (IS_SPARSEMEM()){
+            end = std::min(max_pfn, (pfn & PAGE_SECTION_MASK()) + PAGES_PER_SECTION());
+            if (!valid_section_nr(pfn_to_section_nr(pfn))){
+                for (; pfn < end; pfn++){
+                    set_tag(pfn, PAGE_TAG_HOLE);
+                }
+                continue;
+            }
+        }
+        while (pfn < end){
+            pfn = scan_page_batch(pfn, std::min((ulong)PAGE_ACCOUNT_BATCH, end - pfn));
+        }
+    }
+}
+
+/*
+ * A page which struct page says is free stays Buddy, so a vm_struct or
+ * sg_table still pointing to a freed page shows up in the owner checks.
+ */
+void PageAccount::mark_pages(ulong page, ulong nr_pages, uint8_t tag){
+    ulong pfn = page_to_pfn(page);
+    for (ulong i = 0; i < nr_pages; i++){
+        uint8_t old = tag_of(pfn + i);
+        if (old == PAGE_TAG_BUDDY || old == PAGE_TAG_HOLE){
+            continue;
+        }
+        set_tag(pfn + i, tag);
+    }
+}
+
+void PageAccount::scan_vm_struct(ulong area_addr){
+    ulong vm_addr = read_pointer(area_addr + field_offset(vmap_area,vm),"vm addr");
+    while (is_kvaddr(vm_addr)){
+        uint nr_pages = read_uint(vm_addr + field_offset(vm_struct,nr_pages),"nr_pages");
+        ulong vm_size = read_ulong(vm_addr + field_offset(vm_struct,size),"size");
+        if (vm_size % page_size != 0 || (vm_size / page_size) != (ulong)(nr_pages + 1)) {
+            break;
+        }
+        vmalloc_pages += nr_pages;
+        ulong pages = read_pointer(vm_addr + field_offset(vm_struct,pages),"pages");
+        if (nr_pages > 0 && is_kvaddr(pages)){
+            ulong* page_list = (ulong*)read_memory(pages, nr_pages * sizeof(ulong), "vm_struct pages");
+            if (page_list){
+                for (uint i = 0; i < nr_pages; i++){
+                    if (is_kvaddr(page_list[i])){
+                        mark_pages(page_list[i], 1, PAGE_TAG_VMALLOC);
+                    }
+                }
+                FREEBUF(page_list);
+            }
+        }
+        vm_addr = read_pointer(vm_addr + field_offset(vm_struct,next),"next");
+    }
+}
+
+void PageAccount::scan_vmalloc(){
+    for (const auto& area_addr : for_each_vmap_area()) {
+        scan_vm_struct(area_addr);
+    }
+}
+
+void PageAccount::scan_dmabuf(){
+    ulong db_list_addr = 0;
+    if (csymbol_exists("db_list")){
+        db_list_addr = csymbol_value("db_list");
+    }else if (csymbol_exists("debugfs_list")){
+        db_list_addr = csymbol_value("debugfs_list");
+    }
+    if (!is_kvaddr(db_list_addr)){
+        return;
+    }
+    for (const auto& buf_addr : for_each_list(db_list_addr,field_offset(dma_buf,list_node))) {
+        ulong size = read_ulong(buf_addr + field_offset(dma_buf,size), "size");
+        dmabuf_size += size;
+        ulong priv = read_pointer(buf_addr + field_offset(dma_buf,priv),"priv");
+        ulong sgt = 0;
+        if (is_kvaddr(priv)){
+            if (struct_size(ion_buffer) != -1){
+                sgt = read_pointer(priv + field_offset(ion_buffer,sg_table),"sg_table");
+            }else if (struct_size(qcom_sg_buffer) != -1){
+                sgt = priv + field_offset(qcom_sg_buffer,sg_table);
+            }else if (struct_size(system_heap_buffer) != -1){
+                sgt = priv + field_offset(system_heap_buffer,sg_table);
+            }
+        }
+        if (!is_kvaddr(sgt)){
+            dmabuf_untracked += size;
+            continue;
+        }
+        ulong sgl = read_pointer(sgt + field_offset(sg_table,sgl),"sgl");
+        uint nents = read_uint(sgt + field_offset(sg_table,nents),"nents");
+        while (is_kvaddr(sgl) && nents--){
+            void *sgl_buf = read_struct(sgl,"scatterlist");
+            if (sgl_buf == nullptr){
+                break;
+            }
+            ulong page_link = ULONG(sgl_buf + field_offset(scatterlist,page_link));
+            uint offset = UINT(sgl_buf + field_offset(scatterlist,offset));
+            uint length = UINT(sgl_buf + field_offset(scatterlist,length));
+            FREEBUF(sgl_buf);
+            if (page_link == 0){
+                break;
+            }
+            if (page_link & 0x1){ // chain
+                sgl = page_link & ~0x3UL;
+                nents++;
+                continue;
+            }
+            ulong page = page_link & ~0x3UL;
+            if (is_kvaddr(page)){
+                mark_pages(page, (offset + length + page_size - 1) / page_size, PAGE_TAG_DMABUF);
+            }
+            if (page_link & 0x2){ // last
+                break;
+            }
+            sgl += struct_size(scatterlist);
+        }
+    }
+}
+
+void PageAccount::scan(){
+    if (scanned){
+        return;
+    }
+    scanned = true;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (csymbol_exists("max_pfn")){
+        try_get_symbol_data(TO_CONST_STRING("max_pfn"), sizeof(ulong), &max_pfn);
+    }
+    if (csymbol_exists("min_low_pfn")){
+        try_get_symbol_data(TO_CONST_STRING("min_low_pfn"), sizeof(ulong), &min_pfn);
+    }
+    if (max_pfn <= min_pfn){
+        fprintf(fp, "invalid pfn range [%#lx-%#lx]\n", min_pfn, max_pfn);
+        return;
+    }
+    tags.assign((max_pfn - min_pfn + 1) / 2, 0);
+    init_page_type();
+    scan_pfns();
+    scan_vmalloc();
+    scan_dmabuf();
+    for (ulong pfn = min_pfn; pfn < max_pfn; pfn++){
+        tag_count[tag_of(pfn)]++;
+    }
+    ready = true;
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    scan_time = elapsed.count();
+}
+
+#pragma GCC diagnostic pop
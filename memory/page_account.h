@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2024-2025 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef PAGE_ACCOUNT_DEFS_H_
+#define PAGE_ACCOUNT_DEFS_H_
+
+#include "plugin.h"
+
+#define PAGE_ACCOUNT_BATCH 512      /* struct page read per batch */
+
+enum page_tag : uint8_t {
+    PAGE_TAG_UNKNOWN = 0,   /* allocated, but not owned by any tracked user */
+    PAGE_TAG_BUDDY,
+    PAGE_TAG_SLAB,
+    PAGE_TAG_ANON,
+    PAGE_TAG_FILE,
+    PAGE_TAG_VMALLOC,
+    PAGE_TAG_DMABUF,
+    PAGE_TAG_ZSMALLOC,
+    PAGE_TAG_PGTABLE,
+    PAGE_TAG_RESERVED,
+    PAGE_TAG_HOLE,          /* no struct page behind the pfn */
+    PAGE_TAG_MAX,
+};
+
+/*
+ * One pass over [min_low_pfn, max_pfn) which gives every pfn a 4-bit tag,
+ * followed by the vmalloc and dmabuf owners which can not be told from
+ * struct page. The pass only runs on the first query, the result is then
+ * kept for the whole session, so any command can ask the owner of a pfn
+ * or the total of a type in O(1).
+ */
+class PageAccount : public ParserPlugin {
+private:
+    bool debug = false;
+    bool ready = false;
+    bool scanned = false;                   /* the pass has run, ready or not */
+    ulong min_pfn = 0;
+    ulong max_pfn = 0;
+    std::vector<uint8_t> tags;              /* two pfns per byte */
+    size_t tag_count[PAGE_TAG_MAX] = {};
+    size_t dmabuf_size = 0;                 /* size of all the dma_buf */
+    size_t dmabuf_untracked = 0;            /* dma_buf size without a known sg_table */
+    size_t vmalloc_pages = 0;               /* nr_pages of all the vm_struct */
+    std::vector<char> page_buf;             /* struct page of one batch */
+    double scan_time = 0;
+    /* page type layout */
+    bool has_page_type = false;
+    bool pgty = false;
+    long pg_reserved = -1;
+    long pg_slab = -1;
+    long pgty_buddy = -1;
+    long pgty_table = -1;
+    long pgty_slab = -1;
+    long pgty_zsmalloc = -1;
+    int offset_flags;
+    int offset_mapping;
+    int offset_type;
+    int offset_private;
+    int offset_compound_head;
+
+    void set_tag(ulong pfn, uint8_t tag);
+    uint8_t tag_of(ulong pfn);
+    void init_page_type();
+    uint8_t classify(const char* page, ulong& run);
+    void scan_pfns();
+    ulong scan_page_batch(ulong pfn, ulong cnt);
+    void mark_pages(ulong page, ulong nr_pages, uint8_t tag);
+    void scan_vmalloc();
+    void scan_vm_struct(ulong area_addr);
+    void scan_dmabuf();
+
+public:
+    PageAccount();
+    void cmd_main(void) override;
+    static std::shared_ptr<PageAccount> get_instance();
+    void scan();
+    uint8_t get_tag(ulong pfn);
+    size_t get_count(uint8_t tag);
+    void count_range(ulong start_pfn, ulong end_pfn, size_t counts[PAGE_TAG_MAX]);
+    std::string format_counts(const size_t counts[PAGE_TAG_MAX]);
+    size_t get_dmabuf_size(){ scan(); return dmabuf_size; }
+    size_t get_dmabuf_untracked(){ scan(); return dmabuf_untracked; }
+    size_t get_vmalloc_pages(){ scan(); return vmalloc_pages; }
+    ulong get_min_pfn(){ return min_pfn; }
+    ulong get_max_pfn(){ return max_pfn; }
+    double get_scan_time(){ return scan_time; }
+    static const char* tag_name(uint8_t tag);
+};
+
+#endif // PAGE_ACCOUNT_DEFS_H_
@@ -255,28 +255,13 @@ unsigned char Swapinfo::uread_byte(ulonglong task_addr,ulonglong uvaddr,const st
 }
 
 bool Swapinfo::uread_buffer(ulonglong task_addr,ulonglong uvaddr,char* result, int len, const std::string& note){
-    char* buf = uread_memory(task_addr,uvaddr,len, note);
-    if(buf == nullptr){
+    if(result == nullptr){
         return false;
     }
-    memcpy(result,buf,len);
-    std::free(buf);
-    return true;
-}
-
-// read data across many pages
-// -----------------------------------------------------------------
-// |                              |                                |
-// -----------------------------------------------------------------
-//                  ^                              ^
-//                  |                              |
-char* Swapinfo::uread_memory(ulonglong task_addr,ulonglong uvaddr,int len, const std::string& note){
     int remain = len;
-    char* result = (char*)std::malloc(len);
-    // ulong orig_uvaddr = uvaddr;
     BZERO(result, len);
     while(remain > 0){
-        // read one page
+        // read one page, the missing page is left as zero
         char* buf_page = do_swap_page(task_addr,uvaddr);
         int offset_in_page = (uvaddr & ~page_mask);
         int read_len = std::min(remain, static_cast<int>(page_size) - offset_in_page);
@@ -286,12 +271,38 @@ char* Swapinfo::uread_memory(ulonglong task_addr,ulonglong uvaddr,int len, const
         }
         remain -= read_len;
         uvaddr += read_len;
-        // fprintf(fp, "uvaddr:%#llx offset_in_page:%#x read_len:%#x remain:%#x \n", uvaddr, offset_in_page, read_len, remain);
     }
-    // fprintf(fp, "\nuread_memory:\n%s \n", hexdump(orig_uvaddr, result, len).c_str());
+    return true;
+}
+
+// read data across many pages
+// -----------------------------------------------------------------
+// |                              |                                |
+// -----------------------------------------------------------------
+//                  ^                              ^
+//                  |                              |
+char* Swapinfo::uread_memory(ulonglong task_addr,ulonglong uvaddr,int len, const std::string& note){
+    char* result = (char*)std::malloc(len);
+    uread_buffer(task_addr, uvaddr, result, len, note);
+    // fprintf(fp, "\nuread_memory:\n%s \n", hexdump(uvaddr, result, len).c_str());
     return result;
 }
 
+/*
+ * Keep up to max_pages decompressed zram pages keyed by swap entry, so the
+ * pages shared by several processes are only decompressed once. 0 disables
+ * and drops the cache.
+ */
+void Swapinfo::set_page_cache(size_t max_pages){
+    page_cache_max = max_pages;
+    if (max_pages == 0){
+        page_cache.clear();
+        page_cache_order.clear();
+    }
+    cache_hits = 0;
+    cache_misses = 0;
+}
+
 bool Swapinfo::is_swap_pte(ulong pte){
     int present = 0;
 #if defined(ARM64)
@@ -364,9 +375,28 @@ char* Swapinfo::do_swap_page(ulonglong task_addr,ulonglong uvaddr){
                 fprintf(fp, "invaild zram addr: %#lx !\n",zram_addr);
                 return nullptr;
             }
+            if (page_cache_max > 0){
+                auto it = page_cache.find(pte);
+                if (it != page_cache.end()){
+                    cache_hits++;
+                    char* buf = (char*)GETBUF(page_size);
+                    memcpy(buf, it->second.data(), page_size);
+                    return buf;
+                }
+                cache_misses++;
+            }
             ulonglong index = pte_handle_index(swap_ptr,pte);
             if(debug)fprintf(fp, "read %llx from zram:%lx, index:%lld \n",page_start,zram_addr, index);
-            return zram_ptr->read_zram_page(zram_addr,index);
+            char* buf = zram_ptr->read_zram_page(zram_addr,index);
+            if (buf != nullptr && page_cache_max > 0){
+                if (page_cache.size() >= page_cache_max){
+                    page_cache.erase(page_cache_order.front());
+                    page_cache_order.pop_front();
+                }
+                page_cache.emplace(pte, std::vector<char>(buf, buf + page_size));
+                page_cache_order.push_back(pte);
+            }
+            return buf;
         }
         if(debug)fprintf(fp, "invaild PTE:%#lx vaddr:%#llx\n",pte,page_start);
         return nullptr;
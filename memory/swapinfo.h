@@ -18,6 +18,7 @@
 
 #include "plugin.h"
 #include "memory/zraminfo.h"
+#include <deque>
 
 struct swap_extent {
     struct rb_node rb_node;
@@ -60,6 +61,10 @@ protected:
     bool debug = false;
     std::shared_ptr<Zraminfo> zram_ptr;
     std::vector<std::shared_ptr<swap_info>> swap_list;
+    /* decompressed zram pages by swap entry, shared by all readers */
+    size_t page_cache_max = 0;
+    std::unordered_map<ulong, std::vector<char>> page_cache;
+    std::deque<ulong> page_cache_order;
 
 public:
     Swapinfo();
@@ -71,6 +76,9 @@ public:
     bool uread_buffer(ulonglong task_addr, ulonglong uvaddr, char *result, int len, const std::string &note);
     std::string uread_cstring(ulonglong task_addr,ulonglong uvaddr,int len, const std::string& note);
     bool is_swap_pte(ulong pte);
+    void set_page_cache(size_t max_pages);
+    size_t cache_hits = 0;
+    size_t cache_misses = 0;
 };
 
 #endif // SWAP_INFO_DEFS_H_
@@ -29,7 +29,7 @@ void Vmalloc::cmd_main(void) {
     if(area_list.size() == 0){
         parser_vmap_area_list();
     }
-    while ((c = getopt(argcnt, args, "arvsf:t:")) != EOF) {
+    while ((c = getopt(argcnt, args, "arvsof:t:")) != EOF) {
         switch(c) {
             case 'a':
                 print_vmap_area_list();
@@ -43,6 +43,9 @@ void Vmalloc::cmd_main(void) {
             case 's':
                 print_summary_info();
                 break;
+            case 'o':
+                print_vm_page_owner();
+                break;
             case 'f':
                 cppString.assign(optarg);
                 print_vm_info_caller(cppString);
@@ -75,11 +78,6 @@ Vmalloc::Vmalloc(){
     field_init(vm_struct,caller);
     struct_init(vmap_area);
     struct_init(vm_struct);
-    field_init(vmap_node,pool);
-    field_init(vmap_pool,head);
-    field_init(vmap_pool,len);
-    struct_init(vmap_node);
-    struct_init(vmap_pool);
     cmd_name = "vmalloc";
     help_str_list={
         "vmalloc",                            /* command name */
@@ -88,6 +86,7 @@ Vmalloc::Vmalloc(){
             "  vmalloc -r\n"
             "  vmalloc -v\n"
             "  vmalloc -s\n"
+            "  vmalloc -o\n"
             "  vmalloc -f <func name>\n"
             "  vmalloc -t <type name>\n"
             "  This command dumps the vmalloc info.",
@@ -149,34 +148,54 @@ Vmalloc::Vmalloc(){
         "    [3]Page:0xfffffffe000c2a80 PA:0x430aa000",
         "    [4]Page:0xfffffffe000c2ac0 PA:0x430ab000",
         "\n",
+        "  Display the owner of the pages mapped by vm_struct:",
+        "    %s> vmalloc -o",
+        "    Owner: Vmalloc:109.78MB Buddy:16KB",
+        "    ==============================================================================================================",
+        "    vm_struct:ffffff8012a4f300 kaddr:ffffffc00a3f0000 freed:4/16 foo_probe+132",
+        "\n",
     };
     initialize();
 }
 
-void Vmalloc::parser_vmap_nodes(){
-    if (!csymbol_exists("vmap_nodes")){
-        fprintf(fp, "vmap_nodes doesn't exist in this kernel!\n");
-        return;
+static const char* vm_type_names[VM_TYPE_MAX] = {
+    "ioremap", "vmalloc", "vmap", "user", "vpages", "unlist", "unknow",
+};
+
+/*
+ * Callers are interned, value_search runs once per distinct caller address
+ * instead of once per vm_struct.
+ */
+uint Vmalloc::get_caller_id(ulong caller){
+    auto it = caller_ids.find(caller);
+    if (it != caller_ids.end()){
+        return it->second;
     }
-    ulong nodes_addr = read_pointer(csymbol_value("vmap_nodes"),"vmap_nodes pages");
-    if (!is_kvaddr(nodes_addr)) return;
-    size_t nr_node = read_int( csymbol_value("nr_vmap_nodes"),"nr_vmap_nodes");
-    size_t pool_cnt = field_size(vmap_node,pool)/struct_size(vmap_pool);
-    size_t offset = field_offset(vmap_area,list);
-    for (size_t i = 0; i < nr_node; i++){
-        ulong pools_addr = nodes_addr + i * struct_size(vmap_node) + field_offset(vmap_node,pool);
-        for (size_t p = 0; p < pool_cnt; p++){
-            ulong pool_addr = pools_addr + p * struct_size(vmap_pool);
-            if (!is_kvaddr(pool_addr)) continue;
-            ulong len = read_ulong(pool_addr + field_offset(vmap_pool,len),"vmap_pool len");
-            if (len == 0){
-                continue;
-            }
-            for (const auto& area_addr : for_each_list(pool_addr,offset)) {
-                parser_vmap_area(area_addr);
-            }
+    std::string name;
+    ulong offset;
+    struct syment *sp = value_search(caller, &offset);
+    if (sp) {
+        name = sp->name;
+        size_t pos = name.find('.'); //remove the rest char
+        if (pos != std::string::npos) {
+            name = name.substr(0, pos);
         }
+        if (offset)
+            name.append("+").append(std::to_string(offset));
     }
+    // different addresses may resolve to the same name, keep one id per name
+    auto name_it = caller_names.find(name);
+    uint id;
+    if (name_it != caller_names.end()){
+        id = name_it->second;
+    } else {
+        id = callers.size();
+        callers.push_back(name);
+        caller_names[name] = id;
+        caller_stats.push_back({name, 0, 0});
+    }
+    caller_ids[caller] = id;
+    return id;
 }
 
 void Vmalloc::parser_vmap_area(ulong addr){
@@ -184,18 +203,19 @@ void Vmalloc::parser_vmap_area(ulong addr){
     if (!vmap_buf) {
         return;
     }
-    std::shared_ptr<vmap_area> area_ptr = std::make_shared<vmap_area>();
-    area_ptr->addr = addr;
-    area_ptr->va_start = ULONG(vmap_buf + field_offset(vmap_area,va_start));
-    area_ptr->va_end = ULONG(vmap_buf + field_offset(vmap_area,va_end));
-    area_list.push_back(area_ptr);
+    vmap_area area;
+    area.addr = addr;
+    area.va_start = ULONG(vmap_buf + field_offset(vmap_area,va_start));
+    area.va_end = ULONG(vmap_buf + field_offset(vmap_area,va_end));
+    area.vm_start = vm_list.size();
+    area.vm_cnt = 0;
     ulong vm_addr = ULONG(vmap_buf + field_offset(vmap_area,vm));
     FREEBUF(vmap_buf);
     while (is_kvaddr(vm_addr)){
         void *vm_buf = read_struct(vm_addr,"vm_struct");
         if (!vm_buf) {
             fprintf(fp, "Failed to read vm_struct structure at address %lx\n", vm_addr);
-            continue;
+            break;
         }
         size_t vm_size = ULONG(vm_buf + field_offset(vm_struct,size));
         size_t nr_pages = UINT(vm_buf + field_offset(vm_struct,nr_pages));
@@ -203,106 +223,108 @@ void Vmalloc::parser_vmap_area(ulong addr){
             FREEBUF(vm_buf);
             break;
         }
-        std::shared_ptr<vm_struct> vm_ptr = std::make_shared<vm_struct>();
-        vm_ptr->addr = vm_addr;
-        vm_ptr->kaddr = ULONG(vm_buf + field_offset(vm_struct,addr));
-        vm_ptr->size = vm_size;
-        vm_ptr->nr_pages = nr_pages;
-        vm_ptr->phys_addr = ULONG(vm_buf + field_offset(vm_struct,phys_addr));
+        vm_struct vm;
+        vm.addr = vm_addr;
+        vm.kaddr = ULONG(vm_buf + field_offset(vm_struct,addr));
+        vm.size = vm_size;
+        vm.nr_pages = nr_pages;
+        vm.phys_addr = ULONG(vm_buf + field_offset(vm_struct,phys_addr));
+        vm.pages = ULONG(vm_buf + field_offset(vm_struct,pages));
         ulong caller = ULONG(vm_buf + field_offset(vm_struct,caller));
         ulong next = ULONG(vm_buf + field_offset(vm_struct,next));
-        ulong pages = ULONG(vm_buf + field_offset(vm_struct,pages));
         ulong flags = ULONG(vm_buf + field_offset(vm_struct,flags));
         FREEBUF(vm_buf);
         if (flags & Vmalloc::VM_IOREMAP){
-            vm_ptr->flags.assign("ioremap");
+            vm.type = VM_TYPE_IOREMAP;
         }else if (flags & Vmalloc::VM_ALLOC){
-            vm_ptr->flags.assign("vmalloc");
+            vm.type = VM_TYPE_VMALLOC;
         }else if (flags & Vmalloc::VM_MAP){
-            vm_ptr->flags.assign("vmap");
+            vm.type = VM_TYPE_VMAP;
         }else if (flags & Vmalloc::VM_USERMAP){
-            vm_ptr->flags.assign("user");
+            vm.type = VM_TYPE_USER;
         }else if (flags & Vmalloc::VM_VPAGES){
-            vm_ptr->flags.assign("vpages");
+            vm.type = VM_TYPE_VPAGES;
         }else if (flags & Vmalloc::VM_UNLIST){
-            vm_ptr->flags.assign("unlist");
+            vm.type = VM_TYPE_UNLIST;
         }else{
-            vm_ptr->flags.assign("unknow");
-        }
-        ulong offset;
-        struct syment *sp = value_search(caller, &offset);
-        if (sp) {
-            vm_ptr->caller = sp->name;
-            size_t pos = vm_ptr->caller.find('.'); //remove the rest char
-            if (pos != std::string::npos) {
-                vm_ptr->caller = vm_ptr->caller.substr(0, pos);
-            }
-            if (offset)
-                vm_ptr->caller.append("+").append(std::to_string(offset));
+            vm.type = VM_TYPE_UNKNOW;
         }
-        if (is_kvaddr(pages)) {
-            for (int j = 0; j < vm_ptr->nr_pages; ++j) {
-                ulong addr = pages + j * sizeof(void *);
-                if (!is_kvaddr(addr)) break;
-                ulong page_addr = read_pointer(addr,"vm_struct pages");
-                if (!is_kvaddr(page_addr)) continue;
-                physaddr_t paddr = page_to_phy(page_addr);
-                if (paddr <= 0) continue;
-                vm_ptr->page_list.push_back(page_addr);
-            }
+        vm.caller = get_caller_id(caller);
+        if (!is_kvaddr(vm.pages)){
+            vm.nr_pages = 0;
         }
-        area_ptr->vm_list.push_back(vm_ptr);
+        caller_stats[vm.caller].virt_size += vm.size;
+        caller_stats[vm.caller].page_cnt += vm.nr_pages;
+        type_stats[vm.type].virt_size += vm.size;
+        type_stats[vm.type].page_cnt += vm.nr_pages;
+        vm_list.push_back(vm);
+        area.vm_cnt++;
         vm_addr = next;
     }
+    area_list.push_back(area);
+}
+
+std::vector<ulong> Vmalloc::get_vm_pages(const vm_struct& vm){
+    std::vector<ulong> page_list;
+    if (vm.nr_pages == 0 || !is_kvaddr(vm.pages)){
+        return page_list;
+    }
+    page_list.resize(vm.nr_pages);
+    if (!read_struct(vm.pages, page_list.data(), vm.nr_pages * sizeof(void *), "vm_struct pages")){
+        page_list.clear();
+        return page_list;
+    }
+    page_list.erase(std::remove_if(page_list.begin(), page_list.end(), [&](ulong page_addr){
+        return !is_kvaddr(page_addr) || page_to_phy(page_addr) <= 0;
+    }), page_list.end());
+    return page_list;
+}
+
+void Vmalloc::print_vm_pages(const vm_struct& vm, int& index, const std::string& indent){
+    for (auto page_addr : get_vm_pages(vm)){
+        physaddr_t paddr = page_to_phy(page_addr);
+        std::ostringstream oss;
+        oss << indent << "[" << std::setw(4) << std::setfill('0') << std::dec << index << "]"
+            << "Page:" << std::left << std::hex << page_addr << " "
+            << "PA:" << paddr;
+        fprintf(fp, "%s \n",oss.str().c_str());
+        index += 1;
+    }
 }
 
 void Vmalloc::parser_vmap_area_list(){
-    if (!csymbol_exists("vmap_area_list")){
-        parser_vmap_nodes();
-    }else{
-        ulong area_list_addr = csymbol_value("vmap_area_list");
-        if (!is_kvaddr(area_list_addr)) {
-            fprintf(fp, "vmap_area_list address is invalid!\n");
-            return;
-        }
-        int offset = field_offset(vmap_area,list);
-        for (const auto& area_addr : for_each_list(area_list_addr,offset)) {
-            parser_vmap_area(area_addr);
-        }
+    type_stats.clear();
+    for (int i = 0; i < VM_TYPE_MAX; i++){
+        type_stats.push_back({vm_type_names[i], 0, 0});
+    }
+    for (const auto& area_addr : for_each_vmap_area()) {
+        parser_vmap_area(area_addr);
     }
 }
 
 void Vmalloc::print_vmap_area_list(){
     size_t index = 0;
-    for(auto area: area_list){
+    for(const auto& area: area_list){
         std::ostringstream oss_area;
         oss_area << "[" << std::setw(4) << std::setfill('0') << index << "]"
-            << "vmap_area:" << std::hex << area->addr << " "
-            << "range:[" << std::hex << area->va_start << "~" << std::hex << area->va_end << "]" << " "
-            << "size:" << csize((area->va_end - area->va_start));
+            << "vmap_area:" << std::hex << area.addr << " "
+            << "range:[" << std::hex << area.va_start << "~" << std::hex << area.va_end << "]" << " "
+            << "size:" << csize((area.va_end - area.va_start));
         fprintf(fp, "%s \n",oss_area.str().c_str());
 
-        for (auto vm : area->vm_list){
+        for (size_t i = area.vm_start; i < area.vm_start + area.vm_cnt; i++){
+            const vm_struct& vm = vm_list[i];
             std::ostringstream oss_vm;
-            oss_vm << "   vm_struct:" << std::hex << vm->addr << " "
-                << "size:" << csize(vm->size) << " "
-                << "flags:" << std::dec << vm->flags.c_str() << " "
-                << "nr_pages:" << std::dec << vm->nr_pages << " "
-                << "addr:" << std::hex << vm->kaddr << " "
-                << "phys_addr:" << std::hex << vm->phys_addr << " "
-                << vm->caller;
+            oss_vm << "   vm_struct:" << std::hex << vm.addr << " "
+                << "size:" << csize(vm.size) << " "
+                << "flags:" << vm_type_names[vm.type] << " "
+                << "nr_pages:" << std::dec << vm.nr_pages << " "
+                << "addr:" << std::hex << vm.kaddr << " "
+                << "phys_addr:" << std::hex << vm.phys_addr << " "
+                << callers[vm.caller];
             fprintf(fp, "%s \n",oss_vm.str().c_str());
-
-            size_t cnt = 1;
-            for (auto page_addr : vm->page_list){
-                physaddr_t paddr = page_to_phy(page_addr);
-                std::ostringstream oss_p;
-                oss_p << "       [" << std::setw(4) << std::setfill('0') << cnt << "]"
-                    << "Page:" << std::hex << page_addr << " "
-                    << "PA:" << paddr;
-                fprintf(fp, "%s \n",oss_p.str().c_str());
-                cnt++;
-            }
+            int cnt = 1;
+            print_vm_pages(vm, cnt, "       ");
         }
         index++;
         fprintf(fp, "\n");
@@ -311,17 +333,17 @@ void Vmalloc::print_vmap_area_list(){
 
 void Vmalloc::print_vmap_area(){
     ulong total_size = 0;
-    for(auto area: area_list){
-        total_size += (area->va_end - area->va_start);
+    for(const auto& area: area_list){
+        total_size += (area.va_end - area.va_start);
     }
     fprintf(fp, "Total vm size:%s\n",csize(total_size).c_str());
     fprintf(fp, "==============================================================================================================\n");
     for(size_t i=0; i < area_list.size(); i++){
         std::ostringstream oss_area;
         oss_area << "[" << std::setw(4) << std::setfill('0') << i << "]"
-            << "vmap_area:" << std::hex << area_list[i]->addr << " "
-            << "range:[" << std::hex << area_list[i]->va_start << "~" << std::hex << area_list[i]->va_end << "]" << " "
-            << "size:" << csize((area_list[i]->va_end - area_list[i]->va_start));
+            << "vmap_area:" << std::hex << area_list[i].addr << " "
+            << "range:[" << std::hex << area_list[i].va_start << "~" << std::hex << area_list[i].va_end << "]" << " "
+            << "size:" << csize((area_list[i].va_end - area_list[i].va_start));
         fprintf(fp, "%s \n",oss_area.str().c_str());
     }
 }
@@ -329,71 +351,45 @@ void Vmalloc::print_vmap_area(){
 void Vmalloc::print_vm_struct(){
     ulong total_size = 0;
     ulong total_pages = 0;
-    for(auto area: area_list){
-        for (auto vm : area->vm_list){
-            total_size += vm->size;
-            total_pages += vm->nr_pages;
-        }
+    for (const auto& info : type_stats){
+        total_size += info.virt_size;
+        total_pages += info.page_cnt;
     }
     fprintf(fp, "Total vm size:%s, ",csize(total_size).c_str());
     fprintf(fp, "physical size:%s\n",csize(total_pages*page_size).c_str());
     fprintf(fp, "==============================================================================================================\n");
     int index = 0;
-    for(auto area: area_list){
-        for (auto vm : area->vm_list){
-            std::ostringstream oss_vm;
-            oss_vm << "[" << std::setw(4) << std::setfill('0') << index << "]"
-                << "vm_struct:" << std::hex << vm->addr << " "
-                << "size:" << std::left << std::setw(8) << std::setfill(' ') << csize(vm->size) << " "
-                << "flags:" << std::setw(8) << vm->flags << " "
-                << "nr_pages:" << std::dec << std::setw(4) << vm->nr_pages << " "
-                << "kaddr:" << std::hex << vm->kaddr << " "
-                << "phys_addr:" << std::hex << vm->phys_addr;
-            fprintf(fp, "%s \n",oss_vm.str().c_str());
-            index +=1;
-        }
+    for (const auto& vm : vm_list){
+        std::ostringstream oss_vm;
+        oss_vm << "[" << std::setw(4) << std::setfill('0') << std::dec << index << "]"
+            << "vm_struct:" << std::hex << vm.addr << " "
+            << "size:" << std::left << std::setw(8) << std::setfill(' ') << csize(vm.size) << " "
+            << "flags:" << std::setw(8) << vm_type_names[vm.type] << " "
+            << "nr_pages:" << std::dec << std::setw(4) << vm.nr_pages << " "
+            << "kaddr:" << std::hex << vm.kaddr << " "
+            << "phys_addr:" << std::hex << vm.phys_addr;
+        fprintf(fp, "%s \n",oss_vm.str().c_str());
+        index +=1;
     }
 }
 
-void Vmalloc::print_summary_caller(){
-    std::unordered_map<std::string, std::vector<std::shared_ptr<vm_struct>>> caller_map;
-    for(auto area: area_list){
-        for (auto vm : area->vm_list){
-            auto it = caller_map.find(vm->caller);
-            if (it != caller_map.end()) {
-                it->second.push_back(vm);
-            }else{
-                caller_map[vm->caller] = std::vector<std::shared_ptr<vm_struct>>{vm};
-            }
-        }
-    }
-    std::vector<vmalloc_info> callers;
-    for(const auto& pair: caller_map){
-        vmalloc_info info;
-        info.func = pair.first;
-        ulong total_size = 0;
-        ulong total_cnt = 0;
-        for(auto vm: pair.second){
-            total_size += vm->size;
-            total_cnt += vm->nr_pages;
-        }
-        info.virt_size = total_size;
-        info.page_cnt = total_cnt;
-        callers.push_back(info);
-    }
-    std::sort(callers.begin(), callers.end(),[&](vmalloc_info a, vmalloc_info b){
+void Vmalloc::print_summary(std::vector<vmalloc_info> infos, const std::string& name){
+    infos.erase(std::remove_if(infos.begin(), infos.end(), [](const vmalloc_info& info){
+        return info.virt_size == 0;
+    }), infos.end());
+    std::sort(infos.begin(), infos.end(),[&](const vmalloc_info& a, const vmalloc_info& b){
         return a.virt_size > b.virt_size;
     });
-    size_t max_len = 0;
-    for (const auto& info : callers) {
+    size_t max_len = name.size();
+    for (const auto& info : infos) {
         max_len = std::max(max_len,info.func.size());
     }
     std::ostringstream oss_hd;
-    oss_hd << std::left << std::setw(max_len + 2) << "Func Name" << " "
+    oss_hd << std::left << std::setw(max_len + 2) << name << " "
             << std::left << std::setw(15) << "virt" << " "
             << std::left << std::setw(15) << "phys";
     fprintf(fp, "%s \n",oss_hd.str().c_str());
-    for(const auto& info: callers){
+    for(const auto& info: infos){
         std::ostringstream oss;
         oss << std::left << std::setw(max_len + 2) << info.func << " "
             << std::left << std::setw(15) << csize(info.virt_size) << " "
@@ -402,51 +398,12 @@ void Vmalloc::print_summary_caller(){
     }
 }
 
+void Vmalloc::print_summary_caller(){
+    print_summary(caller_stats, "Func Name");
+}
+
 void Vmalloc::print_summary_type(){
-    std::unordered_map<std::string, std::vector<std::shared_ptr<vm_struct>>> type_maps;
-    for(auto area: area_list){
-        for (auto vm : area->vm_list){
-            auto it = type_maps.find(vm->flags);
-            if (it != type_maps.end()) {
-                it->second.push_back(vm);
-            }else{
-                type_maps[vm->flags] = std::vector<std::shared_ptr<vm_struct>>{vm};
-            }
-        }
-    }
-    std::vector<vmalloc_info> types;
-    for(const auto& pair: type_maps){
-        vmalloc_info info;
-        info.func = pair.first;
-        ulong total_size = 0;
-        ulong total_cnt = 0;
-        for(auto vm: pair.second){
-            total_size += vm->size;
-            total_cnt += vm->nr_pages;
-        }
-        info.virt_size = total_size;
-        info.page_cnt = total_cnt;
-        types.push_back(info);
-    }
-    std::sort(types.begin(), types.end(),[&](vmalloc_info a, vmalloc_info b){
-        return a.virt_size > b.virt_size;
-    });
-    size_t max_len = 0;
-    for (const auto& info : types) {
-        max_len = std::max(max_len,info.func.size());
-    }
-    std::ostringstream oss_hd;
-    oss_hd << std::left << std::setw(max_len + 2) << "Type" << " "
-            << std::left << std::setw(15) << "virt" << " "
-            << std::left << std::setw(15) << "phys";
-    fprintf(fp, "%s \n",oss_hd.str().c_str());
-    for(const auto& info: types){
-        std::ostringstream oss;
-        oss << std::left << std::setw(max_len + 2) << info.func << " "
-            << std::left << std::setw(15) << csize(info.virt_size) << " "
-            << std::left << std::setw(15) << csize(info.page_cnt*page_size);
-        fprintf(fp, "%s \n",oss.str().c_str());
-    }
+    print_summary(type_stats, "Type");
 }
 
 void Vmalloc::print_summary_info(){
@@ -459,69 +416,59 @@ void Vmalloc::print_summary_info(){
 }
 
 void Vmalloc::print_vm_info_caller(std::string func){
-    std::unordered_map<std::string, std::vector<std::shared_ptr<vm_struct>>> caller_map;
-    for(auto area: area_list){
-        for (auto vm : area->vm_list){
-            auto it = caller_map.find(vm->caller);
-            if (it != caller_map.end()) {
-                it->second.push_back(vm);
-            }else{
-                caller_map[vm->caller] = std::vector<std::shared_ptr<vm_struct>>{vm};
-            }
-        }
+    std::vector<bool> match(callers.size());
+    for (size_t i = 0; i < callers.size(); i++){
+        match[i] = callers[i].find(func) != std::string::npos;
     }
-    for (const auto& item : caller_map) {
-        std::string func_name = item.first;
-        std::vector<std::shared_ptr<vm_struct>> vm_list = item.second;
-        if (func_name.find(func) != std::string::npos) {
-            // fprintf(fp, "%s:\n",func_name.c_str());
-            int index = 1;
-            for(auto vm: vm_list){
-                for (auto page_addr : vm->page_list){
-                    physaddr_t paddr = page_to_phy(page_addr);
-                    std::ostringstream oss;
-                    oss << "[" << std::setw(4) << std::setfill('0') << index << "]"
-                        << "Page:" << std::left << std::hex << page_addr << " "
-                        << "PA:" << paddr;
-                    fprintf(fp, "%s \n",oss.str().c_str());
-                    index += 1;
-                }
-            }
+    int index = 1;
+    for (const auto& vm : vm_list){
+        if (match[vm.caller]){
+            print_vm_pages(vm, index, "");
         }
     }
 }
 
 void Vmalloc::print_vm_info_type(std::string type){
-    std::unordered_map<std::string, std::vector<std::shared_ptr<vm_struct>>> type_maps;
-    for(auto area: area_list){
-        for (auto vm : area->vm_list){
-            auto it = type_maps.find(vm->flags);
-            if (it != type_maps.end()) {
-                it->second.push_back(vm);
-            }else{
-                type_maps[vm->flags] = std::vector<std::shared_ptr<vm_struct>>{vm};
-            }
+    bool match[VM_TYPE_MAX];
+    for (int i = 0; i < VM_TYPE_MAX; i++){
+        match[i] = std::string(vm_type_names[i]).find(type) != std::string::npos;
+    }
+    int index = 1;
+    for (const auto& vm : vm_list){
+        if (match[vm.type]){
+            print_vm_pages(vm, index, "");
         }
     }
-    for (const auto& item : type_maps) {
-        std::string type_name = item.first;
-        std::vector<std::shared_ptr<vm_struct>> vm_list = item.second;
-        if (type_name.find(type) != std::string::npos) {
-            // fprintf(fp, "%s:\n",type_name.c_str());
-            int index = 1;
-            for(auto vm: vm_list){
-                for (auto page_addr : vm->page_list){
-                    physaddr_t paddr = page_to_phy(page_addr);
-                    std::ostringstream oss;
-                    oss << "[" << std::setw(4) << std::setfill('0') << index << "]"
-                        << "Page:" << std::left << std::hex << page_addr << " "
-                        << "PA:" << paddr;
-                    fprintf(fp, "%s \n",oss.str().c_str());
-                    index += 1;
-                }
-            }
+}
+
+/*
+ * The owner of every page held in a pages array from the PageAccount tags,
+ * a vm_struct which still points to pages in the buddy is listed.
+ */
+void Vmalloc::print_vm_page_owner(){
+    std::shared_ptr<PageAccount> account = PageAccount::get_instance();
+    size_t total[PAGE_TAG_MAX] = {};
+    std::ostringstream oss;
+    for (const auto& vm : vm_list){
+        std::vector<ulong> page_list = get_vm_pages(vm);
+        size_t counts[PAGE_TAG_MAX] = {};
+        for (auto page_addr : page_list){
+            counts[account->get_tag(page_to_pfn(page_addr))]++;
+        }
+        for (int i = 0; i < PAGE_TAG_MAX; i++){
+            total[i] += counts[i];
         }
+        if (counts[PAGE_TAG_BUDDY] == 0){
+            continue;
+        }
+        oss << "vm_struct:" << std::hex << vm.addr << " "
+            << "kaddr:" << std::hex << vm.kaddr << " "
+            << "freed:" << std::dec << counts[PAGE_TAG_BUDDY] << "/" << page_list.size() << " "
+            << callers[vm.caller] << "\n";
     }
+    fprintf(fp, "Owner: %s\n",account->format_counts(total).c_str());
+    fprintf(fp, "==============================================================================================================\n");
+    fprintf(fp, "%s",oss.str().c_str());
 }
 
 #pragma GCC diagnostic pop
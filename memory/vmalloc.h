@@ -18,23 +18,40 @@
 
 #include "plugin.h"
 #include "devicetree/devicetree.h"
+#include "page_account.h"
 
+enum vm_type : uint8_t {
+    VM_TYPE_IOREMAP = 0,
+    VM_TYPE_VMALLOC,
+    VM_TYPE_VMAP,
+    VM_TYPE_USER,
+    VM_TYPE_VPAGES,
+    VM_TYPE_UNLIST,
+    VM_TYPE_UNKNOW,
+    VM_TYPE_MAX,
+};
+
+/*
+ * The backing pages are not kept, only the address of the pages array,
+ * they are read when a command really prints them.
+ */
 struct vm_struct {
     ulong addr;
     ulong kaddr;
     ulong size;
-    std::string flags;
-    std::vector<ulong> page_list;
-    int nr_pages;
+    ulong pages;
+    uint nr_pages;
+    uint caller;        /* index in Vmalloc::callers */
+    uint8_t type;       /* enum vm_type */
     ulonglong phys_addr;
-    std::string caller;
 };
 
 struct vmap_area {
     ulong addr;
     ulong va_start;
     ulong va_end;
-    std::vector<std::shared_ptr<vm_struct>> vm_list;
+    size_t vm_start;    /* first vm_struct in Vmalloc::vm_list */
+    size_t vm_cnt;
 };
 
 struct vmalloc_info {
@@ -52,10 +69,20 @@ public:
     static const int VM_VPAGES =0x00000010;
     static const int VM_UNLIST =0x00000020;
 
-    std::vector<std::shared_ptr<vmap_area>> area_list;
+    std::vector<vmap_area> area_list;
+    std::vector<vm_struct> vm_list;
+    std::vector<std::string> callers;                /* interned caller symbols */
+    std::unordered_map<ulong, uint> caller_ids;      /* caller address -> index in callers */
+    std::unordered_map<std::string, uint> caller_names;
+    std::vector<vmalloc_info> caller_stats;          /* indexed by caller id */
+    std::vector<vmalloc_info> type_stats;            /* indexed by vm_type */
     Vmalloc();
 
-    void parser_vmap_nodes();
+    uint get_caller_id(ulong caller);
+    std::vector<ulong> get_vm_pages(const vm_struct& vm);
+    void print_vm_pages(const vm_struct& vm, int& index, const std::string& indent);
+    void print_summary(std::vector<vmalloc_info> infos, const std::string& name);
+
     void parser_vmap_area(ulong addr);
 
     void cmd_main(void) override;
@@ -68,6 +95,7 @@ public:
     void print_summary_type();
     void print_vm_info_caller(std::string func);
     void print_vm_info_type(std::string type);
+    void print_vm_page_owner();
     DEFINE_PLUGIN_INSTANCE(Vmalloc)
 };
 
@@ -14,6 +14,8 @@
  */
 
 #include "pageinfo.h"
+#include <chrono>
+#include <unordered_set>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -25,11 +27,30 @@ DEFINE_PLUGIN_COMMAND(Pageinfo)
 void Pageinfo::cmd_main(void) {
     int c;
     std::string cppString;
+    bool show_files = false;
+    size_t top_n = 0;
     if (argcnt < 2) cmd_usage(pc->curcmd, SYNOPSIS);
-    while ((c = getopt(argcnt, args, "af")) != EOF) {
+    while ((c = getopt(argcnt, args, "afobn:x")) != EOF) {
         switch(c) {
             case 'f':
-                print_file_pages();
+                show_files = true;
+                break;
+            case 'n':
+                try {
+                    top_n = std::stoul(optarg);
+                } catch (...) {
+                    fprintf(fp, "invalid count: %s\n", optarg);
+                    argerrs++;
+                }
+                break;
+            case 'x':
+                export_file_pages();
+                break;
+            case 'o':
+                print_orphan_pages();
+                break;
+            case 'b':
+                print_inode_walk_benchmark();
                 break;
             case 'a':
                 print_anon_pages();
@@ -39,8 +60,13 @@ void Pageinfo::cmd_main(void) {
                 break;
         }
     }
-    if (argerrs)
+    if (argerrs){
         cmd_usage(pc->curcmd, SYNOPSIS);
+        return;
+    }
+    if (show_files){
+        print_file_pages(top_n);
+    }
 }
 
 void Pageinfo::print_anon_pages(){
@@ -50,62 +76,322 @@ void Pageinfo::print_anon_pages(){
     }
 }
 
-void Pageinfo::parser_file_pages(){
+std::shared_ptr<FileCache> Pageinfo::parser_file_cache(ulong inode_addr){
     char buf[BUFSIZE];
+    std::shared_ptr<FileCache> file_ptr = std::make_shared<FileCache>();
+    file_ptr->inode = inode_addr;
+    ulong hlist_head = inode_addr + field_offset(inode,i_dentry);
+    int offset = field_offset(dentry,d_u);
+    for (const auto& dentry : for_each_hlist(hlist_head,offset)) {
+        get_pathname(dentry, buf, BUFSIZE, 1, 0);
+        file_ptr->name = buf;
+        if (!file_ptr->name.empty()){
+            break;
+        }
+    }
+    file_ptr->i_mapping = read_pointer(inode_addr + field_offset(inode,i_mapping),"i_mapping");
+    file_ptr->nrpages = read_ulong(file_ptr->i_mapping + field_offset(address_space, nrpages), "nrpages");
+    ulonglong i_size = read_ulonglong(inode_addr + field_offset(inode,i_size),"i_size");
+    file_ptr->size_pages = (i_size + page_size - 1) / page_size;
+    return file_ptr;
+}
+
+void Pageinfo::parser_file_pages(){
     for (const auto& addr : for_each_inode()) {
-        std::shared_ptr<FileCache> file_ptr = std::make_shared<FileCache>();
-        file_ptr->inode = addr;
-        ulong hlist_head = addr + field_offset(inode,i_dentry);
-        int offset = field_offset(dentry,d_u);
-        for (const auto& dentry : for_each_hlist(hlist_head,offset)) {
-            get_pathname(dentry, buf, BUFSIZE, 1, 0);
-            file_ptr->name = buf;
-            if (!file_ptr->name.empty()){
-                break;
+        cache_list.push_back(parser_file_cache(addr));
+    }
+}
+
+/*
+ * Residency of one file from its xarray: a bitmap of the cached indexes,
+ * the cached ranges, and the dirty/writeback pages from the page flags.
+ */
+void Pageinfo::parser_residency(std::shared_ptr<FileCache> file_ptr){
+    if (file_ptr->parsed){
+        return;
+    }
+    file_ptr->parsed = true;
+    std::vector<std::pair<ulong, ulong>> pagelist = for_each_cache_page(file_ptr->i_mapping);
+    if (pagelist.empty()){
+        return;
+    }
+    ulong max_index = pagelist.back().first;
+    if (max_index < CACHE_BITMAP_MAX_PAGES){
+        file_ptr->bitmap.assign(max_index / 64 + 1, 0);
+    }
+    for (const auto& pair : pagelist) {
+        ulong index = pair.first;
+        file_ptr->resident++;
+        if (!file_ptr->bitmap.empty()){
+            file_ptr->bitmap[index / 64] |= (1ULL << (index % 64));
+        }
+        if (!file_ptr->runs.empty() && file_ptr->runs.back().first + file_ptr->runs.back().second == index){
+            file_ptr->runs.back().second++;
+        } else {
+            file_ptr->runs.push_back(std::make_pair(index, 1UL));
+        }
+    }
+    if (pg_dirty >= 0 || pg_writeback >= 0){
+        parser_page_flags(file_ptr, pagelist);
+    }
+}
+
+/*
+ * Page cache pages of a file are mostly close in the memmap, so the flags
+ * are taken from one read of up to CACHE_FLAGS_BATCH struct page instead
+ * of one read per page. A span which can't be read falls back to the
+ * single pages in it.
+ */
+void Pageinfo::parser_page_flags(std::shared_ptr<FileCache> file_ptr, const std::vector<std::pair<ulong, ulong>>& pagelist){
+    std::vector<ulong> pages;
+    pages.reserve(pagelist.size());
+    for (const auto& pair : pagelist) {
+        pages.push_back(pair.second);
+    }
+    std::sort(pages.begin(), pages.end());
+    size_t page_sz = struct_size(page);
+    int flags_offset = field_offset(page,flags);
+    size_t span = CACHE_FLAGS_BATCH * page_sz;
+    std::vector<char> buf(span);
+    auto count_flags = [&](ulong flags) {
+        if (pg_dirty >= 0 && (flags & (1UL << pg_dirty))){
+            file_ptr->dirty++;
+        }
+        if (pg_writeback >= 0 && (flags & (1UL << pg_writeback))){
+            file_ptr->writeback++;
+        }
+    };
+    size_t i = 0;
+    while (i < pages.size()){
+        ulong start = pages[i];
+        size_t end = i + 1;
+        while (end < pages.size() && pages[end] + page_sz <= start + span){
+            end++;
+        }
+        size_t len = pages[end - 1] + page_sz - start;
+        if (readmem(start, KVADDR, buf.data(), len, TO_CONST_STRING("page flags"), RETURN_ON_ERROR|QUIET)){
+            for (size_t j = i; j < end; j++) {
+                count_flags(ULONG(buf.data() + (pages[j] - start) + flags_offset));
+            }
+        } else {
+            for (size_t j = i; j < end; j++) {
+                ulong flags;
+                if (readmem(pages[j] + flags_offset, KVADDR, &flags, sizeof(flags), TO_CONST_STRING("page flags"), RETURN_ON_ERROR|QUIET)){
+                    count_flags(flags);
+                }
             }
         }
-        file_ptr->i_mapping = read_pointer(addr + field_offset(inode,i_mapping),"i_mapping");
-        file_ptr->nrpages = read_ulong(file_ptr->i_mapping + field_offset(address_space, nrpages), "nrpages");
-        cache_list.push_back(file_ptr);
+        i = end;
     }
 }
 
-void Pageinfo::print_file_pages(){
-    if (cache_list.size() == 0){
-        parser_file_pages();
+size_t Pageinfo::count_cached(std::shared_ptr<FileCache> file_ptr, size_t first, size_t last){
+    size_t nr_bits = file_ptr->bitmap.size() * 64;
+    last = std::min(last, nr_bits);
+    size_t cached = 0;
+    while (first < last){
+        size_t bit = first % 64;
+        size_t len = std::min(last - first, 64 - bit);
+        uint64_t mask = (len == 64) ? ~0ULL : (((1ULL << len) - 1) << bit);
+        cached += __builtin_popcountll(file_ptr->bitmap[first / 64] & mask);
+        first += len;
     }
-    uint64_t total_size = 0;
-    for (const auto& file_ptr : cache_list) {
-        total_size += file_ptr->nrpages;
+    return cached;
+}
+
+/*
+ * The file split in CACHE_MAP_WIDTH parts by page index, each shown by how
+ * much of it is cached: ' ' none, '.' < 25%, ':' < 50%, '+' < 100%, '#' all.
+ * The range goes to i_size, so uncached pages at the end show up too; a
+ * file shorter than the map gives every page several chars.
+ */
+std::string Pageinfo::residency_map(std::shared_ptr<FileCache> file_ptr){
+    if (file_ptr->bitmap.empty()){
+        return std::string(CACHE_MAP_WIDTH, file_ptr->runs.empty() ? ' ' : '?');
     }
-    fprintf(fp, "Total File cache size: %s \n",csize(total_size * page_size).c_str());
-    std::sort(cache_list.begin(), cache_list.end(),[&](std::shared_ptr<FileCache> a, std::shared_ptr<FileCache> b){
+    std::string map;
+    size_t nr_pages = file_ptr->runs.back().first + file_ptr->runs.back().second;
+    nr_pages = std::max(nr_pages, (size_t)file_ptr->size_pages);
+    for (size_t i = 0; i < CACHE_MAP_WIDTH; i++) {
+        size_t first = i * nr_pages / CACHE_MAP_WIDTH;
+        size_t last = std::max((i + 1) * nr_pages / CACHE_MAP_WIDTH, first + 1);
+        size_t total = last - first;
+        size_t cached = count_cached(file_ptr, first, last);
+        if (cached == 0){
+            map += ' ';
+        } else if (cached == total){
+            map += '#';
+        } else if (cached * 4 < total){
+            map += '.';
+        } else if (cached * 2 < total){
+            map += ':';
+        } else {
+            map += '+';
+        }
+    }
+    return map;
+}
+
+/*
+ * Only the top_n files by nrpages are sorted and get their residency
+ * parsed, 0 means all of them.
+ */
+void Pageinfo::print_file_list(std::vector<std::shared_ptr<FileCache>>& file_list, size_t top_n){
+    if (top_n == 0 || top_n > file_list.size()){
+        top_n = file_list.size();
+    }
+    std::partial_sort(file_list.begin(), file_list.begin() + top_n, file_list.end(),[&](const std::shared_ptr<FileCache>& a, const std::shared_ptr<FileCache>& b){
         return a->nrpages > b->nrpages;
     });
-    fprintf(fp, "===============================================\n");
     std::ostringstream oss_hd;
     oss_hd  << std::left << std::setw(VADDR_PRLEN)  << "inode" << " "
             << std::left << std::setw(VADDR_PRLEN)  << "address_space" << " "
             << std::left << std::setw(8)            << "nrpages" << " "
             << std::left << std::setw(10)           << "size" << " "
+            << std::left << std::setw(6)            << "dirty" << " "
+            << std::left << std::setw(6)            << "wb" << " "
+            << std::left << std::setw(6)            << "ranges" << " "
+            << std::left << std::setw(CACHE_MAP_WIDTH + 2) << "residency" << " "
             << std::left << "Path";
     fprintf(fp, "%s \n",oss_hd.str().c_str());
-    for (const auto& file_ptr : cache_list) {
+    for (size_t i = 0; i < top_n; i++) {
+        const auto& file_ptr = file_list[i];
+        parser_residency(file_ptr);
         std::ostringstream oss;
         oss << std::left << std::hex  << std::setw(VADDR_PRLEN) << file_ptr->inode << " "
             << std::left << std::hex  << std::setw(VADDR_PRLEN) << file_ptr->i_mapping << " "
             << std::left << std::dec  << std::setw(8)           << file_ptr->nrpages << " "
             << std::left << std::dec  << std::setw(10)          << csize(file_ptr->nrpages * page_size) << " "
+            << std::left << std::dec  << std::setw(6)           << file_ptr->dirty << " "
+            << std::left << std::dec  << std::setw(6)           << file_ptr->writeback << " "
+            << std::left << std::dec  << std::setw(6)           << file_ptr->runs.size() << " "
+            << "[" << residency_map(file_ptr) << "]" << " "
             << std::left << file_ptr->name;
         fprintf(fp, "%s \n",oss.str().c_str());
     }
 }
 
+void Pageinfo::print_file_pages(size_t top_n){
+    if (cache_list.size() == 0){
+        parser_file_pages();
+    }
+    uint64_t total_size = 0;
+    for (const auto& file_ptr : cache_list) {
+        total_size += file_ptr->nrpages;
+    }
+    fprintf(fp, "Total File cache size: %s \n",csize(total_size * page_size).c_str());
+    fprintf(fp, "===============================================\n");
+    print_file_list(cache_list, top_n);
+}
+
+/*
+ * Save the residency of every file to page_cache.bin, so two dumps of the
+ * same device can be compared. All fields are little endian:
+ *   header: u32 magic, u32 version, u32 page_size, u32 nr_files
+ *   file:   u64 inode, u64 nrpages, u64 dirty, u64 writeback,
+ *           u32 path_len, path, u32 nr_ranges, nr_ranges * <u64 index, u64 pages>
+ * Ranges are used instead of the bitmap as cached files are mostly a few
+ * long runs.
+ */
+void Pageinfo::export_file_pages(){
+    if (cache_list.size() == 0){
+        parser_file_pages();
+    }
+    std::stringstream file_path = get_curpath();
+    file_path << "/page_cache.bin";
+    FILE* file = fopen(file_path.str().c_str(), "wb");
+    if (!file) {
+        fprintf(fp, "Can't open %s\n", file_path.str().c_str());
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto put32 = [&](uint32_t val) { fwrite(&val, sizeof(val), 1, file); };
+    auto put64 = [&](uint64_t val) { fwrite(&val, sizeof(val), 1, file); };
+    put32(CACHE_EXPORT_MAGIC);
+    put32(CACHE_EXPORT_VERSION);
+    put32(page_size);
+    put32(cache_list.size());
+    size_t nr_pages = 0;
+    for (const auto& file_ptr : cache_list) {
+        parser_residency(file_ptr);
+        put64(file_ptr->inode);
+        put64(file_ptr->nrpages);
+        put64(file_ptr->dirty);
+        put64(file_ptr->writeback);
+        put32(file_ptr->name.size());
+        fwrite(file_ptr->name.data(), 1, file_ptr->name.size(), file);
+        put32(file_ptr->runs.size());
+        for (const auto& run : file_ptr->runs) {
+            put64(run.first);
+            put64(run.second);
+        }
+        nr_pages += file_ptr->resident;
+    }
+    size_t file_size = ftell(file);
+    fclose(file);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    fprintf(fp, "Save %zu files %zu pages to %s, %s, %.3fs\n", cache_list.size(), nr_pages,
+        file_path.str().c_str(), csize(file_size).c_str(), elapsed.count());
+}
+
+/*
+ * Mappings whose host is on no s_inodes list, e.g. inodes already taken
+ * off their super_block, can only be found from struct page.
+ */
+void Pageinfo::print_orphan_pages(){
+    std::vector<ulong> sb_list = for_each_inode_by_sb();
+    std::unordered_set<ulong> sb_set(sb_list.begin(), sb_list.end());
+    std::vector<std::shared_ptr<FileCache>> orphan_list;
+    uint64_t total_size = 0;
+    for (const auto& addr : for_each_inode_by_pfn()) {
+        if (sb_set.find(addr) != sb_set.end()){
+            continue;
+        }
+        std::shared_ptr<FileCache> file_ptr = parser_file_cache(addr);
+        total_size += file_ptr->nrpages;
+        orphan_list.push_back(file_ptr);
+    }
+    fprintf(fp, "Orphan File cache size: %s \n",csize(total_size * page_size).c_str());
+    fprintf(fp, "===============================================\n");
+    print_file_list(orphan_list, 0);
+}
+
+void Pageinfo::print_inode_walk_benchmark(){
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ulong> sb_list = for_each_inode_by_sb();
+    std::chrono::duration<double> sb_time = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    std::vector<ulong> pfn_list = for_each_inode_by_pfn();
+    std::chrono::duration<double> pfn_time = std::chrono::steady_clock::now() - start;
+    std::unordered_set<ulong> sb_set(sb_list.begin(), sb_list.end());
+    std::unordered_set<ulong> pfn_set(pfn_list.begin(), pfn_list.end());
+    size_t sb_only = 0;
+    size_t pfn_only = 0;
+    for (const auto& addr : sb_list) {
+        if (pfn_set.find(addr) == pfn_set.end()) sb_only++;
+    }
+    for (const auto& addr : pfn_list) {
+        if (sb_set.find(addr) == sb_set.end()) pfn_only++;
+    }
+    fprintf(fp, "%-12s %-8s %-10s %s\n", "method", "inodes", "only", "time");
+    fprintf(fp, "%-12s %-8zu %-10zu %.3fs\n", "super_block", sb_list.size(), sb_only, sb_time.count());
+    fprintf(fp, "%-12s %-8zu %-10zu %.3fs\n", "pfn", pfn_list.size(), pfn_only, pfn_time.count());
+}
+
 void Pageinfo::init_offset(){
     field_init(inode,i_mapping);
+    field_init(inode,i_size);
     field_init(inode,i_dentry);
     field_init(inode,i_sb);
     field_init(dentry,d_u);
+    field_init(page,flags);
+    long val = 0;
+    if (enumerator_value(TO_CONST_STRING("PG_dirty"), &val)){
+        pg_dirty = val;
+    }
+    if (enumerator_value(TO_CONST_STRING("PG_writeback"), &val)){
+        pg_writeback = val;
+    }
 }
 
 Pageinfo::Pageinfo(){
@@ -113,8 +399,11 @@ Pageinfo::Pageinfo(){
     help_str_list={
         "cache",                            /* command name */
         "dump page information",        /* short description */
-        "-f \n"
+        "-f [-n count]\n"
+            "  cache -x\n"
             "  cache -a\n"
+            "  cache -o\n"
+            "  cache -b\n"
             "  This command dumps the page cache info.",
         "\n",
         "EXAMPLES",
@@ -122,11 +411,11 @@ Pageinfo::Pageinfo(){
         "    %s> cache -f",
         "    Total File cache size: 570.22MB",
         "    ===============================================",
-        "    inode            address_space    nrpages  size       Path",
-        "    ffffff805c413178 ffffff805c413340 16220    63.36MB    /app/webview/webview.apk",
-        "    ffffff805c4e6128 ffffff805c4e62f0 8768     34.25MB    /priv-app/Settings/Settings.apk",
-        "    ffffff8032903848 ffffff8032903a10 8590     33.55MB    /system/framework/framework.jar",
-        "    ffffff803d3daaa8 ffffff803d3dac70 4209     16.44MB    /system/framework/services.jar",
+        "    inode            address_space    nrpages  size       dirty  wb     ranges residency          Path",
+        "    ffffff805c413178 ffffff805c413340 16220    63.36MB    0      0      212    [##++#:+#.:+##+##] /app/webview/webview.apk",
+        "    ffffff805c4e6128 ffffff805c4e62f0 8768     34.25MB    0      0      97     [#+:+##:. .:+#+:.] /priv-app/Settings/Settings.apk",
+        "    ffffff8032903848 ffffff8032903a10 8590     33.55MB    0      0      1      [################] /system/framework/framework.jar",
+        "    ffffff803d3daaa8 ffffff803d3dac70 4209     16.44MB    0      0      41     [#+#+:+##+:.:+#+#] /system/framework/services.jar",
         "\n",
         "  Display page cache of inode:",
         "    %s> files -p ffffff805c413178",
@@ -139,6 +428,31 @@ Pageinfo::Pageinfo(){
         "    fffffffe00bc6d80 6f1b6000 ffffff805c413340        3  3 10000000020014 uptodate,lru,mappedtodisk",
         "    fffffffe012b4cc0 8ad33000 ffffff805c413340        4  3 10000000020014 uptodate,lru,mappedtodisk",
         "\n",
+        "  Display the top 2 files by page cache:",
+        "    %s> cache -f -n 2",
+        "    Total File cache size: 570.22MB",
+        "    ===============================================",
+        "    inode            address_space    nrpages  size       dirty  wb     ranges residency          Path",
+        "    ffffff805c413178 ffffff805c413340 16220    63.36MB    0      0      212    [##++#:+#.:+##+##] /app/webview/webview.apk",
+        "    ffffff805c4e6128 ffffff805c4e62f0 8768     34.25MB    0      0      97     [#+:+##:. .:+#+:.] /priv-app/Settings/Settings.apk",
+        "\n",
+        "  Save the page cache residency of all files:",
+        "    %s> cache -x",
+        "    Save 18734 files 146043 pages to xxx/page_cache.bin, 1.02MB, 1.384s",
+        "\n",
+        "  Display page cache of inodes which are on no super_block:",
+        "    %s> cache -o",
+        "    Orphan File cache size: 1.23MB",
+        "    ===============================================",
+        "    inode            address_space    nrpages  size       dirty  wb     ranges residency          Path",
+        "    ffffff8031e0a2b8 ffffff8031e0a480 312      1.22MB     12     0      3      [              ##] /data/local/tmp/deleted.log",
+        "\n",
+        "  Compare the super_block inode walk with the pfn scan:",
+        "    %s> cache -b",
+        "    method       inodes   only       time",
+        "    super_block  18734    0          0.412s",
+        "    pfn          18761    27         38.906s",
+        "\n",
         "  Display anon pages:",
         "    %s> cache -a",
         "    page:0xfffffffe0007f300  paddr:0x41fcc000",
@@ -18,23 +18,47 @@
 
 #include "plugin.h"
 
+#define CACHE_BITMAP_MAX_PAGES  (1UL << 28)     /* no residency bitmap past this index */
+#define CACHE_EXPORT_MAGIC      0x53524350      /* "PCRS" */
+#define CACHE_EXPORT_VERSION    1
+#define CACHE_MAP_WIDTH         16              /* chars of the residency map */
+#define CACHE_FLAGS_BATCH       64              /* struct page span read at once for the flags */
+
 struct FileCache {
     ulong inode;
     std::string name;
     ulong i_mapping;
     ulong nrpages;
+    ulong size_pages = 0;           /* i_size in pages */
+    bool parsed = false;            /* residency below is filled */
+    ulong resident = 0;             /* pages found in the xarray */
+    ulong dirty = 0;
+    ulong writeback = 0;
+    std::vector<uint64_t> bitmap;   /* bit n is set when page index n is cached */
+    std::vector<std::pair<ulong, ulong>> runs; /* <first index, pages> of cached ranges */
 };
 
 class Pageinfo : public ParserPlugin {
 private:
     std::vector<std::shared_ptr<FileCache>> cache_list;
-    
+    long pg_dirty = -1;
+    long pg_writeback = -1;
+
 public:
     Pageinfo();
     bool page_buddy(ulong page_addr);
     int page_count(ulong page_addr);
+    std::shared_ptr<FileCache> parser_file_cache(ulong inode_addr);
     void parser_file_pages();
-    void print_file_pages();
+    void parser_residency(std::shared_ptr<FileCache> file_ptr);
+    void parser_page_flags(std::shared_ptr<FileCache> file_ptr, const std::vector<std::pair<ulong, ulong>>& pagelist);
+    size_t count_cached(std::shared_ptr<FileCache> file_ptr, size_t first, size_t last);
+    std::string residency_map(std::shared_ptr<FileCache> file_ptr);
+    void print_file_list(std::vector<std::shared_ptr<FileCache>>& file_list, size_t top_n);
+    void print_file_pages(size_t top_n);
+    void export_file_pages();
+    void print_orphan_pages();
+    void print_inode_walk_benchmark();
     void init_offset();
     void cmd_main(void) override;
     void print_anon_pages();
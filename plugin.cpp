@@ -14,6 +14,7 @@
  */
 
 #include "plugin.h"
+#include "utils/symbol_index.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -298,7 +299,62 @@ std::vector<ulong> ParserPlugin::for_each_pfn(){
     return res;
 }
 
+/*
+ * Inodes with page cache, from the s_inodes list of every super_block. The
+ * pfn scan is only used when that walk finds nothing.
+ */
 std::vector<ulong> ParserPlugin::for_each_inode(){
+    std::vector<ulong> inode_list = for_each_inode_by_sb();
+    if (inode_list.size() == 0){
+        inode_list = for_each_inode_by_pfn();
+    }
+    return inode_list;
+}
+
+std::vector<ulong> ParserPlugin::for_each_inode_by_sb(){
+    std::vector<ulong> inode_list;
+    for_each_cached_inode([&](ulong inode, const char* inode_buf, ulong i_mapping, ulong nrpages) {
+        inode_list.push_back(inode);
+    });
+    return inode_list;
+}
+
+/*
+ * Call back for every inode on the s_inodes lists which has page cache,
+ * with the inode read in one go, its i_mapping and nrpages.
+ */
+void ParserPlugin::for_each_cached_inode(std::function<void (ulong inode, const char* inode_buf, ulong i_mapping, ulong nrpages)> callback){
+    field_init(inode,i_data);
+    struct_init(inode);
+    int inode_size = struct_size(inode);
+    int i_data_offset = field_offset(inode,i_data);
+    if (inode_size <= 0 || i_data_offset == -1){
+        return;
+    }
+    int i_mapping_offset = field_offset(inode,i_mapping);
+    int nrpages_offset = field_offset(address_space,nrpages);
+    std::vector<char> buf(inode_size);
+    for (const auto& sb : for_each_super_block()) {
+        for (const auto& addr : for_each_sb_inode(sb)) {
+            if (!read_struct(addr, buf.data(), inode_size, "inode")){
+                continue;
+            }
+            ulong i_mapping = ULONG(buf.data() + i_mapping_offset);
+            if (!is_kvaddr(i_mapping)){
+                continue;
+            }
+            // i_mapping is &inode->i_data except for a few special files
+            ulong nrpages = (i_mapping == addr + i_data_offset) ? ULONG(buf.data() + i_data_offset + nrpages_offset)
+                                                                : read_ulong(i_mapping + nrpages_offset,"nrpages");
+            if (nrpages == 0){
+                continue;
+            }
+            callback(addr, buf.data(), i_mapping, nrpages);
+        }
+    }
+}
+
+std::vector<ulong> ParserPlugin::for_each_inode_by_pfn(){
     std::set<ulong> inode_list;
     for (const auto& page : for_each_file_page()) {
         ulong mapping = read_pointer(page + field_offset(page,mapping),"mapping");
@@ -320,6 +376,115 @@ std::vector<ulong> ParserPlugin::for_each_inode(){
     return res;
 }
 
+std::vector<ulong> ParserPlugin::for_each_super_block(){
+    std::vector<ulong> sb_list;
+    if (!csymbol_exists("super_blocks")){
+        return sb_list;
+    }
+    field_init(super_block, s_list);
+    for (const auto& addr : for_each_list(csymbol_value("super_blocks"), field_offset(super_block, s_list))) {
+        if (!is_kvaddr(addr)) continue;
+        sb_list.push_back(addr);
+    }
+    return sb_list;
+}
+
+/*
+ * Every vmap_area, from vmap_area_list or, since 6.9, from the per-node
+ * vmap_pool lists.
+ */
+std::vector<ulong> ParserPlugin::for_each_vmap_area(){
+    std::vector<ulong> area_list;
+    field_init(vmap_area,list);
+    int offset = field_offset(vmap_area,list);
+    if (csymbol_exists("vmap_area_list")){
+        ulong area_list_addr = csymbol_value("vmap_area_list");
+        if (!is_kvaddr(area_list_addr)) {
+            return area_list;
+        }
+        return for_each_list(area_list_addr,offset);
+    }
+    if (!csymbol_exists("vmap_nodes")){
+        return area_list;
+    }
+    field_init(vmap_node,pool);
+    field_init(vmap_pool,len);
+    struct_init(vmap_node);
+    struct_init(vmap_pool);
+    ulong nodes_addr = read_pointer(csymbol_value("vmap_nodes"),"vmap_nodes pages");
+    if (!is_kvaddr(nodes_addr)) return area_list;
+    int nr_node = read_int(csymbol_value("nr_vmap_nodes"),"nr_vmap_nodes");
+    int pool_cnt = field_size(vmap_node,pool)/struct_size(vmap_pool);
+    for (int i = 0; i < nr_node; i++){
+        ulong pools_addr = nodes_addr + i * struct_size(vmap_node) + field_offset(vmap_node,pool);
+        for (int p = 0; p < pool_cnt; p++){
+            ulong pool_addr = pools_addr + p * struct_size(vmap_pool);
+            if (!is_kvaddr(pool_addr)) continue;
+            ulong len = read_ulong(pool_addr + field_offset(vmap_pool,len),"vmap_pool len");
+            if (len == 0){
+                continue;
+            }
+            for (const auto& area_addr : for_each_list(pool_addr,offset)) {
+                area_list.push_back(area_addr);
+            }
+        }
+    }
+    return area_list;
+}
+
+std::vector<ulong> ParserPlugin::for_each_sb_inode(ulong sb_addr){
+    std::vector<ulong> inode_list;
+    if (!is_kvaddr(sb_addr)){
+        return inode_list;
+    }
+    field_init(super_block, s_inodes);
+    field_init(inode, i_sb_list);
+    ulong list_head = sb_addr + field_offset(super_block, s_inodes);
+    for (const auto& addr : for_each_list(list_head, field_offset(inode, i_sb_list))) {
+        if (!is_kvaddr(addr)) continue;
+        inode_list.push_back(addr);
+    }
+    return inode_list;
+}
+
+/*
+ * Pages of an address_space as <index, page>, ordered by index, so the
+ * caller knows the file offset of every page and where the holes are.
+ */
+std::vector<std::pair<ulong, ulong>> ParserPlugin::for_each_cache_page(ulong i_mapping){
+    std::vector<std::pair<ulong, ulong>> res;
+    if (!is_kvaddr(i_mapping)){
+        return res;
+    }
+    int i_pages_offset = field_offset(address_space,i_pages);
+    if (i_pages_offset == -1){
+        i_pages_offset = field_offset(address_space,page_tree);
+    }
+    std::string i_pages_type = MEMBER_TYPE_NAME(TO_CONST_STRING("address_space"), TO_CONST_STRING("i_pages"));
+    bool xarray = (i_pages_type == "xarray");
+    ulong root = i_mapping + i_pages_offset;
+    size_t entry_num = xarray ? do_xarray(root, XARRAY_COUNT, NULL) : do_radix_tree(root, RADIX_TREE_COUNT, NULL);
+    if (entry_num == 0){
+        return res;
+    }
+    struct list_pair *entry_list = (struct list_pair *)GETBUF((entry_num + 1) * sizeof(struct list_pair));
+    entry_list[0].index = entry_num;
+    if (xarray){
+        do_xarray(root, XARRAY_GATHER, entry_list);
+    } else {
+        do_radix_tree(root, RADIX_TREE_GATHER, entry_list);
+    }
+    res.reserve(entry_num);
+    for (size_t i = 0; i < entry_num; ++i){
+        ulong addr = (ulong)entry_list[i].value;
+        if (!is_kvaddr(addr))continue; // shadow and swap entries
+        res.push_back(std::make_pair(entry_list[i].index, addr));
+    }
+    FREEBUF(entry_list);
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
 std::vector<ulong> ParserPlugin::for_each_file_page(){
     std::vector<ulong> res;
     for (const auto& pfn : for_each_pfn()) {
@@ -887,13 +1052,11 @@ std::vector<ulong> ParserPlugin::for_each_task_files(struct task_context *tc){
         return file_table;
     }
     file_table.resize(max_fds);
+    // the fd array is read in one go, one pointer at a time only if that fails
+    bool bulk = read_struct(fds, file_table.data(), max_fds * sizeof(ulong), "fds");
     for (size_t i = 0; i < max_fds; i++){
-        ulong file_addr = read_pointer(fds + i * sizeof(struct file *),"fd");
-        if (!is_kvaddr(file_addr)){
-            file_table[i] = 0;
-            continue;
-        }
-        file_table[i] = file_addr;
+        ulong file_addr = bulk ? file_table[i] : read_pointer(fds + i * sizeof(struct file *),"fd");
+        file_table[i] = is_kvaddr(file_addr) ? file_addr : 0;
     }
     return file_table;
 }
@@ -1462,9 +1625,12 @@ ulong ParserPlugin::get_arm_pte(ulong task_addr, ulong page_vaddr){
 
 bool ParserPlugin::load_symbols(std::string& path, std::string name){
     if (is_directory(TO_CONST_STRING(path.c_str()))){
-        char * buf = search_directory_tree(TO_CONST_STRING(path.c_str()), TO_CONST_STRING(name.c_str()), 1);
-        if (buf){
-            std::string retbuf(buf);
+        const std::vector<std::string>* paths = SymbolIndex::instance().find_all(path, name);
+        if (paths == nullptr){
+            return false;
+        }
+        for (const auto& file_path : *paths){
+            std::string retbuf(file_path);
             if (is_elf_file(TO_CONST_STRING(retbuf.c_str())) && add_symbol_file(retbuf)){
                 // fprintf(fp, "Add symbol:%s succ \n",retbuf.c_str());
                 path = retbuf;
@@ -145,9 +145,16 @@ public:
     std::vector<ulong> for_each_file_page();
     std::vector<ulong> for_each_anon_page();
     std::vector<ulong> for_each_inode();
+    std::vector<ulong> for_each_inode_by_sb();
+    void for_each_cached_inode(std::function<void (ulong inode, const char* inode_buf, ulong i_mapping, ulong nrpages)> callback);
+    std::vector<ulong> for_each_inode_by_pfn();
+    std::vector<ulong> for_each_super_block();
+    std::vector<ulong> for_each_sb_inode(ulong sb_addr);
+    std::vector<std::pair<ulong, ulong>> for_each_cache_page(ulong i_mapping);
     std::vector<ulong> for_each_process();
     std::vector<ulong> for_each_threads();
     std::vector<ulong> for_each_vma(ulong& task_addr);
+    std::vector<ulong> for_each_vmap_area();
     std::vector<ulong> for_each_char_device();
     std::vector<ulong> for_each_cdev();
     std::vector<ulong> for_each_disk();
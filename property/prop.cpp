@@ -14,6 +14,7 @@
  */
 
 #include "prop.h"
+#include "utils/symbol_index.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -43,6 +44,7 @@ void Prop::cmd_main(void) {
                             // fprintf(fp, "%s : %s\n",symbol.name.c_str(),symbol.path.c_str());
                         }
                     }
+                    SymbolIndex::instance().recheck();
                 } catch (...) {
                     fprintf(fp, "invaild arg %s\n",optarg);
                 }
@@ -50,13 +52,7 @@ void Prop::cmd_main(void) {
             break;
             case 'a':
             {
-                if (prop_map.size() == 0){
-                    parser_propertys();
-                    parser_prop_by_init();
-                    if(task_ptr != nullptr){
-                        task_ptr.reset();
-                    }
-                }
+                load_props();
                 print_propertys();
             }
             break;
@@ -68,7 +64,12 @@ void Prop::cmd_main(void) {
                         fprintf(fp, "invaild prop name: %s\n",optarg);
                         return;
                     }
-                    fprintf(fp, "%s \n",get_prop(cppString).c_str());
+                    // a name ending with '.' is a prefix, list every property below it
+                    if (cppString.back() == '.'){
+                        print_props_by_prefix(cppString);
+                    }else{
+                        fprintf(fp, "%s \n",get_prop(cppString).c_str());
+                    }
                 } catch (...) {
                     fprintf(fp, "invaild arg %s\n",optarg);
                 }
@@ -98,7 +99,7 @@ void Prop::init_command(){
         "dump android property information",        /* short description */
         "-s <symbol directory path>\n"
             "  getprop -a\n"
-            "  getprop -p <prop name>\n"
+            "  getprop -p <prop name | prefix.>\n"
             "  This command dumps the property info.",
         "\n",
         "EXAMPLES",
@@ -119,23 +120,13 @@ void Prop::init_command(){
         "    %s> getprop -p ro.crypto.state",
         "    encrypted",
         "\n",
+        "  Display the propertys under a prefix, the prefix ends with '.':",
+        "    %s> getprop -p ro.crypto.",
+        "    [0001]ro.crypto.state encrypted",
+        "    [0002]ro.crypto.type  file",
+        "\n",
     };
     initialize();
 }
 
-void Prop::print_propertys(){
-    size_t max_len = 0;
-    for (const auto& pair : prop_map) {
-        max_len = std::max(max_len,pair.first.size());
-    }
-    size_t index = 1;
-    for (const auto& pair : prop_map) {
-        std::ostringstream oss;
-        oss << "[" << std::setw(4) << std::setfill('0') << index << "]"
-            << std::left << std::setw(max_len) << std::setfill(' ') << pair.first << " "
-            << std::left << pair.second;
-        fprintf(fp, "%s \n",oss.str().c_str());
-        index++;
-    }
-}
 #pragma GCC diagnostic pop
@@ -24,7 +24,6 @@ public:
     Prop();
     Prop(std::shared_ptr<Swapinfo> swap);
     void init_command();
-    void print_propertys();
     void cmd_main(void) override;
     DEFINE_PLUGIN_INSTANCE(Prop)
 };
@@ -22,18 +22,112 @@ void PropInfo::cmd_main(void) {
 
 }
 
-std::string PropInfo::get_prop(std::string name){
-    if (prop_map.size() == 0){
-        parser_prop_by_init();
-        parser_propertys();
-        if(task_ptr != nullptr){
-            task_ptr.reset();
+uint32_t PropTable::hash(const char* str, size_t len){
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++){
+        h = (h ^ (uint8_t)str[i]) * 16777619u;
+    }
+    return h;
+}
+
+int32_t PropTable::lookup(const char* name, size_t len, uint32_t h) const{
+    if (slots.empty()){
+        return -1;
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t i = h & mask; ; i = (i + 1) & mask){
+        int32_t idx = slots[i];
+        if (idx < 0){
+            return -1;
+        }
+        const entry& e = entries[idx];
+        if (e.hash == h && e.name_len == len && memcmp(pool.data() + e.name_off, name, len) == 0){
+            return idx;
         }
     }
-    if (prop_map.find(name) != prop_map.end()) {
-        return prop_map[name];
+}
+
+void PropTable::rehash(size_t count){
+    slots.assign(count, -1);
+    size_t mask = count - 1;
+    for (size_t idx = 0; idx < entries.size(); idx++){
+        size_t i = entries[idx].hash & mask;
+        while (slots[i] >= 0){
+            i = (i + 1) & mask;
+        }
+        slots[i] = idx;
     }
-    return "";
+}
+
+void PropTable::insert(const char* name, size_t name_len, const char* val, size_t val_len){
+    uint32_t h = hash(name, name_len);
+    int32_t idx = lookup(name, name_len, h);
+    if (idx >= 0){
+        entry& e = entries[idx];
+        e.val_off = pool.size();
+        e.val_len = val_len;
+        pool.append(val, val_len);
+        return;
+    }
+    // keep the load factor under 1/2
+    if ((entries.size() + 1) * 2 > slots.size()){
+        rehash(std::max((size_t)256, slots.size() * 2));
+    }
+    entry e;
+    e.hash = h;
+    e.name_off = pool.size();
+    e.name_len = name_len;
+    pool.append(name, name_len);
+    e.val_off = pool.size();
+    e.val_len = val_len;
+    pool.append(val, val_len);
+    size_t mask = slots.size() - 1;
+    size_t i = h & mask;
+    while (slots[i] >= 0){
+        i = (i + 1) & mask;
+    }
+    slots[i] = entries.size();
+    entries.push_back(e);
+}
+
+bool PropTable::find(const std::string& name, std::string& value) const{
+    int32_t idx = lookup(name.data(), name.size(), hash(name.data(), name.size()));
+    if (idx < 0){
+        return false;
+    }
+    value.assign(pool.data() + entries[idx].val_off, entries[idx].val_len);
+    return true;
+}
+
+void PropTable::clear(){
+    pool.clear();
+    entries.clear();
+    slots.clear();
+}
+
+void PropTable::for_each(std::function<void (const char* name, size_t name_len, const char* val, size_t val_len)> fn) const{
+    for (const auto& e : entries){
+        fn(pool.data() + e.name_off, e.name_len, pool.data() + e.val_off, e.val_len);
+    }
+}
+
+void PropInfo::load_props(){
+    if (prop_map.size() != 0){
+        return;
+    }
+    parser_prop_by_init();
+    parser_propertys();
+    // the prop areas are walked in place, in the vma data of init
+    if(task_ptr != nullptr && prop_areas.empty()){
+        task_ptr.reset();
+    }
+}
+
+std::string PropInfo::get_prop(std::string name){
+    load_props();
+    std::string value;
+    prop_map.find(name, value);
+    return value;
 }
 
 PropInfo::~PropInfo(){
@@ -55,18 +149,18 @@ std::string PropInfo::get_symbol_file(std::string name){
 
 void PropInfo::print_propertys(){
     size_t max_len = 0;
-    for (const auto& pair : prop_map) {
-        max_len = std::max(max_len,pair.first.size());
-    }
+    prop_map.for_each([&](const char*, size_t name_len, const char*, size_t) {
+        max_len = std::max(max_len, name_len);
+    });
     size_t index = 1;
-    for (const auto& pair : prop_map) {
+    prop_map.for_each([&](const char* name, size_t name_len, const char* val, size_t val_len) {
         std::ostringstream oss;
         oss << "[" << std::setw(4) << std::setfill('0') << index << "]"
-            << std::left << std::setw(max_len) << std::setfill(' ') << pair.first << " "
-            << std::left << pair.second;
+            << std::left << std::setw(max_len) << std::setfill(' ') << std::string(name, name_len) << " "
+            << std::left << std::string(val, val_len);
         fprintf(fp, "%s \n",oss.str().c_str());
         index++;
-    }
+    });
 }
 
 void PropInfo::init_datatype_info(){
@@ -274,7 +368,7 @@ void PropInfo::parser_prop_info(size_t prop_info_addr){
                 << "[" << name << "] : " << info.value;
             fprintf(fp, "%s \n",oss.str().c_str());
         }
-        prop_map[name] = info.value;
+        prop_map.insert(name.data(), name.size(), info.value, strnlen(info.value, sizeof(info.value)));
     }
 }
 
@@ -304,21 +398,84 @@ void PropInfo::parser_prop_by_init(){
         if(vma_ptr->vm_data == nullptr){
             vma_ptr->vm_data = (char*)task_ptr->read_vma_data(vma_ptr);
         }
-        if (!vma_ptr->vm_data){
+        if (!vma_ptr->vm_data || vma_ptr->vm_size < sizeof(prop_area) + sizeof(prop_bt)){
             continue;
         }
-        // if(index == 0){
-        //     prop_area pa = *reinterpret_cast<prop_area*>(vma_data);
-        //     fprintf(fp, "System Properties Magic:%#lx, Version:%#lx\n", pa.magic_, pa.version_);
-        // }
-        // index += 1;
-        prop_bt pb = *reinterpret_cast<prop_bt*>(vma_ptr->vm_data + sizeof(prop_area));
+        // kept for prefix queries, the vma data stays with task_ptr
+        prop_areas.push_back(vma_ptr);
+        prop_bt pb = *reinterpret_cast<const prop_bt*>(vma_ptr->vm_data + sizeof(prop_area));
         if(pb.children != 0){
             for_each_prop(pb.children, vma_ptr->vm_size, vma_ptr->vm_data);
         }
     }
 }
 
+/*
+ * Visit every prop_bt under prop_bt_off without recursion, fn gets the
+ * prop offset of each node which holds a property. Offsets are relative to
+ * prop_area::data_, anything out of the area stops that branch.
+ */
+static bool walk_prop_trie(const char* data, size_t len, uint32_t prop_bt_off, std::function<void (uint32_t prop)> fn){
+    std::vector<uint32_t> stack = {prop_bt_off};
+    size_t max_nodes = len / sizeof(prop_bt);
+    size_t visited = 0;
+    bool valid = true;
+    while (!stack.empty()){
+        uint32_t off = stack.back();
+        stack.pop_back();
+        if (sizeof(prop_area) + (size_t)off + sizeof(prop_bt) > len || ++visited > max_nodes){
+            valid = false;
+            continue;
+        }
+        const prop_bt* pb = reinterpret_cast<const prop_bt*>(data + sizeof(prop_area) + off);
+        // depth first, a node comes before its left, children and right
+        // subtrees, which is not the sorted order of the names
+        if (pb->right != 0) stack.push_back(pb->right);
+        if (pb->children != 0) stack.push_back(pb->children);
+        if (pb->prop != 0) fn(pb->prop);
+        if (pb->left != 0) stack.push_back(pb->left);
+    }
+    return valid;
+}
+
+/* cut at the first NUL and trim the white spaces, in place on the area data */
+static void trim_prop_str(const char*& str, size_t& len){
+    len = strnlen(str, len);
+    while (len > 0 && std::isspace((unsigned char)str[0])){
+        str++;
+        len--;
+    }
+    while (len > 0 && std::isspace((unsigned char)str[len - 1])){
+        len--;
+    }
+}
+
+void PropInfo::add_prop(const char* data, size_t data_len, uint32_t prop){
+    size_t info_off = sizeof(prop_area) + (size_t)prop;
+    if (info_off + sizeof(prop_info) >= data_len){
+        return;
+    }
+    const char* value = data + info_off + 0x4/* serial*/;
+    size_t value_len = 92/*PROP_VALUE_MAX*/;
+    /*
+    see PROP_NAME_MAX in system_properties.h
+    Deprecated: there's no limit on the length of a property name since
+    API level 26, though the limit on property values (PROP_VALUE_MAX) remains.
+    */
+    const char* name = data + info_off + sizeof(prop_info);
+    size_t name_len = data_len - (info_off + sizeof(prop_info));
+    trim_prop_str(value, value_len);
+    trim_prop_str(name, name_len);
+    /*
+    remove the case as below
+    =
+    ro.boot.memcg=
+    */
+    if (value_len > 0 && name_len > 0) {
+        prop_map.insert(name, name_len, value, value_len);
+    }
+}
+
 /*
                                                   |<----------- prop3      ---------------------------------------------------------------------------------------------->|
                                                   |<----------- children2  ----------------------------------------------------->|                                        |
@@ -329,65 +486,137 @@ void PropInfo::parser_prop_by_init(){
 |<-----------        prop_area        ----------->|<----------- prop_bt   ---------->|     |<----------- prop_bt   ---------->|  |<----------- prop_bt   ---------->|     |<-------   prop_info   ------>|
 |<-----------------------------------------------------------------------------          init vma         ---------------------------------------------------------------------------------------------->|
 */
-bool PropInfo::for_each_prop(uint32_t prop_bt_off, size_t vma_len, char* vma_data){
-    if(sizeof(prop_area) + prop_bt_off + sizeof(prop_bt) > vma_len)
-        return false;
-    prop_bt pb = *reinterpret_cast<prop_bt*>(vma_data + sizeof(prop_area) + prop_bt_off);
-    uint prop = pb.prop;
-    uint left = pb.left;
-    uint right = pb.right;
-    uint children = pb.children;
-    if (left != 0 && !for_each_prop(left, vma_len, vma_data)){
-        return false;
-    }
-    if(prop != 0 && (sizeof(prop_area) + prop + 92/*PROP_VALUE_MAX*/) < vma_len){
-        std::string value = std::string(vma_data + sizeof(prop_area) + prop + 0x4/* serial*/, 92/*PROP_VALUE_MAX*/);
-        /*
-        see PROP_NAME_MAX in system_properties.h
-        Deprecated: there's no limit on the length of a property name since
-        API level 26, though the limit on property values (PROP_VALUE_MAX) remains.
-        */
-        std::string name = std::string(vma_data + sizeof(prop_area) + prop + sizeof(prop_info), 100);
-        /*
-        remove the case as below
-        =
-        ro.boot.memcg=
-        */
-        auto cleanedValue = cleanString(value);
-        auto cleanedName = cleanString(name);
-        if (!cleanedValue.empty() && !cleanedName.empty()) {
-            // fprintf(fp, "%s=%s\n", cleanedName->c_str(), cleanedValue->c_str());
-            prop_map[cleanedName] = cleanedValue;
+bool PropInfo::for_each_prop(uint32_t prop_bt_off, size_t vma_len, const char* vma_data){
+    return walk_prop_trie(vma_data, vma_len, prop_bt_off, [&](uint32_t prop) {
+        add_prop(vma_data, vma_len, prop);
+    });
+}
+
+/*
+ * Find the child of prop_bt_off named name, the children of a node are a
+ * binary tree ordered by name length first, then by name, as in bionic.
+ */
+uint32_t PropInfo::find_prop_bt(const char* area_data, size_t area_len, uint32_t prop_bt_off, const char* name, size_t len){
+    size_t base = sizeof(prop_area);
+    if (base + (size_t)prop_bt_off + sizeof(prop_bt) > area_len){
+        return 0;
+    }
+    uint32_t off = reinterpret_cast<const prop_bt*>(area_data + base + prop_bt_off)->children;
+    size_t max_nodes = area_len / sizeof(prop_bt);
+    for (size_t i = 0; off != 0 && i < max_nodes; i++){
+        if (base + (size_t)off + sizeof(prop_bt) > area_len){
+            return 0;
         }
+        const prop_bt* pb = reinterpret_cast<const prop_bt*>(area_data + base + off);
+        if (base + (size_t)off + sizeof(prop_bt) + pb->namelen > area_len){
+            return 0;
+        }
+        int cmp = (len < pb->namelen) ? -1 : (len > pb->namelen) ? 1 : memcmp(name, pb->name, len);
+        if (cmp == 0){
+            return off;
+        }
+        off = (cmp < 0) ? pb->left : pb->right;
     }
-    if (children != 0 && !for_each_prop(children, vma_len, vma_data)){
-        return false;
-    }
-    if (right != 0 && !for_each_prop(right, vma_len, vma_data)){
-        return false;
-    }
-    return true;
+    return 0;
 }
 
-std::string PropInfo::cleanString(const std::string& str) {
-    std::string tempStr = str;
-    tempStr.erase(std::find(tempStr.begin(), tempStr.end(), '\0'), tempStr.end());
-
-    tempStr.erase(0, tempStr.find_first_not_of(" \t\n\r\f\v"));
-    tempStr.erase(tempStr.find_last_not_of(" \t\n\r\f\v") + 1);
-
-    bool hasValidChar = false;
-    for (char c : tempStr) {
-        if (c != '\0' && !std::isspace(c)) {
-            hasValidChar = true;
-            break;
+/*
+ * Walk the trie down the complete segments of prefix, then take every
+ * node of that level which starts with the last, partial, segment along
+ * with all the properties below it.
+ */
+void PropInfo::get_props_by_prefix(const std::string& prefix, std::vector<std::pair<std::string, std::string>>& res){
+    std::set<std::string> names;
+    size_t last_dot = prefix.find_last_of('.');
+    std::string partial = (last_dot == std::string::npos) ? prefix : prefix.substr(last_dot + 1);
+    for (const auto& vma_ptr : prop_areas) {
+        const char* area_data = vma_ptr->vm_data;
+        size_t area_len = vma_ptr->vm_size;
+        uint32_t cur = 0;   // the root prop_bt
+        bool found = true;
+        size_t pos = 0;
+        while (last_dot != std::string::npos && pos <= last_dot){
+            size_t dot = prefix.find('.', pos);
+            cur = find_prop_bt(area_data, area_len, cur, prefix.data() + pos, dot - pos);
+            if (cur == 0){
+                found = false;
+                break;
+            }
+            pos = dot + 1;
+        }
+        if (!found){
+            continue;
+        }
+        if (sizeof(prop_area) + (size_t)cur + sizeof(prop_bt) > area_len){
+            continue;
+        }
+        uint32_t level = reinterpret_cast<const prop_bt*>(area_data + sizeof(prop_area) + cur)->children;
+        std::vector<uint32_t> stack;
+        if (level != 0) stack.push_back(level);
+        size_t max_nodes = area_len / sizeof(prop_bt);
+        for (size_t i = 0; !stack.empty() && i < max_nodes; i++){
+            uint32_t off = stack.back();
+            stack.pop_back();
+            if (sizeof(prop_area) + (size_t)off + sizeof(prop_bt) > area_len){
+                continue;
+            }
+            const prop_bt* pb = reinterpret_cast<const prop_bt*>(area_data + sizeof(prop_area) + off);
+            if (pb->left != 0) stack.push_back(pb->left);
+            if (pb->right != 0) stack.push_back(pb->right);
+            if (pb->namelen < partial.size() || sizeof(prop_area) + (size_t)off + sizeof(prop_bt) + pb->namelen > area_len
+                || memcmp(pb->name, partial.data(), partial.size()) != 0){
+                continue;
+            }
+            auto collect = [&](uint32_t prop) {
+                size_t name_off = sizeof(prop_area) + (size_t)prop + sizeof(prop_info);
+                if (name_off >= area_len){
+                    return;
+                }
+                const char* name = area_data + name_off;
+                size_t name_len = area_len - name_off;
+                trim_prop_str(name, name_len);
+                std::string prop_name(name, name_len);
+                if (prop_name.compare(0, prefix.size(), prefix) == 0){
+                    names.insert(prop_name);
+                }
+            };
+            if (pb->prop != 0) collect(pb->prop);
+            if (pb->children != 0) walk_prop_trie(area_data, area_len, pb->children, collect);
+        }
+    }
+    // without the areas of init, only the table read through libc is left
+    if (prop_areas.empty()){
+        prop_map.for_each([&](const char* name, size_t name_len, const char*, size_t) {
+            if (name_len >= prefix.size() && memcmp(name, prefix.data(), prefix.size()) == 0){
+                names.emplace(name, name_len);
+            }
+        });
+    }
+    for (const auto& name : names) {
+        std::string value;
+        if (prop_map.find(name, value)){
+            res.push_back(std::make_pair(name, value));
         }
     }
+}
 
-    if (!hasValidChar) {
-        return "";
+void PropInfo::print_props_by_prefix(const std::string& prefix){
+    load_props();
+    std::vector<std::pair<std::string, std::string>> props;
+    get_props_by_prefix(prefix, props);
+    size_t max_len = 0;
+    for (const auto& pair : props) {
+        max_len = std::max(max_len, pair.first.size());
+    }
+    size_t index = 1;
+    for (const auto& pair : props) {
+        std::ostringstream oss;
+        oss << "[" << std::setw(4) << std::setfill('0') << index << "]"
+            << std::left << std::setw(max_len) << std::setfill(' ') << pair.first << " "
+            << std::left << pair.second;
+        fprintf(fp, "%s \n",oss.str().c_str());
+        index++;
     }
-    return tempStr;
 }
 
 #pragma GCC diagnostic pop
@@ -55,6 +55,36 @@ struct symbol {
     std::string path;
 };
 
+/*
+ * Open addressing (linear probing) table of name -> value. Names and
+ * values are kept back to back in one string pool, entries refer to them
+ * by offset and stay in insertion order for printing.
+ */
+class PropTable {
+private:
+    struct entry {
+        uint32_t hash;
+        uint32_t name_off;
+        uint32_t name_len;
+        uint32_t val_off;
+        uint32_t val_len;
+    };
+    std::string pool;
+    std::vector<entry> entries;
+    std::vector<int32_t> slots;     /* index in entries, -1 is empty */
+
+    static uint32_t hash(const char* str, size_t len);
+    int32_t lookup(const char* name, size_t len, uint32_t hash) const;
+    void rehash(size_t count);
+
+public:
+    void insert(const char* name, size_t name_len, const char* val, size_t val_len);
+    bool find(const std::string& name, std::string& value) const;
+    size_t size() const { return entries.size(); }
+    void clear();
+    void for_each(std::function<void (const char* name, size_t name_len, const char* val, size_t val_len)> fn) const;
+};
+
 struct offset_list {
     int SystemProperties_contexts_;
     int ContextsSerialized_context_nodes_;
@@ -79,7 +109,8 @@ protected:
     std::shared_ptr<UTask> task_ptr;
 
 public:
-    std::unordered_map<std::string, std::string> prop_map; //<name, val>
+    PropTable prop_map; //<name, val>
+    std::vector<std::shared_ptr<vma_struct>> prop_areas; /* property files mapped by init, vm_data is owned by task_ptr */
     std::vector<symbol> symbol_list = {
         {"libc.so", ""},
     };
@@ -99,8 +130,12 @@ public:
     void parser_prop_bt(size_t root, size_t prop_bt_addr);
     void parser_prop_info(size_t prop_info_addr);
     void parser_prop_by_init();
-    bool for_each_prop(uint32_t prop_bt_off, size_t vma_len, char *vma_data);
-    std::string cleanString(const std::string &str);
+    bool for_each_prop(uint32_t prop_bt_off, size_t vma_len, const char *vma_data);
+    void add_prop(const char* data, size_t data_len, uint32_t prop);
+    uint32_t find_prop_bt(const char* area_data, size_t area_len, uint32_t prop_bt_off, const char* name, size_t len);
+    void get_props_by_prefix(const std::string& prefix, std::vector<std::pair<std::string, std::string>>& res);
+    void print_props_by_prefix(const std::string& prefix);
+    void load_props();
     void cmd_main(void) override;
     std::string get_prop(std::string name);
 };
@@ -15,6 +15,7 @@
 
 #include "pstore.h"
 #include "logcat/logcat.h"
+#include <climits>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -27,7 +28,7 @@ void Pstore::cmd_main(void) {
     int c;
     std::string cppString;
     if (argcnt < 2) cmd_usage(pc->curcmd, SYNOPSIS);
-    while ((c = getopt(argcnt, args, "pcfo")) != EOF) {
+    while ((c = getopt(argcnt, args, "pcfoi")) != EOF) {
         switch(c) {
             case 'p':
                 print_pmsg();
@@ -41,6 +42,9 @@ void Pstore::cmd_main(void) {
             case 'o':
                 print_oops_log();
                 break;
+            case 'i':
+                print_zone_info();
+                break;
             default:
                 argerrs++;
                 break;
@@ -62,12 +66,28 @@ Pstore::Pstore(){
     field_init(ramoops_context,console_size);
     field_init(ramoops_context,ftrace_size);
     field_init(ramoops_context,pmsg_size);
+    field_init(ramoops_context,max_dump_cnt);
+    field_init(ramoops_context,max_ftrace_cnt);
     struct_init(ramoops_context);
     field_init(persistent_ram_zone,paddr);
     field_init(persistent_ram_zone,size);
     field_init(persistent_ram_zone,buffer);
+    field_init(persistent_ram_zone,buffer_size);
+    field_init(persistent_ram_zone,ecc_info);
+    struct_init(persistent_ram_zone);
+    field_init(persistent_ram_ecc_info,block_size);
+    field_init(persistent_ram_ecc_info,ecc_size);
+    field_init(persistent_ram_ecc_info,symsize);
+    field_init(persistent_ram_ecc_info,poly);
+    field_init(persistent_ram_buffer,sig);
     field_init(persistent_ram_buffer,start);
     field_init(persistent_ram_buffer,size);
+    struct_init(persistent_ram_buffer);
+    field_init(pstore_ftrace_record,ip);
+    field_init(pstore_ftrace_record,parent_ip);
+    field_init(pstore_ftrace_record,ts);
+    field_init(pstore_ftrace_record,cpu);
+    struct_init(pstore_ftrace_record);
     cmd_name = "pstore";
     help_str_list={
         "pstore",                            /* command name */
@@ -76,6 +96,7 @@ Pstore::Pstore(){
             "  pstore -c\n"
             "  pstore -f\n"
             "  pstore -o\n"
+            "  pstore -i\n"
             "  This command dumps the pstore log info.",
         "\n",
         "EXAMPLES",
@@ -90,243 +111,644 @@ Pstore::Pstore(){
         "\n",
         "  Display ftrace log:",
         "    %s> pstore -f",
+        "       CPU:0 ts:4827136512 ffffffd0081a2b3c  ffffffd0081a2f00  rcu_note_context_switch <- __schedule+0xd4",
         "\n",
         "  Display Oops dump log:",
         "    %s> pstore -o",
         "\n",
+        "  Display the ramoops zones:",
+        "    %s> pstore -i",
+        "       persistent_ram_zone Name           paddr        size     start    used     ecc      corrected bad",
+        "       ffffff8003a1c000    dmesg-0        0xb0000000   256KB    0        12.42KB  128/16   0         0",
+        "       ffffff8003a1c100    console        0xb0040000   1MB      51234    1023.94KB 128/16  2         0",
+        "\n",
     };
     initialize();
 }
 
-void Pstore::print_ftrace_log(){
+/*
+ * Read every zone of oops_cxt once and keep it for the session, each zone
+ * with a single physical read of its whole region.
+ */
+bool Pstore::load_zones(){
+    if (zones_loaded){
+        return true;
+    }
     if (!csymbol_exists("oops_cxt")){
         fprintf(fp, "oops_cxt doesn't exist in this kernel!\n");
-        return;
+        return false;
     }
     ulong cxt_addr = csymbol_value("oops_cxt");
     if (!is_kvaddr(cxt_addr)) {
         fprintf(fp, "oops_cxt address is invalid!\n");
-        return;
+        return false;
     }
-    size_t ftrace_size = read_ulong(cxt_addr + field_offset(ramoops_context,ftrace_size),"ftrace_size");
-    if (ftrace_size == 0){
-        fprintf(fp, "ftrace_size is 0!\n");
-        return;
+    void *cxt_buf = read_struct(cxt_addr,"ramoops_context");
+    if (!cxt_buf) {
+        return false;
     }
-    ulong fprzs_addr = read_pointer(cxt_addr + field_offset(ramoops_context,cprz),"fprzs");
-    if (!is_kvaddr(fprzs_addr)) {
-        fprintf(fp, "fprzs address is invalid!\n");
-        return;
+    zones_loaded = true;
+    auto read_zone_array = [&](int arr_off, int cnt_off, const std::string& name) {
+        std::vector<std::shared_ptr<pstore_zone>> zones;
+        ulong arr_addr = ULONG(cxt_buf + arr_off);
+        if (!is_kvaddr(arr_addr)) {
+            return zones;
+        }
+        size_t cnt = (cnt_off == -1) ? 1 : UINT(cxt_buf + cnt_off);
+        cnt = std::min<size_t>(cnt, PSTORE_MAX_ZONES);
+        if (cnt == 0) {
+            return zones;
+        }
+        std::vector<ulong> przs(cnt);
+        if (!read_struct(arr_addr, przs.data(), cnt * sizeof(ulong), "persistent_ram_zone *")) {
+            return zones;
+        }
+        for (size_t i = 0; i < cnt; i++) {
+            std::shared_ptr<pstore_zone> zone = read_zone(przs[i], name + "-" + std::to_string(i));
+            if (zone) {
+                zones.push_back(zone);
+            }
+        }
+        return zones;
+    };
+    if (ULONG(cxt_buf + field_offset(ramoops_context,record_size))){
+        dmesg_zones = read_zone_array(field_offset(ramoops_context,dprzs), field_offset(ramoops_context,max_dump_cnt), "dmesg");
     }
-    ulong zone_paddr = read_ulong(fprzs_addr + field_offset(persistent_ram_zone,paddr),"paddr");
-    // ulong zone_size = read_ulong(fprzs_addr + field_offset(persistent_ram_zone,size),"size");
-    ulong buffer_addr = read_pointer(fprzs_addr + field_offset(persistent_ram_zone,buffer),"buffer");
-    if (!is_kvaddr(buffer_addr)) {
-        fprintf(fp, "buffer address is invalid!\n");
-        return;
+    if (ULONG(cxt_buf + field_offset(ramoops_context,ftrace_size))){
+        ftrace_zones = read_zone_array(field_offset(ramoops_context,fprzs), field_offset(ramoops_context,max_ftrace_cnt), "ftrace");
+    }
+    if (ULONG(cxt_buf + field_offset(ramoops_context,console_size))){
+        console_zone = read_zone(ULONG(cxt_buf + field_offset(ramoops_context,cprz)), "console");
     }
-    fprintf(fp, "log addr:%#lx size:%zu\n",zone_paddr,ftrace_size);
+    if (ULONG(cxt_buf + field_offset(ramoops_context,pmsg_size))){
+        pmsg_zone = read_zone(ULONG(cxt_buf + field_offset(ramoops_context,mprz)), "pmsg");
+    }
+    FREEBUF(cxt_buf);
+    return true;
 }
 
-void Pstore::print_oops_log(){
-    if (!csymbol_exists("oops_cxt")){
-        fprintf(fp, "oops_cxt doesn't exist in this kernel!\n");
-        return;
+std::shared_ptr<pstore_zone> Pstore::read_zone(ulong prz_addr, const std::string& name){
+    if (!is_kvaddr(prz_addr)) {
+        return nullptr;
     }
-    ulong cxt_addr = csymbol_value("oops_cxt");
-    if (!is_kvaddr(cxt_addr)) {
-        fprintf(fp, "oops_cxt address is invalid!\n");
+    void *prz_buf = read_struct(prz_addr,"persistent_ram_zone");
+    if (!prz_buf) {
+        return nullptr;
+    }
+    auto zone = std::make_shared<pstore_zone>();
+    zone->name = name;
+    zone->addr = prz_addr;
+    zone->paddr = ULONG(prz_buf + field_offset(persistent_ram_zone,paddr));
+    zone->size = ULONG(prz_buf + field_offset(persistent_ram_zone,size));
+    zone->buffer_size = ULONG(prz_buf + field_offset(persistent_ram_zone,buffer_size));
+    zone->ecc_block_size = 0;
+    zone->ecc_size = 0;
+    zone->ecc_symsize = 0;
+    zone->ecc_poly = 0;
+    int ecc_off = field_offset(persistent_ram_zone,ecc_info);
+    if (ecc_off != -1) {
+        zone->ecc_block_size = INT(prz_buf + ecc_off + field_offset(persistent_ram_ecc_info,block_size));
+        zone->ecc_size = INT(prz_buf + ecc_off + field_offset(persistent_ram_ecc_info,ecc_size));
+        zone->ecc_symsize = INT(prz_buf + ecc_off + field_offset(persistent_ram_ecc_info,symsize));
+        zone->ecc_poly = INT(prz_buf + ecc_off + field_offset(persistent_ram_ecc_info,poly));
+    }
+    FREEBUF(prz_buf);
+    zone->sig = 0;
+    zone->start = 0;
+    zone->used = 0;
+    zone->corrected_bytes = 0;
+    zone->bad_blocks = 0;
+    zone->seg[0] = zone->seg[1] = nullptr;
+    zone->seg_len[0] = zone->seg_len[1] = 0;
+    size_t hdr_size = struct_size(persistent_ram_buffer);
+    if (zone->size <= hdr_size || zone->size > INT_MAX || zone->buffer_size > zone->size - hdr_size) {
+        fprintf(fp, "%s: invalid zone size %zu buffer_size %zu\n", name.c_str(), zone->size, zone->buffer_size);
+        return zone;
+    }
+    zone->mem.resize(zone->size);
+    if (!read_struct(zone->paddr, zone->mem.data(), zone->size, "persistent_ram_zone data", false)) {
+        fprintf(fp, "%s: read %#lx size %zu failed\n", name.c_str(), zone->paddr, zone->size);
+        std::vector<char>().swap(zone->mem);
+        return zone;
+    }
+    if (zone->ecc_size > 0) {
+        correct_zone(*zone);
+    }
+    const char* hdr = zone->mem.data();
+    zone->sig = UINT(hdr + field_offset(persistent_ram_buffer,sig));
+    zone->start = UINT(hdr + field_offset(persistent_ram_buffer,start));
+    zone->used = UINT(hdr + field_offset(persistent_ram_buffer,size));
+    if (zone->used > zone->buffer_size || zone->start > zone->used) {
+        fprintf(fp, "%s: invalid start %zu size %zu of %zu\n", name.c_str(), zone->start, zone->used, zone->buffer_size);
+        zone->start = zone->used = 0;
+        return zone;
+    }
+    const char* data = hdr + hdr_size;
+    zone->seg[0] = data + zone->start;
+    zone->seg_len[0] = zone->used - zone->start;
+    zone->seg[1] = data;
+    zone->seg_len[1] = zone->start;
+    return zone;
+}
+
+bool Pstore::init_rs(rs_codec& rs, int symsize, int gfpoly, int fcr, int prim, int nroots){
+    if (symsize <= 0 || symsize > 8) {
+        return false;
+    }
+    rs.symsize = symsize;
+    rs.nn = (1 << symsize) - 1;
+    if (fcr < 0 || fcr > rs.nn || prim <= 0 || prim > rs.nn || nroots <= 0 || nroots > rs.nn) {
+        return false;
+    }
+    rs.fcr = fcr;
+    rs.prim = prim;
+    rs.nroots = nroots;
+    rs.alpha_to.assign(rs.nn + 1, 0);
+    rs.index_of.assign(rs.nn + 1, 0);
+    rs.index_of[0] = rs.nn;
+    rs.alpha_to[rs.nn] = 0;
+    int sr = 1;
+    for (int i = 0; i < rs.nn; i++) {
+        rs.index_of[sr] = i;
+        rs.alpha_to[i] = sr;
+        sr <<= 1;
+        if (sr & (1 << symsize)) {
+            sr ^= gfpoly;
+        }
+        sr &= rs.nn;
+    }
+    if (sr != 1) {
+        return false; // gfpoly is not primitive
+    }
+    int iprim = 1;
+    while ((iprim % prim) != 0) {
+        iprim += rs.nn;
+    }
+    rs.iprim = iprim / prim;
+    return true;
+}
+
+/*
+ * decode_rs8() of lib/reed_solomon: Berlekamp-Massey, Chien search and
+ * Forney on the shortened code data[len] + par[nroots], corrected in place.
+ * Returns the number of corrected symbols, or -1 if it is uncorrectable.
+ */
+int Pstore::decode_rs8(const rs_codec& rs, uint8_t* data, size_t len, uint8_t* par){
+    const int nn = rs.nn;
+    const int nroots = rs.nroots;
+    const int* alpha_to = rs.alpha_to.data();
+    const int* index_of = rs.index_of.data();
+    int pad = nn - nroots - static_cast<int>(len);
+    if (len == 0 || pad < 0) {
+        return -1;
+    }
+    auto modnn = [nn](int x) { return x % nn; };
+    int s[256], lambda[256], b[256], t[256], omega[256], reg[256], root[256], loc[256];
+    /* syndromes */
+    for (int i = 0; i < nroots; i++) {
+        s[i] = data[0] & nn;
+    }
+    for (size_t j = 1; j < len + nroots; j++) {
+        int sym = (j < len ? data[j] : par[j - len]) & nn;
+        for (int i = 0; i < nroots; i++) {
+            s[i] = (s[i] == 0) ? sym : sym ^ alpha_to[modnn(index_of[s[i]] + (rs.fcr + i) * rs.prim)];
+        }
+    }
+    int syn_error = 0;
+    for (int i = 0; i < nroots; i++) {
+        syn_error |= s[i];
+        s[i] = index_of[s[i]];
+    }
+    if (!syn_error) {
+        return 0;
+    }
+    /* Berlekamp-Massey */
+    memset(lambda, 0, sizeof(int) * (nroots + 1));
+    lambda[0] = 1;
+    for (int i = 0; i <= nroots; i++) {
+        b[i] = index_of[lambda[i]];
+    }
+    int el = 0;
+    for (int r = 1; r <= nroots; r++) {
+        int discr_r = 0;
+        for (int i = 0; i < r; i++) {
+            if (lambda[i] != 0 && s[r - i - 1] != nn) {
+                discr_r ^= alpha_to[modnn(index_of[lambda[i]] + s[r - i - 1])];
+            }
+        }
+        discr_r = index_of[discr_r];
+        if (discr_r == nn) {
+            memmove(&b[1], b, nroots * sizeof(int));
+            b[0] = nn;
+            continue;
+        }
+        t[0] = lambda[0];
+        for (int i = 0; i < nroots; i++) {
+            t[i + 1] = (b[i] != nn) ? lambda[i + 1] ^ alpha_to[modnn(discr_r + b[i])] : lambda[i + 1];
+        }
+        if (2 * el <= r - 1) {
+            el = r - el;
+            for (int i = 0; i <= nroots; i++) {
+                b[i] = (lambda[i] == 0) ? nn : modnn(index_of[lambda[i]] - discr_r + nn);
+            }
+        } else {
+            memmove(&b[1], b, nroots * sizeof(int));
+            b[0] = nn;
+        }
+        memcpy(lambda, t, (nroots + 1) * sizeof(int));
+    }
+    int deg_lambda = 0;
+    for (int i = 0; i <= nroots; i++) {
+        lambda[i] = index_of[lambda[i]];
+        if (lambda[i] != nn) {
+            deg_lambda = i;
+        }
+    }
+    if (deg_lambda == 0) {
+        return -1;
+    }
+    /* Chien search for the roots of lambda */
+    memcpy(&reg[1], &lambda[1], nroots * sizeof(int));
+    int count = 0;
+    for (int i = 1, k = rs.iprim - 1; i <= nn; i++, k = modnn(k + rs.iprim)) {
+        int q = 1;
+        for (int j = deg_lambda; j > 0; j--) {
+            if (reg[j] != nn) {
+                reg[j] = modnn(reg[j] + j);
+                q ^= alpha_to[reg[j]];
+            }
+        }
+        if (q != 0) {
+            continue;
+        }
+        if (k < pad) {
+            return -1; // error in the padding
+        }
+        root[count] = i;
+        loc[count] = k;
+        if (++count == deg_lambda) {
+            break;
+        }
+    }
+    if (deg_lambda != count) {
+        return -1;
+    }
+    /* omega(x) = s(x) * lambda(x) mod x^nroots */
+    int deg_omega = deg_lambda - 1;
+    for (int i = 0; i <= deg_omega; i++) {
+        int tmp = 0;
+        for (int j = i; j >= 0; j--) {
+            if (s[i - j] != nn && lambda[j] != nn) {
+                tmp ^= alpha_to[modnn(s[i - j] + lambda[j])];
+            }
+        }
+        omega[i] = index_of[tmp];
+    }
+    /* Forney */
+    for (int j = count - 1; j >= 0; j--) {
+        int num1 = 0;
+        for (int i = deg_omega; i >= 0; i--) {
+            if (omega[i] != nn) {
+                num1 ^= alpha_to[modnn(omega[i] + i * root[j])];
+            }
+        }
+        if (num1 == 0) {
+            continue;
+        }
+        int num2 = alpha_to[modnn(root[j] * (rs.fcr - 1) + nn)];
+        int den = 0;
+        for (int i = std::min(deg_lambda, nroots - 1) & ~1; i >= 0; i -= 2) {
+            if (lambda[i + 1] != nn) {
+                den ^= alpha_to[modnn(lambda[i + 1] + i * root[j])];
+            }
+        }
+        if (den == 0) {
+            return -1;
+        }
+        int cor = alpha_to[modnn(index_of[num1] + index_of[num2] + nn - index_of[den])];
+        size_t pos = loc[j] - pad;
+        if (pos < len) {
+            data[pos] ^= cor;
+        } else {
+            par[pos - len] ^= cor;
+        }
+    }
+    return count;
+}
+
+/*
+ * Same layout as persistent_ram_init_ecc(): the parity of every data block
+ * follows the data area, then the parity of the persistent_ram_buffer
+ * header. The header is corrected first as start/size depend on it.
+ */
+void Pstore::correct_zone(pstore_zone& zone){
+    rs_codec rs;
+    if (zone.ecc_block_size <= 0 || !init_rs(rs, zone.ecc_symsize, zone.ecc_poly, 0, 1, zone.ecc_size)) {
+        fprintf(fp, "%s: unsupported ecc block_size:%d ecc_size:%d symsize:%d poly:%#x\n", zone.name.c_str(),
+            zone.ecc_block_size, zone.ecc_size, zone.ecc_symsize, zone.ecc_poly);
         return;
     }
-    size_t record_size = read_ulong(cxt_addr + field_offset(ramoops_context,record_size),"record_size");
-    if (record_size == 0){
-        fprintf(fp, "record_size is 0!\n");
+    size_t hdr_size = struct_size(persistent_ram_buffer);
+    size_t block_size = zone.ecc_block_size;
+    size_t ecc_size = zone.ecc_size;
+    size_t total = zone.size - hdr_size;
+    if (total <= ecc_size) {
         return;
     }
-    ulong dprzs_addr = read_pointer(cxt_addr + field_offset(ramoops_context,dprzs),"dprzs");
-    if (!is_kvaddr(dprzs_addr)) {
-        fprintf(fp, "dprzs address is invalid!\n");
+    size_t ecc_blocks = (total - ecc_size + block_size + ecc_size - 1) / (block_size + ecc_size);
+    uint8_t* hdr = reinterpret_cast<uint8_t*>(zone.mem.data());
+    uint8_t* data = hdr + hdr_size;
+    uint8_t* par = data + zone.buffer_size;
+    uint8_t* par_header = par + ecc_blocks * ecc_size;
+    if (par_header + ecc_size > hdr + zone.mem.size()) {
         return;
     }
-    ulong zone_paddr = read_ulong(dprzs_addr + field_offset(persistent_ram_zone,paddr),"paddr");
-    // ulong zone_size = read_ulong(dprzs_addr + field_offset(persistent_ram_zone,size),"size");
-    ulong buffer_addr = read_pointer(dprzs_addr + field_offset(persistent_ram_zone,buffer),"buffer");
-    if (!is_kvaddr(buffer_addr)) {
-        fprintf(fp, "buffer address is invalid!\n");
+    int numerr = decode_rs8(rs, hdr, hdr_size, par_header);
+    if (numerr > 0) {
+        zone.corrected_bytes += numerr;
+    } else if (numerr < 0) {
+        zone.bad_blocks++;
+    }
+    // like persistent_ram_ecc_old, only the blocks holding used data are
+    // decoded, each one whole as persistent_ram_update_ecc encoded it
+    size_t used = UINT(hdr + field_offset(persistent_ram_buffer,size));
+    if (used > zone.buffer_size) {
         return;
     }
-    fprintf(fp, "log addr:%#lx size:%zu\n",zone_paddr,record_size);
+    for (size_t off = 0, i = 0; off < used && i < ecc_blocks; off += block_size, i++) {
+        numerr = decode_rs8(rs, data + off, std::min(block_size, zone.buffer_size - off), par + i * ecc_size);
+        if (numerr > 0) {
+            zone.corrected_bytes += numerr;
+        } else if (numerr < 0) {
+            zone.bad_blocks++;
+        }
+    }
 }
 
-void Pstore::print_console_log(){
-    if (!csymbol_exists("oops_cxt")){
-        fprintf(fp, "oops_cxt doesn't exist in this kernel!\n");
-        return;
+size_t Pstore::zone_length(const pstore_zone& zone){
+    return zone.seg_len[0] + zone.seg_len[1];
+}
+
+/*
+ * Pointer to [off, off + len) of the log. Only a range across the wrap
+ * point is copied, into scratch.
+ */
+const char* Pstore::zone_data(const pstore_zone& zone, size_t off, size_t len, std::vector<char>& scratch){
+    if (off + len <= zone.seg_len[0]) {
+        return zone.seg[0] + off;
     }
-    ulong cxt_addr = csymbol_value("oops_cxt");
-    if (!is_kvaddr(cxt_addr)) {
-        fprintf(fp, "oops_cxt address is invalid!\n");
+    if (off >= zone.seg_len[0]) {
+        return zone.seg[1] + (off - zone.seg_len[0]);
+    }
+    size_t first = zone.seg_len[0] - off;
+    scratch.resize(len);
+    memcpy(scratch.data(), zone.seg[0] + off, first);
+    memcpy(scratch.data() + first, zone.seg[1], len - first);
+    return scratch.data();
+}
+
+void Pstore::write_zone(const pstore_zone& zone){
+    for (int i = 0; i < 2; i++) {
+        if (zone.seg_len[i]) {
+            fwrite(zone.seg[i], 1, zone.seg_len[i], fp);
+        }
+    }
+}
+
+void Pstore::print_zone_info(){
+    if (!load_zones()) {
         return;
     }
-    size_t console_size = read_ulong(cxt_addr + field_offset(ramoops_context,console_size),"console_size");
-    if (console_size == 0){
-        fprintf(fp, "console_size is 0!\n");
+    std::vector<std::shared_ptr<pstore_zone>> zones(dmesg_zones);
+    if (console_zone) zones.push_back(console_zone);
+    zones.insert(zones.end(), ftrace_zones.begin(), ftrace_zones.end());
+    if (pmsg_zone) zones.push_back(pmsg_zone);
+    fprintf(fp, "persistent_ram_zone Name           paddr        size     start    used     ecc      corrected bad\n");
+    for (const auto& zone : zones) {
+        std::ostringstream ecc;
+        if (zone->ecc_size > 0) {
+            ecc << zone->ecc_block_size << "/" << zone->ecc_size;
+        } else {
+            ecc << "-";
+        }
+        fprintf(fp, "%-19lx %-14s %#-12lx %-8s %-8zu %-8s %-8s %-9d %d\n",
+            zone->addr, zone->name.c_str(), zone->paddr, csize(zone->size).c_str(), zone->start,
+            csize(zone->used).c_str(), ecc.str().c_str(), zone->corrected_bytes, zone->bad_blocks);
+    }
+}
+
+const std::pair<std::string, ulong>& Pstore::lookup_symbol(ulong ip){
+    auto it = sym_cache.find(ip);
+    if (it != sym_cache.end()) {
+        return it->second;
+    }
+    ulong offset = 0;
+    struct syment *sp = value_search(ip, &offset);
+    std::pair<std::string, ulong> sym;
+    if (sp) {
+        sym = std::make_pair(std::string(sp->name), offset);
+    } else {
+        std::ostringstream oss;
+        oss << std::hex << "0x" << ip;
+        sym = std::make_pair(oss.str(), 0);
+    }
+    return sym_cache.emplace(ip, sym).first->second;
+}
+
+/*
+ * Decode the pstore_ftrace_record of every ftrace zone in one pass; with
+ * per-cpu zones the records are merged by timestamp like the kernel does.
+ */
+void Pstore::print_ftrace_log(){
+    if (!load_zones()) {
         return;
     }
-    ulong cprz_addr = read_pointer(cxt_addr + field_offset(ramoops_context,cprz),"cprz");
-    if (!is_kvaddr(cprz_addr)) {
-        fprintf(fp, "cprz address is invalid!\n");
+    if (ftrace_zones.empty()){
+        fprintf(fp, "ftrace_size is 0!\n");
         return;
     }
-    ulong zone_paddr = read_ulong(cprz_addr + field_offset(persistent_ram_zone,paddr),"paddr");
-    // ulong zone_size = read_ulong(cprz_addr + field_offset(persistent_ram_zone,size),"size");
-    ulong buffer_addr = read_pointer(cprz_addr + field_offset(persistent_ram_zone,buffer),"buffer");
-    if (!is_kvaddr(buffer_addr)) {
-        fprintf(fp, "buffer address is invalid!\n");
+    size_t rec_size = struct_size(pstore_ftrace_record);
+    int ip_off = field_offset(pstore_ftrace_record,ip);
+    int parent_off = field_offset(pstore_ftrace_record,parent_ip);
+    int ts_off = field_offset(pstore_ftrace_record,ts);
+    int cpu_off = field_offset(pstore_ftrace_record,cpu);
+    if (rec_size <= 0 || ip_off == -1 || parent_off == -1) {
+        fprintf(fp, "pstore_ftrace_record doesn't exist in this kernel!\n");
         return;
     }
-    fprintf(fp, "log addr:%#lx size:%zu\n",zone_paddr,console_size);
+    std::vector<pstore_ftrace_rec> records;
+    std::vector<char> scratch;
+    for (const auto& zone : ftrace_zones) {
+        size_t len = zone_length(*zone);
+        records.reserve(records.size() + len / rec_size);
+        for (size_t off = 0; off + rec_size <= len; off += rec_size) {
+            const char* rec = zone_data(*zone, off, rec_size, scratch);
+            pstore_ftrace_rec item;
+            item.ip = ULONG(rec + ip_off);
+            item.parent_ip = ULONG(rec + parent_off);
+            uint64_t ts = (ts_off == -1) ? 0 : ULONGLONG(rec + ts_off);
+            if (cpu_off != -1) {
+                item.cpu = UINT(rec + cpu_off);
+                item.ts = ts;
+            } else {
+                item.cpu = ts & ((1ULL << PSTORE_TS_CPU_SHIFT) - 1);
+                item.ts = ts >> PSTORE_TS_CPU_SHIFT;
+            }
+            records.push_back(item);
+        }
+    }
+    if (ftrace_zones.size() > 1) {
+        std::stable_sort(records.begin(), records.end(), [](const pstore_ftrace_rec& a, const pstore_ftrace_rec& b) {
+            return a.ts < b.ts;
+        });
+    }
+    for (const auto& rec : records) {
+        const auto& func = lookup_symbol(rec.ip);
+        const auto& parent = lookup_symbol(rec.parent_ip);
+        fprintf(fp, "CPU:%d ts:%llu %016lx  %016lx  %s <- %s+%#lx\n", rec.cpu, (unsigned long long)rec.ts,
+            rec.ip, rec.parent_ip, func.first.c_str(), parent.first.c_str(), parent.second);
+    }
 }
 
-void Pstore::print_pmsg(){
-    if (!csymbol_exists("oops_cxt")){
-        fprintf(fp, "oops_cxt doesn't exist in this kernel!\n");
+void Pstore::print_oops_log(){
+    if (!load_zones()) {
         return;
     }
-    ulong cxt_addr = csymbol_value("oops_cxt");
-    if (!is_kvaddr(cxt_addr)) {
-        fprintf(fp, "oops_cxt address is invalid!\n");
+    if (dmesg_zones.empty()){
+        fprintf(fp, "record_size is 0!\n");
         return;
     }
-    size_t pmsg_size = read_ulong(cxt_addr + field_offset(ramoops_context,pmsg_size),"pmsg_size");
-    if (pmsg_size == 0){
-        fprintf(fp, "pmsg_size is 0!\n");
-        return;
+    std::vector<char> scratch;
+    for (const auto& zone : dmesg_zones) {
+        size_t len = zone_length(*zone);
+        if (len == 0) {
+            continue;
+        }
+        // record header is "====<sec>.<nsec>-<C|D>\n", C for compressed
+        const char* hdr = zone_data(*zone, 0, std::min<size_t>(len, 64), scratch);
+        const char* eol = static_cast<const char*>(memchr(hdr, '\n', std::min<size_t>(len, 64)));
+        fprintf(fp, "%s:\n", zone->name.c_str());
+        if (eol && eol - hdr >= 2 && eol[-2] == '-' && eol[-1] == 'C') {
+            fprintf(fp, "%.*s compressed, %s\n\n", static_cast<int>(eol - hdr), hdr, csize(len).c_str());
+            continue;
+        }
+        write_zone(*zone);
+        fprintf(fp, "\n");
     }
-    ulong mprz_addr = read_pointer(cxt_addr + field_offset(ramoops_context,mprz),"mprz");
-    if (!is_kvaddr(mprz_addr)) {
-        fprintf(fp, "mprz address is invalid!\n");
+}
+
+void Pstore::print_console_log(){
+    if (!load_zones()) {
         return;
     }
-    ulong zone_paddr = read_ulong(mprz_addr + field_offset(persistent_ram_zone,paddr),"paddr");
-    // ulong zone_size = read_ulong(mprz_addr + field_offset(persistent_ram_zone,size),"size");
-    ulong buffer_addr = read_pointer(mprz_addr + field_offset(persistent_ram_zone,buffer),"buffer");
-    if (!is_kvaddr(buffer_addr)) {
-        fprintf(fp, "buffer address is invalid!\n");
+    if (!console_zone){
+        fprintf(fp, "console_size is 0!\n");
         return;
     }
-    int buf_start = read_int(buffer_addr + field_offset(persistent_ram_buffer,start),"start");
-    int buf_size = read_int(buffer_addr + field_offset(persistent_ram_buffer,size),"size");
-    std::vector<char> logbuf;
-    ulong addr = 0;
-    size_t len = 0;
-    void *data_buf;
-    if (buf_start < buf_size){
-        addr = zone_paddr + buf_start;
-        len = buf_size - buf_start;
-        data_buf = read_memory(addr, len,"data1",false);
-        appendBuffer(logbuf,data_buf , len);
-        FREEBUF(data_buf);
+    write_zone(*console_zone);
+}
 
-        addr = zone_paddr;
-        len = buf_start;
-        data_buf = read_memory(addr, len,"data2",false);
-        appendBuffer(logbuf, data_buf, len);
-        FREEBUF(data_buf);
-    }else{
-        addr = zone_paddr;
-        len = buf_size;
-        data_buf = read_memory(addr, len,"data",false);
-        appendBuffer(logbuf, data_buf, len);
-        FREEBUF(data_buf);
-    }
-    // fprintf(fp, "%s", hexdump(0x1000,(char*)logbuf.data(), logbuf.size()).c_str());
-    extract_pmsg_logs(logbuf);
+void Pstore::print_pmsg(){
+    if (!load_zones()) {
+        return;
+    }
+    if (!pmsg_zone){
+        fprintf(fp, "pmsg_size is 0!\n");
+        return;
+    }
+    extract_pmsg_logs(*pmsg_zone);
 }
 
 // write log by LogTags::WritePmsgEventLogTags(uint32_t tag, uid_t uid)
-void Pstore::extract_pmsg_logs(std::vector<char>& logbuf){
-    char* logptr = logbuf.data();
-    long len = logbuf.size();
-    long head_len = sizeof(android_pmsg_log_header_t) + sizeof(android_log_header_t) ;
-    while (len > head_len){
+void Pstore::extract_pmsg_logs(const pstore_zone& zone){
+    size_t total = zone_length(zone);
+    size_t pos = 0;
+    const size_t head_len = sizeof(android_pmsg_log_header_t) + sizeof(android_log_header_t);
+    std::vector<char> head_scratch;
+    std::vector<char> msg_scratch;
+    std::string out;
+    char timestamp[64];
+    out.reserve(PSTORE_OUT_FLUSH + 4096);
+    while (total - pos > head_len){
         //   ----------------------------------------------------------------------------------------
         //   |    android_pmsg_log_header_t    |   android_log_header_t   |    tag     |   msg      |
         //   ----------------------------------------------------------------------------------------
-        android_pmsg_log_header_t pmsgHeader = *reinterpret_cast<android_pmsg_log_header_t*>(logptr);
-        android_log_header_t header = *reinterpret_cast<android_log_header_t*>(logptr + sizeof(android_pmsg_log_header_t));
-        if (pmsgHeader.magic == 'l' && (header.id < 7 && header.id >=0) && pmsgHeader.len > head_len){
-            if (len > pmsgHeader.len ){
-                android_pmsg_log_header_t pmsgHeader2 = *reinterpret_cast<android_pmsg_log_header_t*>(logptr + pmsgHeader.len);
-                if (pmsgHeader2.magic != 'l'){
-                    len -= head_len;
-                    logptr += head_len;
+        size_t len = total - pos;
+        const char* logptr = zone_data(zone, pos, head_len, head_scratch);
+        android_pmsg_log_header_t pmsgHeader;
+        android_log_header_t header;
+        memcpy(&pmsgHeader, logptr, sizeof(pmsgHeader));
+        memcpy(&header, logptr + sizeof(android_pmsg_log_header_t), sizeof(header));
+        if (pmsgHeader.magic == 'l' && header.id < 7 && pmsgHeader.len > head_len && pmsgHeader.len <= len){
+            if (len > pmsgHeader.len){
+                const char* next = zone_data(zone, pos + pmsgHeader.len, 1, head_scratch);
+                if (*next != 'l'){
+                    pos += head_len;
                     continue;
                 }
             }
-            std::string timestamp = formatTime(header.realtime.tv_sec,header.realtime.tv_nsec);
-            char* msg_ptr = logptr + head_len;
-            int msg_len = pmsgHeader.len - head_len;
+            formatTime(header.realtime.tv_sec, header.realtime.tv_nsec, timestamp, sizeof(timestamp));
+            uint16_t msg_len = pmsgHeader.len - head_len;
+            const char* msg_ptr = zone_data(zone, pos + head_len, msg_len, msg_scratch);
             if (header.id == MAIN || header.id == SYSTEM || header.id == RADIO || header.id == CRASH || header.id == KERNEL){
                 //   --------------------------------------------------------
                 //   |    priority    |          tag         |   log         |
                 //   --------------------------------------------------------
-                parser_system_log(timestamp, pmsgHeader.uid, header.tid, pmsgHeader.pid, msg_ptr, msg_len);
+                parser_system_log(timestamp, pmsgHeader.uid, header.tid, pmsgHeader.pid, msg_ptr, msg_len, out);
             }else if (header.id == EVENTS){
-                parser_event_log(timestamp, pmsgHeader.uid, header.tid, pmsgHeader.pid, msg_ptr, msg_len);
+                parser_event_log(timestamp, pmsgHeader.uid, header.tid, pmsgHeader.pid, msg_ptr, msg_len, out);
             }
-            len -= pmsgHeader.len;
-            logptr += pmsgHeader.len;
+            if (out.size() >= PSTORE_OUT_FLUSH) {
+                fwrite(out.data(), 1, out.size(), fp);
+                out.clear();
+            }
+            pos += pmsgHeader.len;
         }else{
-            len -= 1;
-            logptr += 1;
+            pos += 1;
         }
     }
+    fwrite(out.data(), 1, out.size(), fp);
 }
 
-void Pstore::parser_system_log(std::string timestamp, uint16_t uid, uint16_t tid, uint16_t pid, char* logbuf, uint16_t msg_len){
-    if (logbuf[0] < 0 || logbuf[0] >= 9){
+void Pstore::parser_system_log(const char* timestamp, uint16_t uid, uint16_t tid, uint16_t pid, const char* logbuf, uint16_t msg_len, std::string& out){
+    if (msg_len < 1 || logbuf[0] < 0 || logbuf[0] >= 9){
         return;
     }
     LogLevel priority = priorityMap[logbuf[0]];
-    std::string msg = std::string(logbuf +1, msg_len - 1);
-    size_t pos = 0;
-    while ((pos = msg.find('\0')) != std::string::npos) {
-        msg.replace(pos, 1, " ");
-    }
-    while ((pos = msg.find('\n')) != std::string::npos) {
-        msg.replace(pos, 1, " ");
-    }
-    std::ostringstream log;
-    log << std::setw(18) << std::left << timestamp << " "
-        << std::setw(5) << pid << " "
-        << std::setw(5) << tid << " "
-        << std::setw(6) << uid << " "
-        << getLogLevelChar(priority) << " "
-        << msg;
-    fprintf(fp, "%s \n",log.str().c_str());
+    char prefix[128];
+    int len = snprintf(prefix, sizeof(prefix), "%-18s %-5u %-5u %-6u %s ",
+        timestamp, pid, tid, uid, getLogLevelChar(priority).c_str());
+    out.append(prefix, len);
+    size_t msg_start = out.size();
+    out.append(logbuf + 1, msg_len - 1);
+    for (size_t i = msg_start; i < out.size(); i++) {
+        if (out[i] == '\0' || out[i] == '\n') {
+            out[i] = ' ';
+        }
+    }
+    out.append(" \n");
 }
 
-void Pstore::parser_event_log(std::string timestamp, uint16_t uid, uint16_t tid, uint16_t pid, char* logbuf, uint16_t msg_len){
+void Pstore::parser_event_log(const char* timestamp, uint16_t uid, uint16_t tid, uint16_t pid, const char* logbuf, uint16_t msg_len, std::string& out){
     const size_t header_size = sizeof(android_event_header_t);
     size_t pos = 0;
-    char* msg_ptr = logbuf;
+    const char* msg_ptr = logbuf;
     LogLevel priority = priorityMap[LOG_INFO];
-    std::ostringstream log;
-    log << std::setw(18) << std::left << timestamp << " "
-        << std::setw(5) << pid << " "
-        << std::setw(5) << tid << " "
-        << std::setw(6) << uid << " "
-        << getLogLevelChar(priority) << " ";
+    char prefix[128];
+    int len = snprintf(prefix, sizeof(prefix), "%-18s %-5u %-5u %-6u %s ",
+        timestamp, pid, tid, uid, getLogLevelChar(priority).c_str());
+    out.append(prefix, len);
     while (pos < msg_len){
         if (pos + header_size > msg_len){
             break;
         }
-        android_event_header_t head = *reinterpret_cast<android_event_header_t*>(msg_ptr);
+        android_event_header_t head;
+        memcpy(&head, msg_ptr, sizeof(head));
         msg_ptr += header_size;
         pos += header_size;
         // read the tag
-        log << head.tag << " :[";
+        out += std::to_string(head.tag);
+        out += " :[";
         LogEvent event = get_event(pos, msg_ptr, msg_len);
         if (event.type == -1) {
             break;
@@ -334,38 +756,36 @@ void Pstore::parser_event_log(std::string timestamp, uint16_t uid, uint16_t tid,
         msg_ptr += event.len;
         pos += event.len;
         if (event.type == TYPE_LIST) {
-            std::string list_msg;
             int cnt = std::stoi(event.val);
             for (int i = 0; i < cnt && pos < msg_len; ++i) {
                 event = get_event(pos, msg_ptr, msg_len);
-                if (!list_msg.empty()) {
-                    list_msg += ",";
+                if (i > 0) {
+                    out += ",";
                 }
-                list_msg += event.val;
+                out += event.val;
                 msg_ptr += event.len;
                 pos += event.len;
             }
-            log << list_msg;
         } else {
-            log << event.val;
+            out += event.val;
         }
-        log << "]";
+        out += "]";
     }
-    fprintf(fp, "%s \n",log.str().c_str());
+    out.append(" \n");
 }
 
-LogEvent Pstore::get_event(size_t pos, char* data, size_t len) {
+LogEvent Pstore::get_event(size_t pos, const char* data, size_t len) {
     LogEvent event = {-1, "", -1};
     if ((pos + sizeof(int8_t)) >= len) {
         return event;
     }
-    int8_t event_type = *reinterpret_cast<int8_t*>(data);
+    int8_t event_type = *reinterpret_cast<const int8_t*>(data);
     switch (event_type) {
         case TYPE_INT:{
             if (pos + sizeof(android_event_int_t) > len) {
                 return event;
             }
-            android_event_int_t event_int = *reinterpret_cast<android_event_int_t*>(data);
+            android_event_int_t event_int = *reinterpret_cast<const android_event_int_t*>(data);
             event.len = sizeof(android_event_int_t);
             event.type = event_int.type;
             event.val = std::to_string(event_int.data);
@@ -375,7 +795,7 @@ LogEvent Pstore::get_event(size_t pos, char* data, size_t len) {
             if (pos + sizeof(android_event_long_t) > len) {
                 return event;
             }
-            android_event_long_t event_long = *reinterpret_cast<android_event_long_t*>(data);
+            android_event_long_t event_long = *reinterpret_cast<const android_event_long_t*>(data);
             event.len = sizeof(android_event_long_t);
             event.type = event_long.type;
             event.val = std::to_string(event_long.data);
@@ -385,7 +805,7 @@ LogEvent Pstore::get_event(size_t pos, char* data, size_t len) {
             if (pos + sizeof(android_event_float_t) > len) {
                 return event;
             }
-            android_event_float_t event_float = *reinterpret_cast<android_event_float_t*>(data);
+            android_event_float_t event_float = *reinterpret_cast<const android_event_float_t*>(data);
             event.len = sizeof(android_event_float_t);
             event.type = event_float.type;
             event.val = std::to_string(event_float.data);
@@ -395,7 +815,7 @@ LogEvent Pstore::get_event(size_t pos, char* data, size_t len) {
             if (pos + sizeof(android_event_list_t) > len) {
                 return event;
             }
-            android_event_list_t event_list = *reinterpret_cast<android_event_list_t*>(data);
+            android_event_list_t event_list = *reinterpret_cast<const android_event_list_t*>(data);
             event.len = sizeof(android_event_list_t);
             event.type = event_list.type;
             event.val = std::to_string(event_list.element_count);
@@ -405,7 +825,7 @@ LogEvent Pstore::get_event(size_t pos, char* data, size_t len) {
             if (pos + sizeof(android_event_string_t) > len) {
                 return event;
             }
-            android_event_string_t event_str = *reinterpret_cast<android_event_string_t*>(data);
+            android_event_string_t event_str = *reinterpret_cast<const android_event_string_t*>(data);
             if (pos + sizeof(android_event_string_t) + event_str.length > len) {
                 return event;
             }
@@ -434,23 +854,19 @@ std::string Pstore::getLogLevelChar(LogLevel level) {
     }
 }
 
-void Pstore::appendBuffer(std::vector<char>& destBuf, void* sourceBuf, size_t length) {
-    size_t currentSize = destBuf.size();
-    destBuf.resize(currentSize + length);
-    memcpy(destBuf.data() + currentSize, sourceBuf, length);
-}
-
-std::string Pstore::formatTime(uint32_t tv_sec, uint32_t tv_nsec) {
-    std::chrono::seconds sec(tv_sec);
-    std::chrono::nanoseconds nsec(tv_nsec);
-    auto tp = std::chrono::time_point<std::chrono::system_clock>(sec) + nsec;
-    std::time_t rtc_time = std::chrono::system_clock::to_time_t(tp);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()) % 1000;
-    std::tm* tm = std::localtime(&rtc_time);
-    char buffer[30];
-    strftime(buffer, sizeof(buffer), "%y-%m-%d %H:%M:%S", tm);
-    std::ostringstream oss;
-    oss << buffer << "." << std::setw(6) << std::setfill('0') << ms.count();
-    return oss.str();
+/*
+ * Local time of the log entry; strftime only runs when the second changes,
+ * which is rare between consecutive entries.
+ */
+void Pstore::formatTime(uint32_t tv_sec, uint32_t tv_nsec, char* buf, size_t len) {
+    if (time_cache_str[0] == '\0' || tv_sec != time_cache_sec) {
+        std::time_t rtc_time = tv_sec;
+        std::tm* tm = std::localtime(&rtc_time);
+        if (!tm || strftime(time_cache_str, sizeof(time_cache_str), "%y-%m-%d %H:%M:%S", tm) == 0) {
+            time_cache_str[0] = '\0';
+        }
+        time_cache_sec = tv_sec;
+    }
+    snprintf(buf, len, "%s.%06u", time_cache_str, (tv_nsec / 1000000) % 1000);
 }
 #pragma GCC diagnostic pop
@@ -33,6 +33,55 @@ typedef struct __attribute__((__packed__)) {
     log_time realtime;
 } android_log_header_t;
 
+#define PERSISTENT_RAM_SIG      0x43474244  /* DBGC */
+#define PSTORE_MAX_ZONES        1024        /* bound of dprzs/fprzs */
+#define PSTORE_TS_CPU_SHIFT     8           /* cpu in the low bits of pstore_ftrace_record.ts */
+#define PSTORE_OUT_FLUSH        (1024*1024)
+
+/*
+ * A persistent_ram_zone read from its physical address in one go. The
+ * log is seg[0] followed by seg[1], i.e. data[start, size) then
+ * data[0, start) once the ring wrapped, both pointing into mem.
+ */
+struct pstore_zone {
+    std::string name;
+    ulong addr;                 /* persistent_ram_zone */
+    ulong paddr;
+    size_t size;                /* header + data + ecc */
+    size_t buffer_size;         /* data area */
+    uint32_t sig;
+    size_t start;
+    size_t used;
+    int ecc_block_size;
+    int ecc_size;
+    int ecc_symsize;
+    int ecc_poly;
+    int corrected_bytes;
+    int bad_blocks;
+    std::vector<char> mem;
+    const char* seg[2];
+    size_t seg_len[2];
+};
+
+/* lib/reed_solomon codec in the index form of GF(2^symsize) */
+struct rs_codec {
+    int symsize;
+    int nn;
+    int nroots;
+    int fcr;
+    int prim;
+    int iprim;
+    std::vector<int> alpha_to;
+    std::vector<int> index_of;
+};
+
+struct pstore_ftrace_rec {
+    uint64_t ts;
+    ulong ip;
+    ulong parent_ip;
+    int cpu;
+};
+
 class Pstore : public ParserPlugin {
 private:
     const std::array<LogLevel, 9> priorityMap = {{
@@ -46,19 +95,38 @@ private:
         LogLevel::LOG_FATAL,
         LogLevel::LOG_SILENT
     }};
+    bool zones_loaded = false;
+    std::vector<std::shared_ptr<pstore_zone>> dmesg_zones;
+    std::vector<std::shared_ptr<pstore_zone>> ftrace_zones;
+    std::shared_ptr<pstore_zone> console_zone;
+    std::shared_ptr<pstore_zone> pmsg_zone;
+    std::unordered_map<ulong, std::pair<std::string, ulong>> sym_cache; // ip -> <name, offset>
+    uint32_t time_cache_sec = 0;
+    char time_cache_str[32] = {};
+
+    bool load_zones();
+    std::shared_ptr<pstore_zone> read_zone(ulong prz_addr, const std::string& name);
+    void correct_zone(pstore_zone& zone);
+    static bool init_rs(rs_codec& rs, int symsize, int gfpoly, int fcr, int prim, int nroots);
+    static int decode_rs8(const rs_codec& rs, uint8_t* data, size_t len, uint8_t* par);
+    static size_t zone_length(const pstore_zone& zone);
+    static const char* zone_data(const pstore_zone& zone, size_t off, size_t len, std::vector<char>& scratch);
+    void write_zone(const pstore_zone& zone);
+    const std::pair<std::string, ulong>& lookup_symbol(ulong ip);
+
 public:
     Pstore();
     void print_ftrace_log();
     void print_oops_log();
     void print_console_log();
     void cmd_main(void) override;
+    void print_zone_info();
     void print_pmsg();
-    void extract_pmsg_logs(std::vector<char> &logbuf);
-    void parser_system_log(std::string timestamp, uint16_t uid, uint16_t tid, uint16_t pid, char *logbuf, uint16_t msg_len);
-    void parser_event_log(std::string timestamp, uint16_t uid, uint16_t tid, uint16_t pid, char* logbuf, uint16_t msg_len);
-    LogEvent get_event(size_t pos, char* data, size_t len);
-    void appendBuffer(std::vector<char> &destBuf, void *sourceBuf, size_t length);
-    std::string formatTime(uint32_t tv_sec, uint32_t tv_nsec);
+    void extract_pmsg_logs(const pstore_zone& zone);
+    void parser_system_log(const char* timestamp, uint16_t uid, uint16_t tid, uint16_t pid, const char* logbuf, uint16_t msg_len, std::string& out);
+    void parser_event_log(const char* timestamp, uint16_t uid, uint16_t tid, uint16_t pid, const char* logbuf, uint16_t msg_len, std::string& out);
+    LogEvent get_event(size_t pos, const char* data, size_t len);
+    void formatTime(uint32_t tv_sec, uint32_t tv_nsec, char* buf, size_t len);
     std::string getLogLevelChar(LogLevel level);
     DEFINE_PLUGIN_INSTANCE(Pstore)
 };
@@ -14,6 +14,8 @@
  */
 
 #include "rtb.h"
+#include <queue>
+#include <tuple>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpointer-arith"
@@ -24,7 +26,9 @@ DEFINE_PLUGIN_COMMAND(Rtb)
 
 void Rtb::cmd_main(void) {
     int c;
+    bool show = false;
     std::string cppString;
+    rtb_filter filter;
     if (argcnt < 2) cmd_usage(pc->curcmd, SYNOPSIS);
     if (!is_enable_rtb()){
         return;
@@ -32,23 +36,47 @@ void Rtb::cmd_main(void) {
     if(rtb_state_ptr.get() == nullptr){
         parser_rtb_log();
     }
-    while ((c = getopt(argcnt, args, "ac:i")) != EOF) {
+    if(rtb_state_ptr.get() == nullptr){
+        return;
+    }
+    while ((c = getopt(argcnt, args, "ac:it:s:e:n:")) != EOF) {
+        cppString.assign(optarg ? optarg : "");
         switch(c) {
             case 'a':
-                print_rtb_log();
+                show = true;
                 break;
             case 'c':
-                cppString.assign(optarg);
                 try {
-                    int cpu = std::stoi(cppString);
-                    if(cpu >= rtb_state_ptr->step_size){
-                        fprintf(fp, "invaild arg %s\n",cppString.c_str());
-                        return;
-                    }
-                    print_percpu_rtb_log(cpu);
+                    filter.cpu = std::stoi(cppString);
+                } catch (...) {
+                    filter.cpu = -1;
+                }
+                if(filter.cpu < 0 || filter.cpu >= rtb_state_ptr->step_size){
+                    fprintf(fp, "invaild arg %s\n",cppString.c_str());
+                    return;
+                }
+                show = true;
+                break;
+            case 't':
+                filter.type = parse_type(cppString);
+                if(filter.type < 0){
+                    fprintf(fp, "invaild type %s\n",cppString.c_str());
+                    return;
+                }
+                show = true;
+                break;
+            case 's':
+            case 'e':
+            case 'n':
+                try {
+                    if (c == 's') filter.start = std::stod(cppString);
+                    if (c == 'e') filter.end = std::stod(cppString);
+                    if (c == 'n') filter.count = std::stoul(cppString);
                 } catch (...) {
                     fprintf(fp, "invaild arg %s\n",cppString.c_str());
+                    return;
                 }
+                show = true;
                 break;
             case 'i':
                 print_rtb_log_memory();
@@ -60,6 +88,8 @@ void Rtb::cmd_main(void) {
     }
     if (argerrs)
         cmd_usage(pc->curcmd, SYNOPSIS);
+    if (show)
+        print_rtb_log(filter);
 }
 
 void Rtb::init_offset(){
@@ -84,11 +114,13 @@ Rtb::Rtb(){
         "dump rtb log",        /* short description */
         "-a \n"
             "  rtb -c <cpu>\n"
+            "  rtb -t <type> -s <start sec> -e <end sec> -n <count>\n"
             "  rtb -i\n"
-            "  This command dumps the rtb log.",
+            "  This command dumps the rtb log of all cpus merged by timestamp,",
+            "  -c, -t, -s, -e and -n can be combined to filter it.",
         "\n",
         "EXAMPLES",
-        "  Display all rtb log:",
+        "  Display all rtb log, all cpus in timestamp order:",
         "    %s> rtb -a",
         "       [234.501829] [12532249254] <0>: LOGK_CTXID ctxid:1621 called from addr ffffffd4d628a684 __schedule Line 220 of include/trace/events/sched.h",
         "       [234.501836] [12532249398] <0>: LOGK_IRQ interrupt:1 handled from addr ffffffd4d627c7b4 ipi_handler.04f2cb5359f849bb5e8105832b6bf932.cfi_jt Line 888 of arch/arm64/kernel/entry.S",
@@ -102,6 +134,12 @@ Rtb::Rtb(){
         "       [234.501949] [12532251573] <0>: LOGK_CTXID ctxid:4284 called from addr ffffffd4d628a684 __schedule Line 220 of include/trace/events/sched.h",
         "       [234.502641] [12532264845] <0>: LOGK_CTXID ctxid:4285 called from addr ffffffd4d628a684 __schedule Line 220 of include/trace/events/sched.h",
         "\n",
+        "  Display the last 3 LOGK_IRQ events between 234.5s and 234.6s:",
+        "    %s> rtb -t irq -s 234.5 -e 234.6 -n 3",
+        "       [234.501836] [12532249398] <0>: LOGK_IRQ interrupt:1 handled from addr ffffffd4d627c7b4 ipi_handler.04f2cb5359f849bb5e8105832b6bf932.cfi_jt Line 888 of arch/arm64/kernel/entry.S",
+        "       [234.501840] [12532249462] <2>: LOGK_IRQ interrupt:2 handled from addr ffffffd4d627c7b4 ipi_handler.04f2cb5359f849bb5e8105832b6bf932.cfi_jt Line 888 of arch/arm64/kernel/entry.S",
+        "       [234.502113] [12532254711] <1>: LOGK_IRQ interrupt:1 handled from addr ffffffd4d627c7b4 ipi_handler.04f2cb5359f849bb5e8105832b6bf932.cfi_jt Line 888 of arch/arm64/kernel/entry.S",
+        "\n",
         "  Display rtb log memory info:",
         "    %s> rtb -i",
         "       RTB log size:1.00Mb",
@@ -129,20 +167,20 @@ bool Rtb::is_enable_rtb(){
     return true;
 }
 
-double Rtb::get_timestamp(struct rtb_layout& layout){
-    if (layout.timestamp == 0) {
+double Rtb::get_timestamp(const rtb_entry& entry){
+    if (entry.timestamp == 0) {
         return 0.0;
     }
-    double ts_float = static_cast<double>(layout.timestamp) / 1e9;
+    double ts_float = static_cast<double>(entry.timestamp) / 1e9;
     return std::round(ts_float * 1e6) / 1e6;
 }
 
-std::string Rtb::get_fun_name(struct rtb_layout& layout){
+std::string Rtb::get_fun_name(uint64_t caller){
     struct syment *sp;
     ulong offset;
     std::string res = "Unknown function";
-    if (is_kvaddr(layout.caller)){
-        sp = value_search(layout.caller, &offset);
+    if (is_kvaddr(caller)){
+        sp = value_search(caller, &offset);
         if (sp) {
             res = sp->name;
         }
@@ -150,12 +188,12 @@ std::string Rtb::get_fun_name(struct rtb_layout& layout){
     return res;
 }
 
-std::string Rtb::get_caller(struct rtb_layout& layout){
+std::string Rtb::get_caller(uint64_t caller){
     char cmd_buf[BUFSIZE];
     std::string result = "";
-    if (is_kvaddr(layout.caller)){
+    if (is_kvaddr(caller)){
         open_tmpfile();
-        sprintf(cmd_buf, "info line *0x%llx",(ulonglong)layout.caller);
+        sprintf(cmd_buf, "info line *0x%llx",(ulonglong)caller);
         if (!gdb_pass_through(cmd_buf, fp, GNU_RETURN_ON_ERROR)){
             close_tmpfile();
         }
@@ -177,8 +215,16 @@ std::string Rtb::get_caller(struct rtb_layout& layout){
     return result;
 }
 
-void Rtb::print_none(int cpu, struct rtb_layout& layout) {
-    fprintf(fp, "<%d> No data\n",cpu);
+/*
+ * The ring holds a few callers many times over, so each caller is
+ * resolved only once per session.
+ */
+const std::pair<std::string, std::string>& Rtb::get_caller_info(uint64_t caller){
+    auto it = caller_cache.find(caller);
+    if (it == caller_cache.end()){
+        it = caller_cache.emplace(caller, std::make_pair(get_fun_name(caller), get_caller(caller))).first;
+    }
+    return it->second;
 }
 
 static std::vector<std::string> type_str = {
@@ -194,159 +240,67 @@ static std::vector<std::string> type_str = {
     "LOGK_IRQ",
 };
 
-void Rtb::print_read_write(int cpu, struct rtb_layout& layout) {
-    std::string name = get_fun_name(layout);
-    std::string line = get_caller(layout);
-    fprintf(fp, "[%f] [%lld] <%d>: %s from address:%llx(%llx) called from addr %llx %s %s\n",
-        get_timestamp(layout),
-        ((ulonglong)layout.cycle_count),
-        cpu,
-        type_str[layout.log_type].c_str(),
-        ((ulonglong)layout.data),
-        ((ulonglong)virt_to_phy(layout.data)),
-        ((ulonglong)layout.caller),
-        name.c_str(),
-        line.c_str()
-    );
-}
-
-void Rtb::print_logbuf(int cpu, struct rtb_layout& layout) {
-    std::string name = get_fun_name(layout);
-    std::string line = get_caller(layout);
-    fprintf(fp, "[%f] [%lld] <%d>: %s log end:%llx called from addr %llx %s %s\n",
-        get_timestamp(layout),
-        ((ulonglong)layout.cycle_count),
-        cpu,
-        type_str[layout.log_type].c_str(),
-        ((ulonglong)layout.data),
-        ((ulonglong)layout.caller),
-        name.c_str(),
-        line.c_str()
-    );
-}
-
-void Rtb::print_hotplug(int cpu, struct rtb_layout& layout) {
-    std::string name = get_fun_name(layout);
-    std::string line = get_caller(layout);
-    fprintf(fp, "[%f] [%lld] <%d>: %s cpu data:%llx called from addr %llx %s %s\n",
-        get_timestamp(layout),
-        ((ulonglong)layout.cycle_count),
-        cpu,
-        type_str[layout.log_type].c_str(),
-        ((ulonglong)layout.data),
-        ((ulonglong)layout.caller),
-        name.c_str(),
-        line.c_str()
-    );
-}
-
-void Rtb::print_ctxid(int cpu, struct rtb_layout& layout) {
-    std::string name = get_fun_name(layout);
-    std::string line = get_caller(layout);
-    fprintf(fp, "[%f] [%lld] <%d>: %s ctxid:%lld called from addr %llx %s %s\n",
-        get_timestamp(layout),
-        ((ulonglong)layout.cycle_count),
-        cpu,
-        type_str[layout.log_type].c_str(),
-        ((ulonglong)layout.data),
-        ((ulonglong)layout.caller),
-        name.c_str(),
-        line.c_str()
-    );
-}
-
-void Rtb::print_timestamp(int cpu, struct rtb_layout& layout) {
-    std::string name = get_fun_name(layout);
-    std::string line = get_caller(layout);
-    fprintf(fp, "[%f] [%lld] <%d>: %s timestamp:%llx called from addr %llx %s %s\n",
-        get_timestamp(layout),
-        ((ulonglong)layout.cycle_count),
-        cpu,
-        type_str[layout.log_type].c_str(),
-        ((ulonglong)layout.data),
-        ((ulonglong)layout.caller),
-        name.c_str(),
-        line.c_str()
-    );
-}
-
-void Rtb::print_l2cpread_write(int cpu, struct rtb_layout& layout) {
-    std::string name = get_fun_name(layout);
-    std::string line = get_caller(layout);
-    fprintf(fp, "[%f] [%lld] <%d>: %s from offset:%llx called from addr %llx %s %s\n",
-        get_timestamp(layout),
-        ((ulonglong)layout.cycle_count),
-        cpu,
-        type_str[layout.log_type].c_str(),
-        ((ulonglong)layout.data),
-        ((ulonglong)layout.caller),
-        name.c_str(),
-        line.c_str()
-    );
-}
-
-void Rtb::print_irq(int cpu, struct rtb_layout& layout) {
-    std::string name = get_fun_name(layout);
-    std::string line = get_caller(layout);
-    fprintf(fp, "[%f] [%lld] <%d>: %s interrupt:%lld handled from addr %llx %s %s\n",
-        get_timestamp(layout),
-        ((ulonglong)layout.cycle_count),
-        cpu,
-        type_str[layout.log_type].c_str(),
-        ((ulonglong)layout.data),
-        ((ulonglong)layout.caller),
-        name.c_str(),
-        line.c_str()
-    );
-}
-
-int Rtb::print_rtb_layout(int cpu,int index){
-    ulong addr = rtb_state_ptr->rtb_layout + index * struct_size(msm_rtb_layout);
-    struct rtb_layout layout;
-    if(!read_struct(addr,&layout,sizeof(layout),"msm_rtb_layout")){
-        return 0;
+/* type number, LOGK_IRQ or irq */
+int Rtb::parse_type(const std::string& arg){
+    std::string name = arg;
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    for (size_t i = 0; i < type_str.size(); i++){
+        if (name == type_str[i] || "LOGK_" + name == type_str[i]){
+            return i;
+        }
     }
-    if (layout.sentinel[0] != 0xFF || layout.sentinel[1] != 0xAA || layout.sentinel[2] != 0xFF){
-        return 0;
+    char *end = nullptr;
+    long type = strtol(arg.c_str(), &end, 0);
+    if (arg.empty() || *end != '\0' || type < 0 || type >= (long)type_str.size()){
+        return -1;
     }
-    // fprintf(fp, "msm_rtb_layout:%lx \n",addr);
-    if (layout.idx == 0 || layout.log_type == 0){
-        return 0;
+    return type;
+}
+
+void Rtb::print_rtb_entry(int cpu, const rtb_entry& entry) {
+    if (entry.type == LOGK_NONE || entry.type >= type_str.size()){
+        fprintf(fp, "<%d> No data\n",cpu);
+        return;
     }
-    int type = layout.log_type & 0x7F;
-    switch (type)
+    std::ostringstream oss;
+    oss << std::hex;
+    switch (entry.type)
     {
-    case LOGK_NONE:
-        print_none(cpu, layout);
-        break;
     case LOGK_READL:
     case LOGK_WRITEL:
-        print_read_write(cpu, layout);
+        oss << "from address:" << entry.data << "(" << (ulonglong)virt_to_phy(entry.data) << ") called from addr ";
         break;
     case LOGK_LOGBUF:
-        print_logbuf(cpu, layout);
+        oss << "log end:" << entry.data << " called from addr ";
         break;
     case LOGK_HOTPLUG:
-        print_hotplug(cpu, layout);
+        oss << "cpu data:" << entry.data << " called from addr ";
         break;
     case LOGK_CTXID:
-        print_ctxid(cpu, layout);
+        oss << std::dec << "ctxid:" << entry.data << std::hex << " called from addr ";
         break;
     case LOGK_TIMESTAMP:
-        print_timestamp(cpu, layout);
+        oss << "timestamp:" << entry.data << " called from addr ";
         break;
     case LOGK_L2CPREAD:
     case LOGK_L2CPWRITE:
-        print_l2cpread_write(cpu, layout);
+        oss << "from offset:" << entry.data << " called from addr ";
         break;
     case LOGK_IRQ:
-        print_irq(cpu, layout);
-        break;
-    default:
-        print_none(cpu, layout);
+        oss << std::dec << "interrupt:" << entry.data << std::hex << " handled from addr ";
         break;
     }
-    return layout.idx;
+    const std::pair<std::string, std::string>& info = get_caller_info(entry.caller);
+    fprintf(fp, "[%f] [%lld] <%d>: %s %s%llx %s %s\n",
+        get_timestamp(entry),
+        ((ulonglong)entry.cycle_count),
+        cpu,
+        type_str[entry.type].c_str(),
+        oss.str().c_str(),
+        ((ulonglong)entry.caller),
+        info.first.c_str(),
+        info.second.c_str()
+    );
 }
 
 int Rtb::next_rtb_entry(int index){
@@ -359,49 +313,64 @@ int Rtb::next_rtb_entry(int index){
     return (index + step_size) & mask;
 }
 
-void Rtb::print_percpu_rtb_log(int cpu){
-    if (rtb_state_ptr->initialized != 1){
-        fprintf(fp, "RTB was not initialized in this build.\n");
-        return;
-    }
-    int index = 0;
-    int last_idx = 0;
-    int next = 0;
-    int next_idx = 0;
-    if (THIS_KERNEL_VERSION >= LINUX(5,10,0)){
-        if(get_config_val("CONFIG_QCOM_RTB_SEPARATE_CPUS") == "y"){
-            index = rtb_state_ptr->rtb_idx[cpu];
-        }else{
-            index = rtb_state_ptr->rtb_idx[0];
-        }
-    }else{
-        if(get_config_val("CONFIG_QCOM_RTB_SEPARATE_CPUS") == "y"){
-            index = read_int(csymbol_value("msm_rtb_idx_cpu") + kt->__per_cpu_offset[cpu],"msm_rtb_idx_cpu");
-        }else{
-            index = read_int(csymbol_value("msm_rtb_idx"),"msm_rtb_idx");
-        }
-    }
+/*
+ * Follow one cpu ring from its write index while idx keeps growing, the
+ * same walk the driver's own dump does, but on the decoded array.
+ */
+std::vector<uint32_t> Rtb::walk_ring(int index){
+    std::vector<uint32_t> ring;
+    const std::vector<rtb_entry>& entries = rtb_state_ptr->entries;
     index = index & (rtb_state_ptr->nentries - 1);
-    // fprintf(fp, "rtb_layout index for cpu[%d] is %d \n",cpu, index);
-    struct rtb_layout layout;
-    while (1){
-        last_idx = print_rtb_layout(cpu,index);
-        // fprintf(fp, "last_index:%d, last_idx:%d\n",index, last_idx);
-        next = next_rtb_entry(index);
-        ulong addr = rtb_state_ptr->rtb_layout + next * struct_size(msm_rtb_layout);
-        BZERO(&layout, sizeof(layout));
-        if(!read_struct(addr,&layout,sizeof(layout),"msm_rtb_layout")){
-            break;
+    for (size_t guard = 0; guard < entries.size(); guard++){
+        uint32_t last_idx = 0;
+        if (entries[index].valid){
+            ring.push_back(index);
+            last_idx = entries[index].idx;
         }
-        next_idx = layout.idx;
-        // fprintf(fp, "next:%d, next_idx:%d\n",next, next_idx);
-        if (last_idx < next_idx){
+        int next = next_rtb_entry(index);
+        if (last_idx < entries[next].idx){
             index = next;
         }
         if (next != index){
             break;
         }
     }
+    return ring;
+}
+
+/*
+ * Read the whole rtb_layout region once and decode it. The region is
+ * physically contiguous, the virtual read is only the fallback.
+ */
+void Rtb::load_rtb_entries(){
+    int stride = struct_size(msm_rtb_layout);
+    size_t nentries = rtb_state_ptr->nentries;
+    if (stride < (int)sizeof(struct rtb_layout) || nentries == 0){
+        return;
+    }
+    std::vector<char> buf(nentries * stride);
+    if (!read_struct(rtb_state_ptr->phys, buf.data(), buf.size(), "msm_rtb_layout", false)
+        && !read_struct(rtb_state_ptr->rtb_layout, buf.data(), buf.size(), "msm_rtb_layout")){
+        fprintf(fp, "read rtb_layout failed\n");
+        return;
+    }
+    rtb_state_ptr->entries.resize(nentries);
+    for (size_t i = 0; i < nentries; i++){
+        struct rtb_layout layout;
+        memcpy(&layout, buf.data() + i * stride, sizeof(layout));
+        rtb_entry& entry = rtb_state_ptr->entries[i];
+        entry.caller = layout.caller;
+        entry.data = layout.data;
+        entry.timestamp = layout.timestamp;
+        entry.cycle_count = layout.cycle_count;
+        entry.idx = layout.idx;
+        entry.type = layout.log_type & 0x7F;
+        entry.valid = layout.sentinel[0] == 0xFF && layout.sentinel[1] == 0xAA && layout.sentinel[2] == 0xFF
+            && layout.idx != 0 && layout.log_type != 0;
+    }
+    for (const auto& index : rtb_state_ptr->start_idx){
+        rtb_state_ptr->rings.push_back(walk_ring(index));
+    }
 }
 
 void Rtb::print_rtb_log_memory(){
@@ -420,13 +389,52 @@ void Rtb::print_rtb_log_memory(){
     fprintf(fp, "\n");
 }
 
-void Rtb::print_rtb_log(){
+/*
+ * Every ring is in time order already, so a k-way merge over the ring
+ * heads gives the global timeline without sorting all entries.
+ */
+void Rtb::print_rtb_log(const rtb_filter& filter){
     if (rtb_state_ptr->initialized != 1){
         fprintf(fp, "RTB was not initialized in this build.\n");
         return;
     }
-    for (int cpu = 0; cpu < rtb_state_ptr->step_size; cpu++){
-        print_percpu_rtb_log(cpu);
+    if (rtb_state_ptr->entries.empty()){
+        load_rtb_entries();
+    }
+    const std::vector<rtb_entry>& entries = rtb_state_ptr->entries;
+    const std::vector<std::vector<uint32_t>>& rings = rtb_state_ptr->rings;
+    auto match = [&](const rtb_entry& entry) -> bool {
+        double ts = get_timestamp(entry);
+        return (filter.type < 0 || entry.type == filter.type)
+            && (filter.start < 0 || ts >= filter.start)
+            && (filter.end < 0 || ts <= filter.end);
+    };
+    // <timestamp, cpu, position in ring>
+    typedef std::tuple<uint64_t, int, size_t> ring_head;
+    std::priority_queue<ring_head, std::vector<ring_head>, std::greater<ring_head>> heads;
+    for (size_t cpu = 0; cpu < rings.size(); cpu++){
+        if (filter.cpu >= 0 && (int)cpu != filter.cpu) continue;
+        if (!rings[cpu].empty()){
+            heads.emplace(entries[rings[cpu][0]].timestamp, cpu, 0);
+        }
+    }
+    std::vector<std::pair<int, uint32_t>> timeline;
+    while (!heads.empty()){
+        ring_head head = heads.top();
+        heads.pop();
+        int cpu = std::get<1>(head);
+        size_t pos = std::get<2>(head);
+        uint32_t index = rings[cpu][pos];
+        if (match(entries[index])){
+            timeline.emplace_back(cpu, index);
+        }
+        if (++pos < rings[cpu].size()){
+            heads.emplace(entries[rings[cpu][pos]].timestamp, cpu, pos);
+        }
+    }
+    size_t skip = (filter.count && timeline.size() > filter.count) ? timeline.size() - filter.count : 0;
+    for (size_t i = skip; i < timeline.size(); i++){
+        print_rtb_entry(timeline[i].first, entries[timeline[i].second]);
     }
 }
 
@@ -461,5 +469,18 @@ void Rtb::parser_rtb_log(){
     rtb_state_ptr->step_size = INT(rtb_state_buf + field_offset(msm_rtb_state,step_size));
     // fprintf(fp, "enabled:%d initialized:%d \n",rtb_state_ptr->enabled,rtb_state_ptr->initialized);
     FREEBUF(rtb_state_buf);
+    rtb_state_ptr->separate_cpus = (get_config_val("CONFIG_QCOM_RTB_SEPARATE_CPUS") == "y");
+    for (int cpu = 0; cpu < rtb_state_ptr->step_size; cpu++){
+        int index = 0;
+        if (THIS_KERNEL_VERSION >= LINUX(5,10,0)){
+            size_t i = rtb_state_ptr->separate_cpus ? cpu : 0;
+            index = i < rtb_state_ptr->rtb_idx.size() ? rtb_state_ptr->rtb_idx[i] : 0;
+        }else if (rtb_state_ptr->separate_cpus){
+            index = read_int(csymbol_value("msm_rtb_idx_cpu") + kt->__per_cpu_offset[cpu],"msm_rtb_idx_cpu");
+        }else{
+            index = read_int(csymbol_value("msm_rtb_idx"),"msm_rtb_idx");
+        }
+        rtb_state_ptr->start_idx.push_back(index);
+    }
 }
 #pragma GCC diagnostic pop
@@ -41,6 +41,17 @@ struct rtb_layout {
     uint64_t cycle_count;
 } __attribute__ ((__packed__));
 
+/* decoded msm_rtb_layout */
+struct rtb_entry {
+    uint64_t caller;
+    uint64_t data;
+    uint64_t timestamp;
+    uint64_t cycle_count;
+    uint32_t idx;
+    uint8_t type;
+    bool valid;
+};
+
 struct rtb_state {
     std::vector<ulong> rtb_idx;
     ulong rtb_layout;
@@ -51,33 +62,44 @@ struct rtb_state {
     int initialized;
     uint32_t filter;
     int step_size;
+    bool separate_cpus;
+    std::vector<int> start_idx;                 /* write index of each cpu */
+    std::vector<rtb_entry> entries;             /* the whole rtb_layout region */
+    std::vector<std::vector<uint32_t>> rings;   /* entries of each cpu, oldest first */
+};
+
+struct rtb_filter {
+    int cpu = -1;
+    int type = -1;
+    double start = -1;
+    double end = -1;
+    size_t count = 0;   /* only the last count events */
 };
 
 class Rtb : public ParserPlugin {
 private:
     std::shared_ptr<rtb_state> rtb_state_ptr;
+    /* caller -> <function, source line>, info line is a gdb round trip */
+    std::unordered_map<uint64_t, std::pair<std::string, std::string>> caller_cache;
+
+    void load_rtb_entries();
+    std::vector<uint32_t> walk_ring(int index);
+    const std::pair<std::string, std::string>& get_caller_info(uint64_t caller);
+    static int parse_type(const std::string& arg);
+
 public:
     Rtb();
     void cmd_main(void) override;
     void init_offset();
     void parser_rtb_log();
     bool is_enable_rtb();
-    void print_rtb_log();
-    void print_percpu_rtb_log(int cpu);
+    void print_rtb_log(const rtb_filter& filter);
     void print_rtb_log_memory();
-    int print_rtb_layout(int cpu,int index);
+    void print_rtb_entry(int cpu, const rtb_entry& entry);
     int next_rtb_entry(int index);
-    void print_none(int cpu, struct rtb_layout& layout);
-    void print_read_write(int cpu, struct rtb_layout& layout);
-    void print_logbuf(int cpu, struct rtb_layout& layout);
-    void print_hotplug(int cpu, struct rtb_layout& layout);
-    void print_ctxid(int cpu, struct rtb_layout& layout);
-    void print_timestamp(int cpu, struct rtb_layout& layout);
-    void print_l2cpread_write(int cpu, struct rtb_layout& layout);
-    void print_irq(int cpu, struct rtb_layout& layout);
-    std::string get_caller(struct rtb_layout& layout);
-    std::string get_fun_name(struct rtb_layout& layout);
-    double get_timestamp(struct rtb_layout& layout);
+    std::string get_caller(uint64_t caller);
+    std::string get_fun_name(uint64_t caller);
+    double get_timestamp(const rtb_entry& entry);
     DEFINE_PLUGIN_INSTANCE(Rtb)
 };
 
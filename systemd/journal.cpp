@@ -90,7 +90,18 @@ Journal::Journal(){
 void Journal::init_command(){
     field_init(inode,i_dentry);
     field_init(inode,i_sb);
+    field_init(inode,i_mode);
+    field_init(inode,i_size);
+    struct_init(inode);
     field_init(dentry,d_u);
+    field_init(dentry,d_name);
+    field_init(dentry,d_parent);
+    field_init(dentry,d_inode);
+    field_init(dentry,d_subdirs);
+    field_init(dentry,d_child);
+    field_init(dentry,d_children);
+    field_init(dentry,d_sib);
+    field_init(qstr,name);
     cmd_name = "systemd";
     help_str_list={
         "systemd",                            /* command name */
@@ -194,6 +205,7 @@ void Journal::dump_journal_log_from_vma(){
             return;
         }
         write_vma_to_file(pair.second, logfile);
+        fclose(logfile);
         fprintf(fp, "Save %s to %s\n", pair.first.c_str(),log_path.str().c_str());
     }
 }
@@ -233,6 +245,7 @@ void Journal::show_journal_log_from_pagecache(std::string name){
                 return;
             }
             write_pagecache_to_file(pair.second, logfile);
+            fflush(logfile);
             display_journal_log(tmp);
             fclose(logfile);
             close(fd);
@@ -265,6 +278,7 @@ void Journal::show_journal_log_from_vma(std::string name){
                 return;
             }
             write_vma_to_file(pair.second, logfile);
+            fflush(logfile);
             display_journal_log(tmp);
             fclose(logfile);
             close(fd);
@@ -301,63 +315,146 @@ void Journal::display_journal_log(char* filepath){
     sd_journal_close(journal);
 }
 
-void Journal::get_journal_inode_list(){
-    char buf[BUFSIZE];
-    for (const auto& addr : for_each_inode()) {
-        ulong hlist_head = addr + field_offset(inode,i_dentry);
-        int offset = field_offset(dentry,d_u);
-        std::string fileName;
-        for (const auto& dentry : for_each_hlist(hlist_head,offset)) {
-            get_pathname(dentry, buf, BUFSIZE, 1, 0);
-            fileName = buf;
-            if (!fileName.empty()){
-                break;
+/*
+ * Add the inode to log_inode_list if it is a regular file whose dentry
+ * name has ".journal", dentry is set to that dentry.
+ */
+bool Journal::add_journal_inode(ulong addr, const char* ibuf, ulong i_mapping, ulong nrpages, ulong& dentry){
+    if (!S_ISREG(USHORT(ibuf + field_offset(inode,i_mode)))){
+        return false;
+    }
+    ulong first = ULONG(ibuf + field_offset(inode,i_dentry)); // i_dentry.first
+    if (!is_kvaddr(first)){
+        return false;
+    }
+    dentry = first - field_offset(dentry,d_u);
+    ulong name_addr = read_pointer(dentry + field_offset(dentry,d_name) + field_offset(qstr,name),"d_name");
+    if (!is_kvaddr(name_addr)){
+        return false;
+    }
+    std::string fileName = read_cstring(name_addr, 256, "d_name");
+    if (fileName.find(".journal") == std::string::npos){
+        return false;
+    }
+    std::shared_ptr<journal_file> file_ptr = std::make_shared<journal_file>();
+    file_ptr->inode = addr;
+    file_ptr->i_mapping = i_mapping;
+    file_ptr->i_size = ULONGLONG(ibuf + field_offset(inode,i_size));
+    file_ptr->nrpages = nrpages;
+    log_inode_list[fileName] = file_ptr;
+    return true;
+}
+
+/*
+ * Number of ".journal" entries with an inode in the directories which are
+ * not in found. d_subdirs/d_child became d_children/d_sib in 6.8.
+ */
+size_t Journal::count_missing_journals(const std::set<ulong>& dirs, const std::set<ulong>& found){
+    size_t missing = 0;
+    int name_offset = field_offset(dentry,d_name) + field_offset(qstr,name);
+    for (const auto& dir : dirs) {
+        std::vector<ulong> children;
+        if (field_offset(dentry,d_subdirs) != -1){
+            children = for_each_list(dir + field_offset(dentry,d_subdirs), field_offset(dentry,d_child));
+        } else if (field_offset(dentry,d_children) != -1){
+            children = for_each_hlist(dir + field_offset(dentry,d_children), field_offset(dentry,d_sib));
+        }
+        for (const auto& child : children) {
+            ulong d_inode = read_pointer(child + field_offset(dentry,d_inode),"d_inode");
+            if (!is_kvaddr(d_inode) || found.find(d_inode) != found.end()){
+                continue;
+            }
+            ulong name_addr = read_pointer(child + name_offset,"d_name");
+            if (is_kvaddr(name_addr) && read_cstring(name_addr, 256, "d_name").find(".journal") != std::string::npos){
+                missing++;
             }
         }
-        if (fileName.empty() || fileName.find(".journal") == std::string::npos){
-            continue;
+    }
+    return missing;
+}
+
+/*
+ * Walk the inodes of every super_block instead of scanning all pfns, only
+ * regular files with page cache get their dentry name read. The pfn scan
+ * is still used when the walk finds no journal file, or when the journal
+ * directories have entries the walk did not find.
+ */
+void Journal::get_journal_inode_list(){
+    std::set<ulong> found;
+    std::set<ulong> dirs;
+    for_each_cached_inode([&](ulong addr, const char* ibuf, ulong i_mapping, ulong nrpages) {
+        ulong dentry = 0;
+        if (add_journal_inode(addr, ibuf, i_mapping, nrpages, dentry)){
+            found.insert(addr);
+            dirs.insert(read_pointer(dentry + field_offset(dentry,d_parent),"d_parent"));
         }
-        size_t pos = fileName.find_last_of("/\\");
-        if (pos != std::string::npos) {
-            fileName = fileName.substr(pos + 1);
+    });
+    if (!log_inode_list.empty()){
+        size_t missing = count_missing_journals(dirs, found);
+        if (missing == 0){
+            return;
         }
-        // fprintf(fp, "%s\n", fileName.c_str());
-        ulong i_mapping = read_pointer(addr + field_offset(inode,i_mapping),"i_mapping");
-        if (!is_kvaddr(i_mapping)) {
+        fprintf(fp, "%zu journal files are not on any super_block, scan the pfns\n", missing);
+    }
+    int inode_size = struct_size(inode);
+    if (inode_size <= 0){
+        return;
+    }
+    std::vector<char> buf(inode_size);
+    for (const auto& addr : for_each_inode_by_pfn()) {
+        if (found.find(addr) != found.end() || !read_struct(addr, buf.data(), inode_size, "inode")){
             continue;
         }
-        int i_pages_offset = field_offset(address_space,i_pages);
-        if (i_pages_offset == -1){
-            i_pages_offset = field_offset(address_space,page_tree);
-        }
-        std::string i_pages_type = MEMBER_TYPE_NAME(TO_CONST_STRING("address_space"), TO_CONST_STRING("i_pages"));
-        std::vector<ulong> pagelist = (i_pages_type == "xarray" ? for_each_xarray(i_mapping + i_pages_offset): for_each_radix(i_mapping + i_pages_offset));
-        if(pagelist.size() == 0){
+        ulong i_mapping = ULONG(buf.data() + field_offset(inode,i_mapping));
+        if (!is_kvaddr(i_mapping)){
             continue;
         }
-        log_inode_list[fileName] = i_mapping;
+        ulong nrpages = read_ulong(i_mapping + field_offset(address_space,nrpages),"nrpages");
+        ulong dentry = 0;
+        add_journal_inode(addr, buf.data(), i_mapping, nrpages, dentry);
     }
 }
 
-bool Journal::write_pagecache_to_file(ulong i_mapping, FILE* logfile){
-    int i_pages_offset = field_offset(address_space,i_pages);
-    if (i_pages_offset == -1){
-        i_pages_offset = field_offset(address_space,page_tree);
-    }
-    char page_data[page_size];
-    BZERO(&page_data, page_size);
-    std::string i_pages_type = MEMBER_TYPE_NAME(TO_CONST_STRING("address_space"), TO_CONST_STRING("i_pages"));
-    std::vector<ulong> pagelist = (i_pages_type == "xarray" ? for_each_xarray(i_mapping + i_pages_offset): for_each_radix(i_mapping + i_pages_offset));
-    for(const auto& page_addr : pagelist){
-        // fprintf(fp, "page: %#lx \n", page_addr);
-        physaddr_t phyaddr = page_to_phy(page_addr);
-        char* buf = (char*)read_memory(phyaddr, page_size, "file cache",false);
-        if (buf != nullptr){
-            fwrite(buf, page_size, 1, logfile);
-            FREEBUF(buf);
-        }else{
-            fwrite(page_data, page_size, 1, logfile);
+/*
+ * Every page goes to its own file offset by index, pages which are not
+ * cached stay as holes. Pages next to each other in both the file and
+ * physical memory are read in one go.
+ */
+bool Journal::write_pagecache_to_file(std::shared_ptr<journal_file> file_ptr, FILE* logfile){
+    std::vector<std::pair<ulong, ulong>> pagelist = for_each_cache_page(file_ptr->i_mapping);
+    std::vector<physaddr_t> phy_list(pagelist.size());
+    for (size_t i = 0; i < pagelist.size(); i++) {
+        phy_list[i] = page_to_phy(pagelist[i].second);
+    }
+    std::vector<char> buf(JOURNAL_READ_BATCH * page_size);
+    size_t i = 0;
+    while (i < pagelist.size()) {
+        ulong index = pagelist[i].first;
+        physaddr_t phyaddr = phy_list[i];
+        size_t cnt = 1;
+        while (i + cnt < pagelist.size() && cnt < JOURNAL_READ_BATCH
+            && pagelist[i + cnt].first == index + cnt
+            && phy_list[i + cnt] == phyaddr + cnt * page_size) {
+            cnt++;
         }
+        if (read_struct(phyaddr, buf.data(), cnt * page_size, "file cache", false)) {
+            fseeko(logfile, (off_t)index * page_size, SEEK_SET);
+            fwrite(buf.data(), page_size, cnt, logfile);
+        } else {
+            for (size_t j = 0; j < cnt; j++) {
+                if (!read_struct(phyaddr + j * page_size, buf.data(), page_size, "file cache", false)) {
+                    continue;
+                }
+                fseeko(logfile, (off_t)(index + j) * page_size, SEEK_SET);
+                fwrite(buf.data(), page_size, 1, logfile);
+            }
+        }
+        i += cnt;
+    }
+    // trailing pages which are not cached are holes as well
+    fflush(logfile);
+    if (file_ptr->i_size > 0 && ftruncate(fileno(logfile), file_ptr->i_size) != 0) {
+        fprintf(fp, "Can't resize to %lu\n", file_ptr->i_size);
     }
     return true;
 }
@@ -377,6 +474,7 @@ void Journal::dump_journal_log_from_pagecache(){
             return;
         }
         write_pagecache_to_file(pair.second, logfile);
+        fclose(logfile);
         fprintf(fp, "Save %s to %s\n", pair.first.c_str(),log_path.str().c_str());
     }
 }
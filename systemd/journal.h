@@ -20,10 +20,19 @@
 #include "utils/utask.h"
 #include <systemd/sd-journal.h>
 
+#define JOURNAL_READ_BATCH 256  /* physically contiguous pages per read */
+
+struct journal_file {
+    ulong inode;
+    ulong i_mapping;
+    ulong i_size;
+    ulong nrpages;
+};
+
 class Journal : public ParserPlugin {
 private:
     std::unordered_map<std::string, std::vector<std::shared_ptr<vma_struct>>> log_vma_list;
-    std::unordered_map<std::string, ulong> log_inode_list;
+    std::unordered_map<std::string, std::shared_ptr<journal_file>> log_inode_list;
     static const int DUMP_LOG = 1 << 1;
     static const int LIST_LOG = 1 << 2;
     static const int SHOW_LOG = 1 << 3;
@@ -34,8 +43,10 @@ private:
     struct task_context *tc_systemd_journal = nullptr;
     void get_journal_vma_list();
     bool write_vma_to_file(std::vector<std::shared_ptr<vma_struct>> vma_list, FILE* logfile);
+    bool add_journal_inode(ulong addr, const char* ibuf, ulong i_mapping, ulong nrpages, ulong& dentry);
+    size_t count_missing_journals(const std::set<ulong>& dirs, const std::set<ulong>& found);
     void get_journal_inode_list();
-    bool write_pagecache_to_file(ulong i_mapping, FILE* logfile);
+    bool write_pagecache_to_file(std::shared_ptr<journal_file> file_ptr, FILE* logfile);
 
 public:
     Journal(std::shared_ptr<Swapinfo> swap);
@@ -26,7 +26,7 @@ void TaskSched::cmd_main(void) {
     int c;
     std::string cppString;
     if (argcnt < 2) cmd_usage(pc->curcmd, SYNOPSIS);
-    while ((c = getopt(argcnt, args, "c:")) != EOF) {
+    while ((c = getopt(argcnt, args, "c:al")) != EOF) {
         switch(c) {
             case 'c':
             {
@@ -41,6 +41,12 @@ void TaskSched::cmd_main(void) {
                 print_task_timestamps(cpu);
                 break;
             }
+            case 'a':
+                print_all_timestamps();
+                break;
+            case 'l':
+                print_latency_histogram();
+                break;
             default:
                 argerrs++;
                 break;
@@ -51,11 +57,27 @@ void TaskSched::cmd_main(void) {
 }
 
 TaskSched::TaskSched(){
+    field_init(task_struct,prio);
+    field_init(task_struct,sched_info);
+    field_init(task_struct,last_enqueued_ts);
+    field_init(task_struct,last_sleep_ts);
+    field_init(task_struct,wts);
+    field_init(task_struct,android_vendor_data1);
+    field_init(sched_info,last_arrival);
+    field_init(sched_info,last_queued);
+    field_init(sched_info,pcount);
+    field_init(sched_info,run_delay);
+    struct_init(sched_info);
+    field_init(walt_task_struct,last_enqueued_ts);
+    field_init(walt_task_struct,last_sleep_ts);
+    struct_init(walt_task_struct);
     cmd_name = "sched";
     help_str_list={
         "sched",                            /* command name */
         "dump task sched information",        /* short description */
-        "-c \n"
+        "-c <cpu>\n"
+            "  sched -a\n"
+            "  sched -l\n"
             "  This command dumps the task sched info.",
         "\n",
         "EXAMPLES",
@@ -66,54 +88,152 @@ TaskSched::TaskSched(){
         "    idle_inject/3        44      3     0.0894034       0               0               3          49    IN    0               0               0",
         "    oom_reaper           61      3     0.591827        0               1.6563e-05      2          120   IN    0               0               0",
         "\n",
+        "  Display task sched info of all cpus:",
+        "    %s> sched -a",
+        "\n",
+        "  Display the average run delay histogram of every cpu:",
+        "    %s> sched -l",
+        "    CPU  Tasks  <10us  <100us <1ms   <10ms  <100ms >=100ms Avg_delay(ms) Max_delay(ms)",
+        "    0    412    187    141    63     17     3      1       0.213         146.208",
+        "    1    389    201    122    51     13     2      0       0.157         42.771",
+        "\n",
     };
     initialize();
 }
 
-void TaskSched::print_task_timestamps(int cpu){
-    std::vector<std::shared_ptr<schedinfo>> task_list;
-    for(ulong task_addr: for_each_threads()){
-        struct task_context *tc = task_to_context(task_addr);
-        if(!tc || tc->processor != cpu){
+void TaskSched::init_layout(){
+    layout.prio = field_offset(task_struct,prio);
+    int sched_info_offset = field_offset(task_struct,sched_info);
+    if (struct_size(sched_info) != -1 && sched_info_offset != -1){
+        layout.last_arrival = sched_info_offset + field_offset(sched_info,last_arrival);
+        layout.last_queued = sched_info_offset + field_offset(sched_info,last_queued);
+        layout.pcount = sched_info_offset + field_offset(sched_info,pcount);
+        layout.run_delay = sched_info_offset + field_offset(sched_info,run_delay);
+    }
+    layout.last_enqueued = field_offset(task_struct,last_enqueued_ts);
+    layout.last_sleep = field_offset(task_struct,last_sleep_ts);
+    if ((layout.last_enqueued == -1 || layout.last_sleep == -1)
+        && get_config_val("CONFIG_SCHED_WALT") == "y" && struct_size(walt_task_struct) != -1){
+        int wts_offset = field_offset(task_struct,wts);
+        if (wts_offset == -1){
+            wts_offset = field_offset(task_struct,android_vendor_data1);
+        }
+        if (wts_offset != -1){
+            if (layout.last_enqueued == -1){
+                layout.last_enqueued = wts_offset + field_offset(walt_task_struct,last_enqueued_ts);
+            }
+            if (layout.last_sleep == -1){
+                layout.last_sleep = wts_offset + field_offset(walt_task_struct,last_sleep_ts);
+            }
+        }
+    }
+    int start = INT_MAX;
+    int end = 0;
+    for (int offset : {layout.prio, layout.last_arrival, layout.last_queued, layout.pcount,
+                       layout.run_delay, layout.last_enqueued, layout.last_sleep}) {
+        if (offset < 0){
             continue;
         }
-        std::shared_ptr<schedinfo> sched_ptr = std::make_shared<schedinfo>();
-        sched_ptr->tc = tc;
-        sched_ptr->task_prio = read_uint(task_addr + field_offset(task_struct,prio),"prio");
-        if(struct_size(sched_info) != -1){
-            sched_ptr->last_arrival = read_ulonglong(task_addr + field_offset(task_struct, sched_info) + field_offset(sched_info, last_arrival), "last_arrival");
-            sched_ptr->last_queued = read_ulonglong(task_addr + field_offset(task_struct, sched_info) + field_offset(sched_info, last_queued), "last_queued");
-            sched_ptr->pcount = read_uint(task_addr + field_offset(task_struct, sched_info) + field_offset(sched_info, pcount), "pcount");
-            sched_ptr->run_delay = read_ulonglong(task_addr + field_offset(task_struct, sched_info) + field_offset(sched_info, run_delay), "run_delay");
+        start = std::min(start, offset);
+        end = std::max(end, offset + (int)sizeof(uint64_t));
+    }
+    layout.span_start = (start == INT_MAX) ? 0 : start;
+    layout.span_end = std::max(end, layout.span_start);
+}
+
+/*
+ * One read_struct of the task_struct span per thread, the result is a flat
+ * table partitioned by cpu which all the commands share. The run delay
+ * histograms are built in the same pass.
+ */
+void TaskSched::load_sched_table(){
+    if (loaded){
+        return;
+    }
+    loaded = true;
+    init_layout();
+    size_t span_len = layout.span_end - layout.span_start;
+    std::vector<char> buf(span_len);
+    auto u64_at = [&](int offset) -> uint64_t {
+        return offset < 0 ? 0 : ULONGLONG(buf.data() + offset - layout.span_start);
+    };
+    auto u32_at = [&](int offset) -> uint32_t {
+        return offset < 0 ? 0 : UINT(buf.data() + offset - layout.span_start);
+    };
+    int max_cpu = -1;
+    for (ulong task_addr : for_each_threads()) {
+        struct task_context *tc = task_to_context(task_addr);
+        if (!tc){
+            continue;
         }
-        if(field_offset(task_struct, last_enqueued_ts) != -1){
-            sched_ptr->last_enqueued = read_ulonglong(task_addr + field_offset(task_struct, last_enqueued_ts), "last_enqueued_ts");
-        } else {
-            if (get_config_val("CONFIG_SCHED_WALT") == "y" && struct_size(walt_task_struct) != -1) {
-                if(field_offset(task_struct, wts) != -1){
-                    sched_ptr->last_enqueued = read_ulonglong(task_addr + field_offset(task_struct, wts) + field_offset(walt_task_struct, last_enqueued_ts), "last_enqueued_ts");
-                }else{
-                    sched_ptr->last_enqueued = read_ulonglong(task_addr + field_offset(task_struct, android_vendor_data1) + field_offset(walt_task_struct, last_enqueued_ts), "last_enqueued_ts");
-                }
-            }
+        if (span_len > 0 && !read_struct(task_addr + layout.span_start, buf.data(), span_len, "task_struct")){
+            continue;
         }
-        if(field_offset(task_struct, last_sleep_ts) != -1){
-            sched_ptr->last_sleep = read_ulonglong(task_addr + field_offset(task_struct, last_sleep_ts), "last_sleep_ts");
-        } else {
-            if (get_config_val("CONFIG_SCHED_WALT") == "y" && struct_size(walt_task_struct) != -1) {
-                if(field_offset(task_struct, wts) != -1){
-                    sched_ptr->last_sleep = read_ulonglong(task_addr + field_offset(task_struct, wts) + field_offset(walt_task_struct, last_sleep_ts), "last_sleep_ts");
-                }else{
-                    sched_ptr->last_sleep = read_ulonglong(task_addr + field_offset(task_struct, android_vendor_data1) + field_offset(walt_task_struct, last_sleep_ts), "last_sleep_ts");
-                }
-            }
+        schedinfo info;
+        info.tc = tc;
+        info.cpu = tc->processor;
+        info.task_prio = u32_at(layout.prio);
+        info.last_arrival = u64_at(layout.last_arrival);
+        info.last_queued = u64_at(layout.last_queued);
+        info.pcount = u32_at(layout.pcount);
+        info.run_delay = u64_at(layout.run_delay);
+        info.last_enqueued = u64_at(layout.last_enqueued);
+        info.last_sleep = u64_at(layout.last_sleep);
+        if (info.last_enqueued < info.last_sleep){
+            info.runtime = info.last_sleep - info.last_enqueued;
         }
-        if (sched_ptr->last_enqueued < sched_ptr->last_sleep){
-            sched_ptr->runtime = sched_ptr->last_sleep - sched_ptr->last_enqueued;
+        max_cpu = std::max(max_cpu, info.cpu);
+        sched_table.push_back(info);
+    }
+    std::sort(sched_table.begin(), sched_table.end(),[&](const schedinfo& a, const schedinfo& b){
+        return a.cpu != b.cpu ? a.cpu < b.cpu : a.last_arrival < b.last_arrival;
+    });
+    cpu_start.assign(max_cpu + 2, 0);
+    cpu_latency.assign(max_cpu + 1, sched_latency());
+    static const uint64_t bounds[SCHED_LAT_BUCKETS - 1] = {10000, 100000, 1000000, 10000000, 100000000};
+    for (const auto& info : sched_table) {
+        cpu_start[info.cpu + 1]++;
+        if (info.pcount == 0){
+            continue;
         }
-        task_list.push_back(sched_ptr);
+        sched_latency& lat = cpu_latency[info.cpu];
+        uint64_t delay = info.run_delay / info.pcount;
+        size_t bucket = std::upper_bound(bounds, bounds + SCHED_LAT_BUCKETS - 1, delay) - bounds;
+        lat.buckets[bucket]++;
+        lat.tasks++;
+        lat.run_delay += info.run_delay;
+        lat.pcount += info.pcount;
+        lat.max_delay = std::max(lat.max_delay, delay);
     }
-    std::ostringstream oss;
+    for (size_t i = 1; i < cpu_start.size(); i++) {
+        cpu_start[i] += cpu_start[i - 1];
+    }
+}
+
+void TaskSched::print_cpu_tasks(int cpu, std::ostringstream& oss){
+    if (cpu < 0 || cpu + 1 >= (int)cpu_start.size()){
+        return;
+    }
+    for (size_t i = cpu_start[cpu]; i < cpu_start[cpu + 1]; i++) {
+        const schedinfo& info = sched_table[i];
+        char buf1[BUFSIZE];
+        char buf2[BUFSIZE];
+        oss << std::left << std::setw(20)   << info.tc->comm << " "
+            << std::left << std::setw(7)    << info.tc->pid << " "
+            << std::left << std::setw(3)    << task_cpu(info.tc->processor, buf2, !VERBOSE) << " "
+            << std::left << std::setw(15)   << (double)info.last_arrival/1000000000.0 << " "
+            << std::left << std::setw(15)   << (double)info.last_queued/1000000000.0 << " "
+            << std::left << std::setw(15)   << (double)info.run_delay/1000000000.0 << " "
+            << std::left << std::setw(10)   << info.pcount << " "
+            << std::left << std::setw(5)    << info.task_prio << " "
+            << std::left << std::setw(5)    << task_state_string(info.tc->task, buf1, !VERBOSE) << " "
+            << std::left << std::setw(15)   << (double)info.last_enqueued/1000000000.0 << " "
+            << std::left << std::setw(15)   << (double)info.last_sleep/1000000000.0 << " "
+            << std::left << std::setw(15)   << (double)info.runtime/1000000.0 << "\n";
+    }
+}
+
+static void print_sched_header(std::ostringstream& oss){
     oss << std::left << std::setw(20)   << "Name" << " "
         << std::left << std::setw(7)    << "pid" << " "
         << std::left << std::setw(3)    << "cpu" << " "
@@ -126,29 +246,47 @@ void TaskSched::print_task_timestamps(int cpu){
         << std::left << std::setw(15)   << "Last_enqueued_ts" << " "
         << std::left << std::setw(15)   << "Last_sleep_ts" << " "
         << std::left << std::setw(15)   << "Last_runtime" << "\n";
-    if (task_list.size() == 0){
+}
+
+void TaskSched::print_task_timestamps(int cpu){
+    load_sched_table();
+    if (cpu < 0 || cpu + 1 >= (int)cpu_start.size() || cpu_start[cpu] == cpu_start[cpu + 1]){
         return;
     }
-    std::sort(task_list.begin(), task_list.end(),[&](const std::shared_ptr<schedinfo>& a, const std::shared_ptr<schedinfo>& b){
-        return a->last_arrival < b->last_arrival;
-    });
-    for (const auto& sched_ptr : task_list) {
-        char buf1[BUFSIZE];
-        char buf2[BUFSIZE];
-        oss << std::left << std::setw(20)   << sched_ptr->tc->comm << " "
-            << std::left << std::setw(7)    << sched_ptr->tc->pid << " "
-            << std::left << std::setw(3)    << task_cpu(sched_ptr->tc->processor, buf2, !VERBOSE) << " "
-            << std::left << std::setw(15)   << (double)sched_ptr->last_arrival/1000000000.0 << " "
-            << std::left << std::setw(15)   << (double)sched_ptr->last_queued/1000000000.0 << " "
-            << std::left << std::setw(15)   << (double)sched_ptr->run_delay/1000000000.0 << " "
-            << std::left << std::setw(10)   << sched_ptr->pcount << " "
-            << std::left << std::setw(5)    << sched_ptr->task_prio << " "
-            << std::left << std::setw(5)    << task_state_string(sched_ptr->tc->task, buf1, !VERBOSE) << " "
-            << std::left << std::setw(15)   << (double)sched_ptr->last_enqueued/1000000000.0 << " "
-            << std::left << std::setw(15)   << (double)sched_ptr->last_sleep/1000000000.0 << " "
-            << std::left << std::setw(15)   << (double)sched_ptr->runtime/1000000.0 << "\n";
+    std::ostringstream oss;
+    print_sched_header(oss);
+    print_cpu_tasks(cpu, oss);
+    fprintf(fp, "%s \n", oss.str().c_str());
+}
+
+void TaskSched::print_all_timestamps(){
+    load_sched_table();
+    if (sched_table.size() == 0){
+        return;
+    }
+    std::ostringstream oss;
+    print_sched_header(oss);
+    for (size_t cpu = 0; cpu + 1 < cpu_start.size(); cpu++) {
+        print_cpu_tasks(cpu, oss);
     }
     fprintf(fp, "%s \n", oss.str().c_str());
 }
 
+void TaskSched::print_latency_histogram(){
+    load_sched_table();
+    if (layout.run_delay == -1){
+        fprintf(fp, "sched_info is not enabled in this kernel\n");
+        return;
+    }
+    fprintf(fp, "%-4s %-6s %-6s %-6s %-6s %-6s %-6s %-7s %-13s %s\n",
+        "CPU", "Tasks", "<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms", "Avg_delay(ms)", "Max_delay(ms)");
+    for (size_t cpu = 0; cpu < cpu_latency.size(); cpu++) {
+        const sched_latency& lat = cpu_latency[cpu];
+        double avg = lat.pcount ? (double)lat.run_delay / lat.pcount / 1000000.0 : 0;
+        fprintf(fp, "%-4zu %-6zu %-6zu %-6zu %-6zu %-6zu %-6zu %-7zu %-13.3f %.3f\n",
+            cpu, lat.tasks, lat.buckets[0], lat.buckets[1], lat.buckets[2], lat.buckets[3],
+            lat.buckets[4], lat.buckets[5], avg, lat.max_delay / 1000000.0);
+    }
+}
+
 #pragma GCC diagnostic pop
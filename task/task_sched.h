@@ -18,8 +18,11 @@
 
 #include "plugin.h"
 
+#define SCHED_LAT_BUCKETS 6     /* <10us <100us <1ms <10ms <100ms >=100ms */
+
 struct schedinfo {
     struct task_context *tc;
+    int cpu = 0;
     uint32_t task_prio = 0;
     uint64_t last_arrival = 0;
     uint64_t last_queued = 0;
@@ -30,10 +33,48 @@ struct schedinfo {
     uint64_t runtime = 0;
 };
 
+/* average run delay histogram of the tasks of one cpu */
+struct sched_latency {
+    size_t buckets[SCHED_LAT_BUCKETS] = {};
+    size_t tasks = 0;
+    uint64_t run_delay = 0;
+    uint64_t pcount = 0;
+    uint64_t max_delay = 0;     /* worst average delay of a task */
+};
+
+/*
+ * Layout of the task_struct fields we need, resolved once. Every offset
+ * is relative to task_struct, -1 when the kernel doesn't have the field.
+ */
+struct sched_layout {
+    int prio = -1;
+    int last_arrival = -1;
+    int last_queued = -1;
+    int pcount = -1;
+    int run_delay = -1;
+    int last_enqueued = -1;
+    int last_sleep = -1;
+    int span_start = 0;         /* the fields above all lie in [span_start, span_end) */
+    int span_end = 0;
+};
+
 class TaskSched : public ParserPlugin {
+private:
+    bool loaded = false;
+    sched_layout layout;
+    std::vector<schedinfo> sched_table;     /* ordered by cpu, then last_arrival */
+    std::vector<size_t> cpu_start;          /* tasks of cpu n are [cpu_start[n], cpu_start[n + 1]) */
+    std::vector<sched_latency> cpu_latency;
+
+    void init_layout();
+    void load_sched_table();
+    void print_cpu_tasks(int cpu, std::ostringstream& oss);
+
 public:
     TaskSched();
     void print_task_timestamps(int cpu);
+    void print_all_timestamps();
+    void print_latency_histogram();
     void cmd_main(void) override;
     DEFINE_PLUGIN_INSTANCE(TaskSched)
 };
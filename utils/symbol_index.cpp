@@ -0,0 +1,353 @@
+/**
+ * Copyright (c) 2024-2025 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "symbol_index.h"
+#include <fcntl.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpointer-arith"
+
+SymbolIndex& SymbolIndex::instance(){
+    static SymbolIndex index;
+    return index;
+}
+
+std::string SymbolIndex::basename(const std::string& name){
+    size_t last_slash = name.find_last_of('/');
+    std::string res = (last_slash == std::string::npos) ? name : name.substr(last_slash + 1);
+    res.erase(std::remove(res.begin(), res.end(), '\0'), res.end());
+    return res;
+}
+
+template<typename Ehdr, typename Phdr>
+static std::string parse_build_id(std::function<bool (size_t off, void* buf, size_t len)> read_fn){
+    Ehdr ehdr;
+    if (!read_fn(0, &ehdr, sizeof(ehdr)) || ehdr.e_phentsize != sizeof(Phdr)){
+        return "";
+    }
+    for (size_t i = 0; i < ehdr.e_phnum; i++){
+        Phdr phdr;
+        if (!read_fn(ehdr.e_phoff + i * sizeof(Phdr), &phdr, sizeof(phdr))){
+            return "";
+        }
+        if (phdr.p_type != PT_NOTE || phdr.p_filesz == 0 || phdr.p_filesz > 0x10000){
+            continue;
+        }
+        std::vector<char> notes(phdr.p_filesz);
+        if (!read_fn(phdr.p_offset, notes.data(), notes.size())){
+            continue;
+        }
+        size_t pos = 0;
+        while (pos + sizeof(Elf32_Nhdr) <= notes.size()){
+            Elf32_Nhdr* nhdr = reinterpret_cast<Elf32_Nhdr*>(notes.data() + pos);
+            size_t name_pos = pos + sizeof(Elf32_Nhdr);
+            size_t desc_pos = name_pos + roundup(nhdr->n_namesz, 4);
+            pos = desc_pos + roundup(nhdr->n_descsz, 4);
+            if (pos > notes.size()){
+                break;
+            }
+            if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4
+                && memcmp(notes.data() + name_pos, "GNU", 4) == 0){
+                std::ostringstream oss;
+                for (size_t j = 0; j < nhdr->n_descsz; j++){
+                    oss << std::hex << std::setw(2) << std::setfill('0')
+                        << (static_cast<uint32_t>(notes[desc_pos + j]) & 0xff);
+                }
+                return oss.str();
+            }
+        }
+    }
+    return "";
+}
+
+/*
+ * Get the GNU build-id from the PT_NOTE segments, read_fn reads the ELF
+ * image by file offset, so it works for files and mapped libraries alike.
+ */
+std::string SymbolIndex::read_build_id(std::function<bool (size_t off, void* buf, size_t len)> read_fn){
+    unsigned char ident[EI_NIDENT];
+    if (!read_fn(0, ident, sizeof(ident)) || memcmp(ident, ELFMAG, SELFMAG) != 0){
+        return "";
+    }
+    if (ident[EI_CLASS] == ELFCLASS64){
+        return parse_build_id<Elf64_Ehdr, Elf64_Phdr>(read_fn);
+    }
+    return parse_build_id<Elf32_Ehdr, Elf32_Phdr>(read_fn);
+}
+
+std::string SymbolIndex::read_build_id(const std::string& path){
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0){
+        return "";
+    }
+    std::string build_id = read_build_id([&](size_t off, void* buf, size_t len) -> bool {
+        return pread(fd, buf, len, off) == static_cast<ssize_t>(len);
+    });
+    close(fd);
+    return build_id;
+}
+
+void SymbolIndex::add_file(const std::string& path, const std::string& build_id){
+    file_list.push_back(std::make_pair(path, build_id));
+    name_index[basename(path)].push_back(path);
+    if (!build_id.empty()){
+        build_id_index.emplace(build_id, path);
+    }
+}
+
+void SymbolIndex::walk(const std::string& dir){
+    struct stat dir_stat;
+    if (stat(dir.c_str(), &dir_stat) != 0){
+        return;
+    }
+    dir_list.push_back({dir, dir_stat.st_mtim.tv_sec, dir_stat.st_mtim.tv_nsec});
+    DIR* dirp = opendir(dir.c_str());
+    if (!dirp) {
+        return;
+    }
+    struct dirent* dp;
+    while ((dp = readdir(dirp))) {
+        std::string entry_name(dp->d_name);
+        if (entry_name == "." || entry_name == "..") {
+            continue;
+        }
+        std::string full_path = dir + "/" + entry_name;
+        if (dp->d_type == DT_DIR) {
+            walk(full_path);
+            continue;
+        }
+        // follow links to files, but not to directories to avoid loops
+        struct stat file_stat;
+        if (dp->d_type == DT_REG
+            || ((dp->d_type == DT_LNK || dp->d_type == DT_UNKNOWN) && stat(full_path.c_str(), &file_stat) == 0 && S_ISREG(file_stat.st_mode))) {
+            add_file(full_path, "");
+        } else if (dp->d_type == DT_UNKNOWN && stat(full_path.c_str(), &file_stat) == 0 && S_ISDIR(file_stat.st_mode)) {
+            walk(full_path);
+        }
+    }
+    closedir(dirp);
+}
+
+/*
+ * Read the build-id of every file whose name is not unique in the tree,
+ * so opening the files is limited to the names a lookup can't tell apart.
+ */
+void SymbolIndex::read_build_ids(){
+    for (auto& file : file_list) {
+        if (name_index[basename(file.first)].size() < 2){
+            continue;
+        }
+        file.second = read_build_id(file.first);
+        if (!file.second.empty()){
+            build_id_index.emplace(file.second, file.first);
+        }
+    }
+}
+
+/*
+ * The disk cache is only used when CRASH_SYMBOL_CACHE names a directory,
+ * the symbols tree itself may be read-only.
+ */
+std::string SymbolIndex::cache_path(const std::string& dir){
+    const char* cache_dir = getenv(SYMBOL_INDEX_ENV);
+    if (!cache_dir || cache_dir[0] == '\0'){
+        return "";
+    }
+    std::ostringstream oss;
+    oss << cache_dir << "/" << SYMBOL_INDEX_CACHE << "." << std::hex << std::hash<std::string>{}(dir);
+    return oss.str();
+}
+
+bool SymbolIndex::dirs_unchanged(){
+    for (const auto& sdir : dir_list) {
+        struct stat dir_stat;
+        if (stat(sdir.path.c_str(), &dir_stat) != 0
+            || dir_stat.st_mtim.tv_sec != sdir.mtime_sec
+            || dir_stat.st_mtim.tv_nsec != sdir.mtime_nsec){
+            return false;
+        }
+    }
+    return !dir_list.empty();
+}
+
+/*
+ * Cache file layout, one record per line:
+ *   V <version>
+ *   R <root>
+ *   D <mtime_sec> <mtime_nsec> <dir>
+ *   F <build-id or -> <path>
+ */
+bool SymbolIndex::load_cache(const std::string& dir){
+    std::string path = cache_path(dir);
+    FILE* cache = path.empty() ? nullptr : fopen(path.c_str(), "r");
+    if (!cache){
+        return false;
+    }
+    char* line = nullptr;
+    size_t line_size = 0;
+    ssize_t len;
+    int version = 0;
+    std::string cache_root;
+    while ((len = getline(&line, &line_size, cache)) != -1) {
+        if (len > 0 && line[len - 1] == '\n'){
+            line[--len] = '\0';
+        }
+        if (len < 2){
+            continue;
+        }
+        char* arg = line + 2;
+        switch (line[0]) {
+            case 'V':
+                version = atoi(arg);
+                break;
+            case 'R':
+                cache_root = arg;
+                break;
+            case 'D':
+            {
+                symbol_dir sdir;
+                char* end = nullptr;
+                sdir.mtime_sec = strtoll(arg, &end, 10);
+                sdir.mtime_nsec = strtol(end, &end, 10);
+                if (*end == ' '){
+                    sdir.path = end + 1;
+                    dir_list.push_back(sdir);
+                }
+                break;
+            }
+            case 'F':
+            {
+                char* sep = strchr(arg, ' ');
+                if (sep){
+                    std::string build_id(arg, sep - arg);
+                    add_file(sep + 1, build_id == "-" ? "" : build_id);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    std::free(line);
+    fclose(cache);
+    bool valid = (version == SYMBOL_INDEX_VERSION && cache_root == dir && dirs_unchanged());
+    if (!valid){
+        if (debug) fprintf(fp, "symbol index cache %s is stale\n", path.c_str());
+        reset();
+    }
+    return valid;
+}
+
+void SymbolIndex::save_cache(){
+    std::string path = cache_path(root);
+    FILE* cache = path.empty() ? nullptr : fopen(path.c_str(), "w");
+    if (!cache){
+        return;
+    }
+    fprintf(cache, "V %d\n", SYMBOL_INDEX_VERSION);
+    fprintf(cache, "R %s\n", root.c_str());
+    for (const auto& sdir : dir_list) {
+        fprintf(cache, "D %lld %ld %s\n", (long long)sdir.mtime_sec, sdir.mtime_nsec, sdir.path.c_str());
+    }
+    for (const auto& file : file_list) {
+        fprintf(cache, "F %s %s\n", file.second.empty() ? "-" : file.second.c_str(), file.first.c_str());
+    }
+    fclose(cache);
+}
+
+bool SymbolIndex::load(const std::string& dir){
+    if (dir.empty()){
+        return false;
+    }
+    if (dir == root){
+        if (checked){
+            return true;
+        }
+        checked = true;
+        if (dirs_unchanged()){
+            return true;
+        }
+        if (debug) fprintf(fp, "symbol index %s changed\n", dir.c_str());
+    }
+    reset();
+    struct stat dir_stat;
+    if (stat(dir.c_str(), &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode)) {
+        return false;
+    }
+    bool cached = load_cache(dir);
+    if (!cached){
+        walk(dir);
+        read_build_ids();
+    }
+    root = dir;
+    checked = true;
+    if (!cached){
+        save_cache();
+    }
+    if (debug) fprintf(fp, "symbol index %s: %zu dirs %zu files %zu build-ids\n",
+        dir.c_str(), dir_list.size(), file_list.size(), build_id_index.size());
+    return true;
+}
+
+/*
+ * Called at the end of a command, the next lookup checks the directory
+ * mtimes once before the index is trusted again.
+ */
+void SymbolIndex::recheck(){
+    checked = false;
+}
+
+void SymbolIndex::reset(){
+    root.clear();
+    checked = false;
+    dir_list.clear();
+    file_list.clear();
+    name_index.clear();
+    build_id_index.clear();
+}
+
+const std::vector<std::string>* SymbolIndex::find_all(const std::string& dir, const std::string& name){
+    if (!load(dir)){
+        return nullptr;
+    }
+    auto it = name_index.find(basename(name));
+    if (it == name_index.end()){
+        return nullptr;
+    }
+    return &it->second;
+}
+
+bool SymbolIndex::find(const std::string& dir, const std::string& name, std::string& path){
+    const std::vector<std::string>* paths = find_all(dir, name);
+    if (paths == nullptr || paths->empty()){
+        return false;
+    }
+    path = paths->front();
+    return true;
+}
+
+bool SymbolIndex::find_build_id(const std::string& dir, const std::string& build_id, std::string& path){
+    if (build_id.empty() || !load(dir)){
+        return false;
+    }
+    auto it = build_id_index.find(build_id);
+    if (it == build_id_index.end()){
+        return false;
+    }
+    path = it->second;
+    return true;
+}
+
+#pragma GCC diagnostic pop
@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2024-2025 Qualcomm Innovation Center, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef SYMBOL_INDEX_DEFS_H_
+#define SYMBOL_INDEX_DEFS_H_
+
+#include "plugin.h"
+#include <sys/stat.h>
+#include <dirent.h>
+
+#define SYMBOL_INDEX_VERSION 1
+#define SYMBOL_INDEX_CACHE   "symbol_index"          /* cache file prefix */
+#define SYMBOL_INDEX_ENV     "CRASH_SYMBOL_CACHE"    /* dir of the cache files, no disk cache if unset */
+
+struct symbol_dir {
+    std::string path;
+    time_t mtime_sec;
+    long mtime_nsec;
+};
+
+/*
+ * Index of a symbols directory: basename -> paths in walk order and
+ * build-id -> path. The tree is walked once, later lookups are hash hits.
+ * Build-ids are only read for the names which match several files, the
+ * only case where they are needed to pick one.
+ * The index is kept for the session and rebuilt only when the mtime of an
+ * indexed directory changes, it can also be saved to a cache file for the
+ * next session.
+ */
+class SymbolIndex {
+private:
+    bool debug = false;
+    std::string root;
+    bool checked = false;           /* dir mtimes checked since the last recheck() */
+    std::vector<symbol_dir> dir_list;
+    std::vector<std::pair<std::string, std::string>> file_list; // <path, build-id>
+    std::unordered_map<std::string, std::vector<std::string>> name_index;
+    std::unordered_map<std::string, std::string> build_id_index;
+
+    void walk(const std::string& dir);
+    void add_file(const std::string& path, const std::string& build_id);
+    void read_build_ids();
+    std::string cache_path(const std::string& dir);
+    bool dirs_unchanged();
+    bool load_cache(const std::string& dir);
+    void save_cache();
+    bool load(const std::string& dir);
+
+public:
+    static SymbolIndex& instance();
+    const std::vector<std::string>* find_all(const std::string& dir, const std::string& name);
+    bool find(const std::string& dir, const std::string& name, std::string& path);
+    bool find_build_id(const std::string& dir, const std::string& build_id, std::string& path);
+    void reset();
+    void recheck();
+    static std::string basename(const std::string& name);
+    static std::string read_build_id(std::function<bool (size_t off, void* buf, size_t len)> read_fn);
+    static std::string read_build_id(const std::string& path);
+};
+
+#endif // SYMBOL_INDEX_DEFS_H_
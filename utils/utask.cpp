@@ -488,20 +488,17 @@ UTask::~UTask(){
 }
 
 ulong UTask::search_stdlist(std::shared_ptr<vma_struct> vma_ptr, ulong start_addr, std::function<bool (ulong)> node_callback) {
-    ulong list_size = 0;
-    for (size_t addr = start_addr; addr < vma_ptr->vm_end; addr += pointer_size) {
-        ulong list_addr = 0;
-        if (BITS64() && !is_compat()) {
-            list_addr = check_stdlist<list_node64_t, uint64_t>(addr, node_callback, list_size);
-        } else {
-            list_addr = check_stdlist<list_node32_t, uint32_t>(addr, node_callback, list_size);
-        }
-        if (list_addr != 0 && is_uvaddr(list_addr, tc) && list_size != 0) {
-            // this is a probility list addr
-            return list_addr;
-        }
+    // read the whole vma once and pre-filter in place, check_stdlist() only sees the survivors
+    if(vma_ptr->vm_data == nullptr){
+        vma_ptr->vm_data = (char*)read_vma_data(vma_ptr);
     }
-    return 0;
+    if(vma_ptr->vm_data == nullptr || !is_contains(vma_ptr, start_addr)){
+        return 0;
+    }
+    if (BITS64() && !is_compat()) {
+        return scan_stdlist<list_node64_t, uint64_t>(vma_ptr, start_addr, node_callback);
+    }
+    return scan_stdlist<list_node32_t, uint32_t>(vma_ptr, start_addr, node_callback);
 }
 
 std::vector<size_t> UTask::for_each_stdlist(ulong stdlist_addr){
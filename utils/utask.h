@@ -315,6 +315,47 @@ public:
         return 0;
     };
 
+    /*
+     * Cheap test on an in-memory word triple: a std::list head can only be
+     * here if prev/next both point into the rw heap range at a node-aligned
+     * address and the size slot is not empty. Everything else is skipped
+     * before check_stdlist() issues any per-node reads.
+     */
+    template<typename T, typename U>
+    bool is_stdlist_candidate(const char* data) {
+        const T* node = reinterpret_cast<const T*>(data);
+        U tmp_next = node->next & vaddr_mask;
+        U tmp_prev = node->prev & vaddr_mask;
+        if (node->data == 0) {
+            return false;
+        }
+        if ((tmp_prev & (sizeof(U) - 1)) || (tmp_next & (sizeof(U) - 1))) {
+            return false;
+        }
+        return (tmp_prev >= min_rw_vma_addr && tmp_prev <= max_rw_vma_addr)
+            && (tmp_next >= min_rw_vma_addr && tmp_next <= max_rw_vma_addr);
+    };
+
+    template<typename T, typename U>
+    ulong scan_stdlist(std::shared_ptr<vma_struct> vma_ptr, ulong start_addr, std::function<bool (ulong)> node_callback) {
+        ulong list_size = 0;
+        size_t candidates = 0;
+        for (size_t addr = start_addr; addr + sizeof(T) <= vma_ptr->vm_end; addr += sizeof(U)) {
+            if (!is_stdlist_candidate<T, U>(vma_ptr->vm_data + (addr - vma_ptr->vm_start))) {
+                continue;
+            }
+            candidates++;
+            ulong list_addr = check_stdlist<T, U>(addr, node_callback, list_size);
+            if (list_addr != 0 && is_uvaddr(list_addr, tc) && list_size != 0) {
+                if (debug) fprintf(fp, "  checked %zu candidates in [%#lx-%#lx]\n", candidates, vma_ptr->vm_start, vma_ptr->vm_end);
+                // this is a probility list addr
+                return list_addr;
+            }
+        }
+        if (debug) fprintf(fp, "  checked %zu candidates in [%#lx-%#lx]\n", candidates, vma_ptr->vm_start, vma_ptr->vm_end);
+        return 0;
+    };
+
     ulong search_stdlist(std::shared_ptr<vma_struct> vma_ptr, ulong start_addr, std::function<bool (ulong)> node_callback);
     std::vector<size_t> for_each_stdlist(ulong stdlist_addr);
     std::vector<size_t> for_each_stdvector(ulong std_vec_addr, size_t key_size);
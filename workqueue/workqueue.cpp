@@ -26,10 +26,10 @@ void Workqueue::cmd_main(void) {
     int c;
     std::string cppString;
     if (argcnt < 2) cmd_usage(pc->curcmd, SYNOPSIS);
-    if (workqueue_list.size() == 0){
+    if (!parsed){
         parse_workqueue();
     }
-    while ((c = getopt(argcnt, args, "wpP:")) != EOF) {
+    while ((c = getopt(argcnt, args, "wpP:s")) != EOF) {
         switch(c) {
             case 'w':
                 print_worker();
@@ -41,6 +41,9 @@ void Workqueue::cmd_main(void) {
                 cppString.assign(optarg);
                 print_pool_by_addr(cppString);
                 break;
+            case 's':
+                print_work_summary();
+                break;
             default:
                 argerrs++;
                 break;
@@ -105,6 +108,7 @@ Workqueue::Workqueue(){
         "-w\n"
             "  wq -p\n"
             "  wq -P <worker_pool addr>\n"
+            "  wq -s\n"
             "  This command dumps the workqueue info.",
         "\n",
         "EXAMPLES",
@@ -129,23 +133,35 @@ Workqueue::Workqueue(){
         "     Pending Work:",
         "        func_name",
         "\n",
+        "  Display pending and delayed works grouped by function and by pool:",
+        "    %s> wq -s",
+        "    jiffies:4295123456 HZ:250 pending:1532 delayed:12",
+        "",
+        "    function                       pending  delayed  pools  oldest",
+        "    vmstat_update+0x0              1024     0        4      8.120s",
+        "    drain_local_pages_wq+0x0       508      12       1      121.356s",
+        "",
+        "    worker_pool       cpu     pending  delayed  oldest     top_function",
+        "    ffffff800a019400  2       508      12       121.356s   drain_local_pages_wq+0x0",
+        "\n",
     };
     initialize();
 }
 
 void Workqueue::print_worker(){
     //sort
-    std::vector<std::pair<ulong, std::shared_ptr<worker>>> worker_list(worker_list_map.begin(), worker_list_map.end());
-    std::sort(worker_list.begin(), worker_list.end(),[&](const std::pair<ulong, std::shared_ptr<worker>>& a, const std::pair<ulong, std::shared_ptr<worker>>& b){
-        return a.second->last_active > b.second->last_active;
+    std::vector<uint32_t> worker_list(worker_table.size());
+    for (size_t i = 0; i < worker_list.size(); i++) {
+        worker_list[i] = i;
+    }
+    std::sort(worker_list.begin(), worker_list.end(),[&](uint32_t a, uint32_t b){
+        return worker_table[a].last_active > worker_table[b].last_active;
     });
     size_t name_max_len = 0;
     size_t last_func_max_len = 0;
-    for (const auto& pair_ptr : worker_list) {
-        std::shared_ptr<worker> worker_ptr = pair_ptr.second;
-        if(worker_ptr == nullptr) continue;
-        name_max_len = std::max(name_max_len,worker_ptr->comm.size());
-        last_func_max_len = std::max(last_func_max_len,print_func_name(worker_ptr->last_func).size());
+    for (const auto& w : worker_table) {
+        name_max_len = std::max(name_max_len, w.comm.size());
+        last_func_max_len = std::max(last_func_max_len, func_table[w.last_func].size());
     }
     std::ostringstream oss_hd;
     oss_hd << std::left << std::setw(VADDR_PRLEN) << "worker" << " "
@@ -159,26 +175,19 @@ void Workqueue::print_worker(){
         << std::left << std::setw(last_func_max_len) << "last_func" << " "
         << "current_func";
     fprintf(fp, "%s \n",oss_hd.str().c_str());
-    for(const auto& pair_ptr : worker_list){
-        std::shared_ptr<worker> worker_ptr = pair_ptr.second;
-        if(worker_ptr == nullptr) continue;
-        std::string idle = "No";
-        if (std::find(idle_worker_list.begin(), idle_worker_list.end(), worker_ptr) != idle_worker_list.end()) {
-            idle = "Yes";
-        } else {
-            idle = "No";
-        }
+    for(const auto& idx : worker_list){
+        const wq_worker& w = worker_table[idx];
         std::ostringstream oss;
-        oss << std::left << std::setw(VADDR_PRLEN) << std::hex << worker_ptr->addr << " "
-            << std::left << std::setw(name_max_len) << worker_ptr->comm << " "
-            << std::left << std::setw(6) << std::dec << worker_ptr->pid << " "
-            << std::left << std::setw(worker_flags_len) << worker_ptr->flags << " "
-            << std::left << std::setw(workqueue_name_len) << worker_ptr->desc << " "
-            << std::left << std::setw(8) << worker_ptr->sleeping << " "
-            << std::left << std::setw(11) << worker_ptr->last_active << " "
-            << std::left << std::setw(4) << idle << " "
-            << std::left << std::setw(last_func_max_len) << print_func_name(worker_ptr->last_func) << " "
-            << print_func_name(worker_ptr->current_func);
+        oss << std::left << std::setw(VADDR_PRLEN) << std::hex << w.addr << " "
+            << std::left << std::setw(name_max_len) << w.comm << " "
+            << std::left << std::setw(6) << std::dec << w.pid << " "
+            << std::left << std::setw(worker_flags_len) << w.flags << " "
+            << std::left << std::setw(workqueue_name_len) << w.desc << " "
+            << std::left << std::setw(8) << w.sleeping << " "
+            << std::left << std::setw(11) << w.last_active << " "
+            << std::left << std::setw(4) << (w.idle ? "Yes" : "No") << " "
+            << std::left << std::setw(last_func_max_len) << func_table[w.last_func] << " "
+            << func_table[w.current_func];
         fprintf(fp, "%s \n",oss.str().c_str());
     }
 }
@@ -190,44 +199,44 @@ void Workqueue::print_pool_by_addr(std::string addr){
     } catch (const std::exception& e) {
         fprintf(fp, "Exception caught: %s \n", e.what());
     }
-    if (is_kvaddr(address)) {
-        if(worker_pool_map.find(address) == worker_pool_map.end())
-            fprintf(fp, "No such worker pool \n");
-        for(const auto& worker_pool : worker_pool_map){
-            if(worker_pool.first == address){
-                fprintf(fp, "worker:\n");
-                for(const auto& worker_ptr : worker_pool.second->workers){
-                    std::string idle = "Idle";
-                    if (std::find(idle_worker_list.begin(), idle_worker_list.end(), worker_ptr) != idle_worker_list.end()) {
-                        idle = "Idle";
-                    } else {
-                        idle = "Busy";
-                    }
-                    std::ostringstream oss;
-                    oss << std::left << "   " << worker_ptr->comm << " "
-                        << std::left << "[" << idle << "] "
-                        << std::left << "pid:" << worker_ptr->pid;
-                    fprintf(fp, "%s \n",oss.str().c_str());
-                }
-                fprintf(fp, "\nDelayed Work:\n");
-                for(const auto& pool_workqueue_ptr : worker_pool.second->pwq_list){
-                    for(const auto& work_struct_ptr : pool_workqueue_ptr->delay_works_list){
-                        fprintf(fp, "   %s\n",print_func_name(work_struct_ptr->func).c_str());
-                    }
-                }
-                fprintf(fp, "\nPending Work:\n");
-                for(const auto& work_struct_ptr : worker_pool.second->worklist){
-                    fprintf(fp, "   %s\n",print_func_name(work_struct_ptr->func).c_str());
-                }
-            } /*else {
-                fprintf(fp, "No such worker pool \n");
-            } */
-        }
-    } else {
+    if (!is_kvaddr(address)) {
         fprintf(fp, "Invalid virtual address: %lx \n", address);
+        return;
+    }
+    auto it = pool_index.find(address);
+    if (it == pool_index.end()){
+        fprintf(fp, "No such worker pool \n");
+        return;
+    }
+    const wq_pool& pool = pool_table[it->second];
+    fprintf(fp, "worker:\n");
+    for(const auto& idx : pool.workers){
+        const wq_worker& w = worker_table[idx];
+        std::ostringstream oss;
+        oss << std::left << "   " << w.comm << " "
+            << std::left << "[" << (w.idle ? "Idle" : "Busy") << "] "
+            << std::left << "pid:" << w.pid;
+        fprintf(fp, "%s \n",oss.str().c_str());
+    }
+    fprintf(fp, "\nDelayed Work:\n");
+    for(const auto& pwq : pool.pwqs){
+        for(const auto& idx : pwq_table[pwq].delayed){
+            fprintf(fp, "   %s\n", func_table[work_table[idx].func].c_str());
+        }
+    }
+    fprintf(fp, "\nPending Work:\n");
+    for(const auto& idx : pool.pending){
+        fprintf(fp, "   %s\n", func_table[work_table[idx].func].c_str());
     }
 }
 
+std::string Workqueue::pool_cpu_name(const wq_pool& pool){
+    if(pool.cpu < 0){
+        return "Unbound";
+    }
+    return std::to_string(pool.cpu);
+}
+
 void Workqueue::print_pool(){
     std::ostringstream oss_hd;
     oss_hd << std::left << std::setw(VADDR_PRLEN + 5) << "worker_pool" << " "
@@ -238,26 +247,127 @@ void Workqueue::print_pool(){
         << std::left << std::setw(10) << "works" << " "
         << std::left << "flags";
     fprintf(fp, "%s \n",oss_hd.str().c_str());
-    for(const auto& pair_ptr : worker_pool_map){
-        std::shared_ptr<worker_pool> wp_ptr = pair_ptr.second;
-        std::string cpu = "";
-        if(wp_ptr->cpu < 0){
-            cpu = "Unbound";
-        } else {
-            cpu = std::to_string(wp_ptr->cpu);
-        }
+    for(const auto& pool : pool_table){
         std::ostringstream oss;
-        oss << std::left << std::setw(VADDR_PRLEN + 5) << std::hex << wp_ptr->addr << " "
-            << std::left << std::setw(10) << std::dec << cpu << " "
-            << std::left << std::setw(10) << std::dec << wp_ptr->nr_workers << " "
-            << std::left << std::setw(10) << std::dec << wp_ptr->nr_idle << " "
-            << std::left << std::setw(10) << std::dec << wp_ptr->nr_running << " "
-            << std::left << std::setw(10) << std::dec << wp_ptr->worklist.size() << " "
-            << std::left << wp_ptr->flags;
+        oss << std::left << std::setw(VADDR_PRLEN + 5) << std::hex << pool.addr << " "
+            << std::left << std::setw(10) << std::dec << pool_cpu_name(pool) << " "
+            << std::left << std::setw(10) << std::dec << pool.nr_workers << " "
+            << std::left << std::setw(10) << std::dec << pool.nr_idle << " "
+            << std::left << std::setw(10) << std::dec << pool.nr_running << " "
+            << std::left << std::setw(10) << std::dec << pool.pending.size() << " "
+            << std::left << pool.flags;
         fprintf(fp, "%s \n",oss.str().c_str());
     }
 }
 
+/*
+ * work_struct carries no enqueue time, so the age of a pool is taken the
+ * way the workqueue watchdog does it: jiffies - pool->watchdog_ts, which is
+ * the time since the pool last started a work or got its first pending one.
+ * Every pending or delayed work of that pool has waited at least that long.
+ */
+void Workqueue::print_work_summary(){
+    // watchdog_ts is an unsigned long, so is jiffies, which is also the low
+    // word of jiffies_64 on little-endian 32-bit
+    ulong jiffies = 0;
+    if (csymbol_exists("jiffies")){
+        jiffies = read_ulong(csymbol_value("jiffies"),"jiffies");
+    }else if (csymbol_exists("jiffies_64")){
+        jiffies = read_ulong(csymbol_value("jiffies_64"),"jiffies");
+    }
+    ulong hz = machdep->hz ? machdep->hz : 100;
+    std::vector<wq_work_stat> func_stat(func_table.size());
+    std::vector<wq_work_stat> pool_stat(pool_table.size());
+    std::vector<std::unordered_map<uint32_t, size_t>> pool_funcs(pool_table.size());
+    size_t total_pending = 0;
+    size_t total_delayed = 0;
+    for (const auto& work : work_table) {
+        if (work.pool == WQ_NONE){
+            continue;
+        }
+        ulong ts = pool_table[work.pool].watchdog_ts;
+        for (wq_work_stat* stat : {&func_stat[work.func], &pool_stat[work.pool]}) {
+            if (work.delayed){
+                stat->delayed++;
+            } else {
+                stat->pending++;
+            }
+            if (stat->pools.insert(work.pool).second
+                && (stat->pools.size() == 1 || jiffies - ts > jiffies - stat->oldest_ts)){
+                stat->oldest_ts = ts;
+            }
+        }
+        pool_funcs[work.pool][work.func]++;
+        if (work.delayed){
+            total_delayed++;
+        } else {
+            total_pending++;
+        }
+    }
+    auto print_age = [&](const wq_work_stat& stat) -> std::string {
+        char buf[32];
+        ulong age = jiffies - stat.oldest_ts;
+        snprintf(buf, sizeof(buf), "%lu.%03lus", age / hz, (age % hz) * 1000 / hz);
+        return buf;
+    };
+    auto by_count = [](std::vector<wq_work_stat>& stat) -> std::vector<uint32_t> {
+        std::vector<uint32_t> order;
+        for (size_t i = 0; i < stat.size(); i++) {
+            if (stat[i].pending + stat[i].delayed > 0){
+                order.push_back(i);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){
+            return stat[a].pending + stat[a].delayed > stat[b].pending + stat[b].delayed;
+        });
+        return order;
+    };
+    fprintf(fp, "jiffies:%lu HZ:%lu pending:%zu delayed:%zu\n\n", jiffies, hz, total_pending, total_delayed);
+    if (total_pending + total_delayed == 0){
+        return;
+    }
+    std::vector<uint32_t> func_order = by_count(func_stat);
+    size_t func_len = 8;
+    for (const auto& idx : func_order) {
+        func_len = std::max(func_len, func_table[idx].size());
+    }
+    std::ostringstream oss;
+    oss << std::left << std::setw(func_len) << "function" << " "
+        << std::left << std::setw(8) << "pending" << " "
+        << std::left << std::setw(8) << "delayed" << " "
+        << std::left << std::setw(6) << "pools" << " "
+        << "oldest" << "\n";
+    for (const auto& idx : func_order) {
+        const wq_work_stat& stat = func_stat[idx];
+        oss << std::left << std::setw(func_len) << func_table[idx] << " "
+            << std::left << std::setw(8) << std::dec << stat.pending << " "
+            << std::left << std::setw(8) << stat.delayed << " "
+            << std::left << std::setw(6) << stat.pools.size() << " "
+            << print_age(stat) << "\n";
+    }
+    oss << "\n"
+        << std::left << std::setw(VADDR_PRLEN + 1) << "worker_pool" << " "
+        << std::left << std::setw(7) << "cpu" << " "
+        << std::left << std::setw(8) << "pending" << " "
+        << std::left << std::setw(8) << "delayed" << " "
+        << std::left << std::setw(10) << "oldest" << " "
+        << "top_function" << "\n";
+    for (const auto& idx : by_count(pool_stat)) {
+        const wq_work_stat& stat = pool_stat[idx];
+        auto top = std::max_element(pool_funcs[idx].begin(), pool_funcs[idx].end(),
+            [](const std::pair<const uint32_t, size_t>& a, const std::pair<const uint32_t, size_t>& b){
+                return a.second < b.second;
+            });
+        oss << std::left << std::setw(VADDR_PRLEN + 1) << std::hex << pool_table[idx].addr << " "
+            << std::left << std::setw(7) << std::dec << pool_cpu_name(pool_table[idx]) << " "
+            << std::left << std::setw(8) << stat.pending << " "
+            << std::left << std::setw(8) << stat.delayed << " "
+            << std::left << std::setw(10) << print_age(stat) << " "
+            << func_table[top->first] << "\n";
+    }
+    fprintf(fp, "%s", oss.str().c_str());
+}
+
 std::string Workqueue::print_func_name(ulong func_addr){
     struct syment *sp;
     ulong offset;
@@ -266,9 +376,8 @@ std::string Workqueue::print_func_name(ulong func_addr){
         sp = value_search(func_addr, &offset);
         if (sp){
             oss << sp->name << "+0x" << std::hex << offset;
-            // sprintf(buf_last_func, "[<%lx>] %s+0x%lx ", worker_member->last_func, sp->name, offset);
         }else{
-            oss << "[<" << std::hex << func_addr << ">] " << sp;
+            oss << "[<" << std::hex << func_addr << ">]";
         }
     }else{
         oss << "None";
@@ -276,6 +385,23 @@ std::string Workqueue::print_func_name(ulong func_addr){
     return oss.str();
 }
 
+/*
+ * Resolve a function pointer once, works and workers only keep the row.
+ */
+uint32_t Workqueue::intern_func(ulong func_addr){
+    if (!is_kvaddr(func_addr)){
+        func_addr = 0;
+    }
+    auto it = func_index.find(func_addr);
+    if (it != func_index.end()){
+        return it->second;
+    }
+    uint32_t idx = func_table.size();
+    func_table.push_back(print_func_name(func_addr));
+    func_index[func_addr] = idx;
+    return idx;
+}
+
 template <typename T>
 std::string Workqueue::parser_flags(uint flags, const std::unordered_map<T, std::string>& flags_array){
     std::string result;
@@ -295,10 +421,11 @@ std::string Workqueue::parser_flags(uint flags, const std::unordered_map<T, std:
     return result;
 }
 
-std::shared_ptr<worker> Workqueue::parser_worker(ulong addr,std::shared_ptr<worker_pool> wp_ptr){
-    auto worker_ptr = std::make_shared<worker>();
-    worker_ptr->addr = addr;
-    worker_ptr->wp_ptr = wp_ptr;
+uint32_t Workqueue::parser_worker(ulong addr, uint32_t pool){
+    wq_worker w;
+    w.addr = addr;
+    w.pool = pool;
+    w.idle = false;
     std::unordered_map<worker_flags, std::string> str_flag_array = {
         {WORKER_DIE, "WORKER_DIE"},
         {WORKER_IDLE, "WORKER_IDLE"},
@@ -308,123 +435,152 @@ std::shared_ptr<worker> Workqueue::parser_worker(ulong addr,std::shared_ptr<work
         {WORKER_REBOUND, "WORKER_REBOUND"},
     };
     void *worker_buf = read_struct(addr, "worker");
+    if (!worker_buf) return WQ_NONE;
     unsigned int flags = UINT(worker_buf + field_offset(worker, flags));
-    worker_ptr->flags = parser_flags(flags, str_flag_array);
-    worker_flags_len = std::max(worker_flags_len, worker_ptr->flags.size());
-    worker_ptr->current_func = ULONG(worker_buf + field_offset(worker, current_func));
-    worker_ptr->task_addr = ULONG(worker_buf + field_offset(worker, task));
-    worker_ptr->last_active = ULONG(worker_buf + field_offset(worker, last_active));
-    worker_ptr->id = INT(worker_buf + field_offset(worker, id));
-    worker_ptr->sleeping = INT(worker_buf + field_offset(worker, sleeping));
-    worker_ptr->desc = read_cstring(addr + field_offset(worker, desc), 24, "worker_desc");
-    if (worker_ptr->desc.size() == 0)
-    worker_ptr->desc = "None";
-    struct task_context *tc = task_to_context(worker_ptr->task_addr);
+    w.flags = parser_flags(flags, str_flag_array);
+    worker_flags_len = std::max(worker_flags_len, w.flags.size());
+    w.current_func = intern_func(ULONG(worker_buf + field_offset(worker, current_func)));
+    w.task_addr = ULONG(worker_buf + field_offset(worker, task));
+    w.last_active = ULONG(worker_buf + field_offset(worker, last_active));
+    w.id = INT(worker_buf + field_offset(worker, id));
+    w.sleeping = INT(worker_buf + field_offset(worker, sleeping));
+    w.desc = read_cstring(addr + field_offset(worker, desc), 24, "worker_desc");
+    if (w.desc.size() == 0)
+    w.desc = "None";
+    struct task_context *tc = task_to_context(w.task_addr);
     if (tc){
-        worker_ptr->comm = tc->comm;
-        worker_ptr->pid = tc->pid;
+        w.comm = tc->comm;
+        w.pid = tc->pid;
     }else{
-        worker_ptr->comm = "";
-        worker_ptr->pid = -1;
+        w.comm = "";
+        w.pid = -1;
     }
-    workqueue_name_len = std::max(workqueue_name_len, worker_ptr->desc.size());
-    worker_ptr->last_func = ULONG(worker_buf + field_offset(worker, last_func));
+    workqueue_name_len = std::max(workqueue_name_len, w.desc.size());
+    w.last_func = intern_func(ULONG(worker_buf + field_offset(worker, last_func)));
     FREEBUF(worker_buf);
-    return worker_ptr;
+    uint32_t idx = worker_table.size();
+    worker_table.push_back(std::move(w));
+    worker_index[addr] = idx;
+    return idx;
 }
 
-std::vector<std::shared_ptr<worker>> Workqueue::parser_worker_list(ulong list_head_addr,int offset,std::shared_ptr<worker_pool> wp_ptr){
-    std::vector<std::shared_ptr<worker>> worker_list;
+std::vector<uint32_t> Workqueue::parser_worker_list(ulong list_head_addr, int offset, uint32_t pool){
+    std::vector<uint32_t> worker_list;
     std::vector<ulong> list = for_each_list(list_head_addr, offset);
-    std::shared_ptr<worker> worker_ptr;
     for(const auto& worker_addr : list){
-        if (worker_list_map.find(worker_addr) == worker_list_map.end()) {
-            worker_ptr = parser_worker(worker_addr,wp_ptr);
-            worker_list_map[worker_addr] = worker_ptr;
+        uint32_t idx;
+        auto it = worker_index.find(worker_addr);
+        if (it == worker_index.end()) {
+            idx = parser_worker(worker_addr, pool);
         } else {
-            worker_ptr = worker_list_map[worker_addr];
+            idx = it->second;
+        }
+        if (idx != WQ_NONE){
+            worker_list.push_back(idx);
         }
-        worker_list.push_back(worker_ptr);
     }
     return worker_list;
 }
 
-std::vector<std::shared_ptr<work_struct>> Workqueue::parser_work_list(ulong list_head_addr){
-    std::vector<std::shared_ptr<work_struct>> work_list;
+/*
+ * One read of work_struct per work, data and func come from the same buffer.
+ */
+std::vector<uint32_t> Workqueue::parser_work_list(ulong list_head_addr, uint32_t pool, uint32_t pwq){
+    std::vector<uint32_t> work_list;
     int offset = field_offset(work_struct, entry);
     std::vector<ulong> list = for_each_list(list_head_addr, offset);
+    work_list.reserve(list.size());
+    std::vector<char> buf(struct_size(work_struct));
     for(const auto& work_addr : list){
-        auto work_ptr = std::make_shared<work_struct>();
-        work_ptr->addr = work_addr;
-        work_ptr->data = read_ulong(work_addr + field_offset(work_struct, data), "work_struct_data");
-        work_ptr->func = read_pointer(work_addr + field_offset(work_struct, func), "work_struct_func");
-        work_list.push_back(work_ptr);
+        if (!read_struct(work_addr, buf.data(), buf.size(), "work_struct")){
+            continue;
+        }
+        wq_work work;
+        work.addr = work_addr;
+        work.data = ULONG(buf.data() + field_offset(work_struct, data));
+        work.func = intern_func(ULONG(buf.data() + field_offset(work_struct, func)));
+        work.pool = pool;
+        work.pwq = pwq;
+        work.delayed = (pwq != WQ_NONE);
+        work_list.push_back(work_table.size());
+        work_table.push_back(work);
     }
     return work_list;
 }
 
-std::shared_ptr<worker_pool> Workqueue::parser_worker_pool(ulong addr,std::shared_ptr<pool_workqueue> pwq_ptr){
-    auto wp_ptr = std::make_shared<worker_pool>();
-    wp_ptr->addr = addr;
+uint32_t Workqueue::parser_worker_pool(ulong addr){
     void *wp_buf = read_struct(addr, "worker_pool");
-    wp_ptr->cpu = INT(wp_buf + field_offset(worker_pool, cpu));
-    wp_ptr->node = INT(wp_buf + field_offset(worker_pool, node));
-    wp_ptr->id = INT(wp_buf + field_offset(worker_pool, id));
+    if (!wp_buf) return WQ_NONE;
+    uint32_t idx = pool_table.size();
+    pool_table.emplace_back();
+    pool_index[addr] = idx;
+    wq_pool& pool = pool_table[idx];
+    pool.addr = addr;
+    pool.cpu = INT(wp_buf + field_offset(worker_pool, cpu));
+    pool.node = INT(wp_buf + field_offset(worker_pool, node));
+    pool.id = INT(wp_buf + field_offset(worker_pool, id));
     std::unordered_map<worker_pool_flags, std::string> str_flag_array = {
         {POOL_MANAGER_ACTIVE, "POOL_MANAGER_ACTIVE"},
         {POOL_DISASSOCIATED, "POOL_DISASSOCIATED"}
     };
-    wp_ptr->pwq_list.insert(pwq_ptr);
     unsigned int flags = UINT(wp_buf + field_offset(worker_pool, flags));
-    wp_ptr->flags = parser_flags(flags, str_flag_array);
-    worker_pool_flags_len = std::max(worker_pool_flags_len, wp_ptr->flags.size());
-    wp_ptr->nr_workers = INT(wp_buf + field_offset(worker_pool, nr_workers));
-    wp_ptr->nr_idle = INT(wp_buf + field_offset(worker_pool, nr_idle));
-    wp_ptr->watchdog_ts = ULONG(wp_buf + field_offset(worker_pool, watchdog_ts));
-    wp_ptr->nr_running = ULONG(wp_buf + field_offset(worker_pool, nr_running));
-    wp_ptr->worklist = parser_work_list(addr + field_offset(worker_pool, worklist));
-    int offset = field_offset(worker, node);
-    wp_ptr->workers = parser_worker_list(addr + field_offset(worker_pool, workers),offset,wp_ptr);
-    offset = field_offset(worker, entry);
-    wp_ptr->idle_list = parser_worker_list(addr + field_offset(worker_pool, idle_list), offset,wp_ptr);
-    idle_worker_list.insert(idle_worker_list.end(), wp_ptr->idle_list.begin(), wp_ptr->idle_list.end());
+    pool.flags = parser_flags(flags, str_flag_array);
+    worker_pool_flags_len = std::max(worker_pool_flags_len, pool.flags.size());
+    pool.nr_workers = INT(wp_buf + field_offset(worker_pool, nr_workers));
+    pool.nr_idle = INT(wp_buf + field_offset(worker_pool, nr_idle));
+    pool.watchdog_ts = ULONG(wp_buf + field_offset(worker_pool, watchdog_ts));
+    pool.nr_running = ULONG(wp_buf + field_offset(worker_pool, nr_running));
     FREEBUF(wp_buf);
-    return wp_ptr;
+    // the tables grow below, do not hold the reference across them
+    std::vector<uint32_t> pending = parser_work_list(addr + field_offset(worker_pool, worklist), idx, WQ_NONE);
+    std::vector<uint32_t> workers = parser_worker_list(addr + field_offset(worker_pool, workers), field_offset(worker, node), idx);
+    std::vector<uint32_t> idle_list = parser_worker_list(addr + field_offset(worker_pool, idle_list), field_offset(worker, entry), idx);
+    for (const auto& w : idle_list) {
+        worker_table[w].idle = true;
+    }
+    pool_table[idx].pending = std::move(pending);
+    pool_table[idx].workers = std::move(workers);
+    return idx;
 }
 
-std::shared_ptr<pool_workqueue> Workqueue::parser_pool_workqueue(ulong addr,std::shared_ptr<workqueue_struct> wq_ptr){
-    auto pwq_ptr = std::make_shared<pool_workqueue>();
-    pwq_ptr->addr = addr;
-    pwq_ptr->wq_ptr = wq_ptr;
+uint32_t Workqueue::parser_pool_workqueue(ulong addr, uint32_t wq){
     void *pwq_buf = read_struct(addr, "pool_workqueue");
-    pwq_ptr->refcnt = INT(pwq_buf + field_offset(pool_workqueue, refcnt));
-    pwq_ptr->nr_active = INT(pwq_buf + field_offset(pool_workqueue, nr_active));
-    pwq_ptr->max_active = INT(pwq_buf + field_offset(pool_workqueue, max_active));
+    if (!pwq_buf) return WQ_NONE;
+    wq_pwq pwq;
+    pwq.addr = addr;
+    pwq.wq = wq;
+    pwq.pool = WQ_NONE;
+    pwq.refcnt = INT(pwq_buf + field_offset(pool_workqueue, refcnt));
+    pwq.nr_active = INT(pwq_buf + field_offset(pool_workqueue, nr_active));
+    pwq.max_active = INT(pwq_buf + field_offset(pool_workqueue, max_active));
     ulong pool_addr = ULONG(pwq_buf + field_offset(pool_workqueue, pool));
     FREEBUF(pwq_buf);
     if (is_kvaddr(pool_addr)){
-        std::shared_ptr<worker_pool> wp_ptr;
-        if (worker_pool_map.find(pool_addr) == worker_pool_map.end()){ // Do not find the pool_addr
-            wp_ptr = parser_worker_pool(pool_addr,pwq_ptr);
-            worker_pool_map[pool_addr] = wp_ptr;
+        auto it = pool_index.find(pool_addr);
+        if (it == pool_index.end()){ // Do not find the pool_addr
+            pwq.pool = parser_worker_pool(pool_addr);
         }else{
-            wp_ptr = worker_pool_map[pool_addr];
+            pwq.pool = it->second;
         }
-        pwq_ptr->wp_ptr = wp_ptr;
     }
+    uint32_t idx = pwq_table.size();
     if(field_offset(pool_workqueue, inactive_works) >= 0){
-        pwq_ptr->delay_works_list = parser_work_list(addr + field_offset(pool_workqueue, inactive_works));
+        pwq.delayed = parser_work_list(addr + field_offset(pool_workqueue, inactive_works), pwq.pool, idx);
     } else {
         field_init(pool_workqueue, delayed_works);
-        pwq_ptr->delay_works_list = parser_work_list(addr + field_offset(pool_workqueue, delayed_works));
+        pwq.delayed = parser_work_list(addr + field_offset(pool_workqueue, delayed_works), pwq.pool, idx);
+    }
+    if (pwq.pool != WQ_NONE){
+        pool_table[pwq.pool].pwqs.push_back(idx);
     }
-    return pwq_ptr;
+    pwq_table.push_back(std::move(pwq));
+    return idx;
 }
 
-std::shared_ptr<workqueue_struct> Workqueue::parser_workqueue_struct(ulong addr){
-    auto wq_ptr = std::make_shared<workqueue_struct>();
-    wq_ptr->addr = addr;
-    wq_ptr->name = read_cstring(addr + field_offset(workqueue_struct, name), 24, "workqueue_struct_name");
+uint32_t Workqueue::parser_workqueue_struct(ulong addr){
+    wq_struct wq;
+    wq.addr = addr;
+    wq.name = read_cstring(addr + field_offset(workqueue_struct, name), 24, "workqueue_struct_name");
     unsigned int flags = read_uint(addr + field_offset(workqueue_struct, flags), "workqueue_struct_flags");
     std::unordered_map<workqueue_struct_flags, std::string> str_flag_array = {
         {WQ_UNBOUND, "WQ_UNBOUND"},
@@ -434,14 +590,19 @@ std::shared_ptr<workqueue_struct> Workqueue::parser_workqueue_struct(ulong addr)
         {WQ_CPU_INTENSIVE, "WQ_CPU_INTENSIVE"},
         {WQ_SYSFS, "WQ_SYSFS"}
     };
-    wq_ptr->flags = parser_flags(flags, str_flag_array);
+    wq.flags = parser_flags(flags, str_flag_array);
+    uint32_t idx = wq_table.size();
     ulong pwqs_head_addr = addr + field_offset(workqueue_struct, pwqs);
     int offset = field_offset(pool_workqueue, pwqs_node);
     std::vector<ulong> pwq_list = for_each_list(pwqs_head_addr, offset);
     for (const auto& pwq_addr : pwq_list){
-        wq_ptr->pwqs.push_back(parser_pool_workqueue(pwq_addr,wq_ptr));
+        uint32_t pwq = parser_pool_workqueue(pwq_addr, idx);
+        if (pwq != WQ_NONE){
+            wq.pwqs.push_back(pwq);
+        }
     }
-    return wq_ptr;
+    wq_table.push_back(std::move(wq));
+    return idx;
 }
 
 void Workqueue::parse_workqueue(){
@@ -451,14 +612,14 @@ void Workqueue::parse_workqueue(){
     }
     ulong workqueues_addr = csymbol_value("workqueues");
     if (!is_kvaddr(workqueues_addr)) return;
-    if (workqueue_list.size() > 0) return;
+    if (parsed) return;
+    intern_func(0);  // row 0 is "None"
     int offset = field_offset(workqueue_struct, list);
     std::vector<ulong> list = for_each_list(workqueues_addr, offset);
     for(const auto& addr : list){
-        // fprintf(fp, "workqueue_addr %lx \n", addr);
-        auto workqueue_struct = parser_workqueue_struct(addr);
-        workqueue_list.push_back(workqueue_struct);
+        parser_workqueue_struct(addr);
     }
+    parsed = true;
 }
 
 #pragma GCC diagnostic pop
@@ -42,37 +42,43 @@ enum workqueue_struct_flags {
   WQ_SYSFS = 1 << 6,
 };
 
-struct worker;
-struct worker_pool;
-struct pool_workqueue;
-struct workqueue_struct;
+#define WQ_NONE ((uint32_t)-1)    /* no row in the table */
+
+/*
+ * The snapshot is kept in flat tables which refer to each other by row
+ * index. Function pointers are interned in func_table, so each symbol is
+ * only resolved once.
+ */
 
 // task
-struct work_struct{
+struct wq_work {
   ulong addr;
   ulong data;
-  ulong func;
+  uint32_t func;
+  uint32_t pool;
+  uint32_t pwq;   // the pool_workqueue of a delayed work, WQ_NONE for pending ones
+  bool delayed;
 };
 
 // staff
-struct worker{
+struct wq_worker {
   ulong addr;
   std::string comm;
   int pid;
-  // std::shared_ptr<work_struct> current_work;
-  ulong current_func;
+  uint32_t current_func;
   ulong task_addr;
   ulong last_active;
   std::string flags;
   int id;
   int sleeping;
   std::string desc;
-  ulong last_func;
-  std::shared_ptr<worker_pool> wp_ptr;
+  uint32_t last_func;
+  uint32_t pool;
+  bool idle;
 };
 
 // department
-struct worker_pool{
+struct wq_pool {
   ulong addr;
   int cpu;
   int node;
@@ -80,42 +86,52 @@ struct worker_pool{
   std::string flags;
   ulong watchdog_ts;
   ulong nr_running;
-  std::vector<std::shared_ptr<work_struct>> worklist; // save pending work_struct
   int nr_workers;
   int nr_idle;
-  std::set<std::shared_ptr<pool_workqueue>> pwq_list; // save all pool_workqueue
-  std::vector<std::shared_ptr<worker>> idle_list; // save idle worker
-  std::vector<std::shared_ptr<worker>> workers; // save all worker
-  std::vector<ulong> busy_hash;
+  std::vector<uint32_t> pending;  // works on worklist
+  std::vector<uint32_t> pwqs;     // all pool_workqueue of this pool
+  std::vector<uint32_t> workers;
 };
 
 // department leader
-struct pool_workqueue{
+struct wq_pwq {
   ulong addr;
-  std::shared_ptr<workqueue_struct> wq_ptr;
-  std::shared_ptr<worker_pool> wp_ptr;
+  uint32_t wq;
+  uint32_t pool;
   int refcnt;
   int nr_active;
   int max_active;
-  std::vector<std::shared_ptr<work_struct>> delay_works_list; // save delay work_struct
+  std::vector<uint32_t> delayed;  // works on inactive_works/delayed_works
 };
 
 // project
-struct workqueue_struct{
+struct wq_struct {
   ulong addr;
   std::string name;
   std::string flags;
-  int nr_drainers;
-  std::vector<std::shared_ptr<pool_workqueue>> pwqs;
-  std::shared_ptr<worker> rescuer;
+  std::vector<uint32_t> pwqs;
+};
+
+// pending and delayed works of one function or one pool
+struct wq_work_stat {
+  size_t pending = 0;
+  size_t delayed = 0;
+  std::set<uint32_t> pools;
+  ulong oldest_ts = 0;  // smallest watchdog_ts of those pools
 };
 
 class Workqueue : public ParserPlugin {
 public:
-    std::vector<std::shared_ptr<workqueue_struct>> workqueue_list;
-    std::unordered_map<ulong/* worker ddr address */, std::shared_ptr<worker>> worker_list_map;
-    std::unordered_map<ulong/* worker_pool ddr address */, std::shared_ptr<worker_pool>> worker_pool_map;
-    std::vector<std::shared_ptr<worker>> idle_worker_list; // save all idle worker, same as idle_list
+    std::vector<wq_struct> wq_table;
+    std::vector<wq_pwq> pwq_table;
+    std::vector<wq_pool> pool_table;
+    std::vector<wq_worker> worker_table;
+    std::vector<wq_work> work_table;
+    std::vector<std::string> func_table;
+    std::unordered_map<ulong/* function address */, uint32_t> func_index;
+    std::unordered_map<ulong/* worker_pool ddr address */, uint32_t> pool_index;
+    std::unordered_map<ulong/* worker ddr address */, uint32_t> worker_index;
+    bool parsed = false;
     // only format for print
     size_t workqueue_name_len = 0;
     size_t worker_flags_len = 0;
@@ -124,17 +140,20 @@ public:
     void print_worker();
     void print_pool_by_addr(std::string addr);
     void print_pool();
+    void print_work_summary();
 
     template <typename T>
     std::string parser_flags(uint flags, const std::unordered_map<T, std::string>& flags_array);
-    std::vector<std::shared_ptr<work_struct>> parser_work_list(ulong list_head);
-    std::shared_ptr<worker> parser_worker(ulong addr,std::shared_ptr<worker_pool> wp_ptr);
-    std::vector<std::shared_ptr<worker>> parser_worker_list(ulong list_head_addr,int offset,std::shared_ptr<worker_pool> wp_ptr);
-    std::shared_ptr<worker_pool> parser_worker_pool(ulong addr,std::shared_ptr<pool_workqueue> pwq_ptr);
-    std::shared_ptr<pool_workqueue> parser_pool_workqueue(ulong addr,std::shared_ptr<workqueue_struct> wq_ptr);
-    std::shared_ptr<workqueue_struct> parser_workqueue_struct(ulong addr);
+    uint32_t intern_func(ulong func_addr);
+    std::vector<uint32_t> parser_work_list(ulong list_head, uint32_t pool, uint32_t pwq);
+    uint32_t parser_worker(ulong addr, uint32_t pool);
+    std::vector<uint32_t> parser_worker_list(ulong list_head_addr, int offset, uint32_t pool);
+    uint32_t parser_worker_pool(ulong addr);
+    uint32_t parser_pool_workqueue(ulong addr, uint32_t wq);
+    uint32_t parser_workqueue_struct(ulong addr);
     void parse_workqueue();
     std::string print_func_name(ulong func_addr);
+    std::string pool_cpu_name(const wq_pool& pool);
     Workqueue();
     void cmd_main(void) override;
     DEFINE_PLUGIN_INSTANCE(Workqueue)